@@ -7,28 +7,57 @@
 */
 
 #include "CConsole.h"
+#include "CConsoleBinaryLog.h"
+#include "CConsoleFlightRecorder.h"
+#include "CConsoleHtml.h"
+#include "CConsoleNumberFormat.h"
 
 #include <stdio.h> 
+#include <stdarg.h>
 #include <stdlib.h>
 
+#include <atomic>              // requires cpp11
+#include <chrono>              // requires cpp11
+#include <condition_variable>  // requires cpp11
+#include <csignal>
+#include <cstdint>
 #include <ctime>
 #include <fstream>
-#include <filesystem>  // requires cpp17
+#include <filesystem>          // requires cpp17
 #include <iostream>
 #include <map>
-#include <mutex>       // requires cpp11
+#include <memory>
+#include <mutex>               // requires cpp11
 #include <set>
-#include <thread>      // requires cpp11
+#include <string_view>       // requires cpp17
+#include <thread>              // requires cpp11
+#include <vector>
 
 #include "../../../PFL/PFL/PFL.h"
+
+#ifdef _WIN32
 // WINAPI header include just for the FOREGROUND_XXX and WORD macros and console API functions
 #include "../../../PFL/PFL/winproof88.h"
 
 #include <winsock.h>   // for gethostname()
 
+#include <fcntl.h>     // for _open() of the crash file
+#include <io.h>
+#include <sys/stat.h>
+#else
+// on other platforms the terminal is driven by ANSI escape sequences written to stdout and stderr
+#include "CConsoleAnsi.h"
+
+#include <errno.h>
+#include <fcntl.h>     // for open() of the crash file
+#include <unistd.h>    // for gethostname(), isatty(), write()
+#endif
+
 // unused warnings
 // todo: revise these warnings when C++11 compiler is set, so that std::iota, etc can be used instead of itoa
+#ifdef _MSC_VER
 #pragma warning(disable:4996)  /* "may be unsafe" and "deprecated" */
+#endif
 
 /**
     If CCONSOLE_IS_ENABLED macro is defined, console window can be created and printouts will be visible, otherwise not.
@@ -41,7 +70,7 @@
 #define CCONSOLE_IS_ENABLED
 #endif
 
-#ifndef CCONSOLE_IS_ENABLED
+#if !defined(CCONSOLE_IS_ENABLED) && defined(_MSC_VER)
 #pragma warning(disable:4100)  /* "unreferenced formal parameter", obviously we will see a lot of if our macro is undefined */
 #endif
 
@@ -55,7 +84,53 @@ using namespace std;
 
 static constexpr auto CCONSOLE_VERSION = "v1.4 built on " __DATE__" @ " __TIME__;
 
-static std::mutex mainMutex;  // did not want to put this into CConsoleImpl because then CConsole::IsInitialized() could not be protected by this mutex when impl is not yet existing
+/**
+    Mutex measuring the time spent waiting for it, for CConsole::getStats().
+    Uncontended locking is a single try_lock() as before, the clock is read only when the mutex is already locked.
+*/
+class CConsoleMutex
+{
+public:
+    void lock()
+    {
+        if ( m.try_lock() )
+            return;
+
+        const auto timeStart = std::chrono::steady_clock::now();
+        m.lock();
+        // protected by m itself
+        nWaitNanosecs += static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - timeStart).count());
+    }
+
+    bool try_lock()
+    {
+        return m.try_lock();
+    }
+
+    void unlock()
+    {
+        m.unlock();
+    }
+
+    /** Total time spent waiting for the mutex, caller must hold the mutex. */
+    std::uint64_t getWaitNanosecs() const
+    {
+        return nWaitNanosecs;
+    }
+
+    /** Resets the total waiting time, caller must hold the mutex. */
+    void ResetWaitNanosecs()
+    {
+        nWaitNanosecs = 0;
+    }
+
+private:
+    std::mutex m;
+    std::uint64_t nWaitNanosecs = 0;
+};
+
+static CConsoleMutex mainMutex;  // did not want to put this into CConsoleImpl because then CConsole::IsInitialized() could not be protected by this mutex when impl is not yet existing
 
 /*
    CConsole::CConsoleImpl
@@ -69,9 +144,20 @@ class CConsole::CConsoleImpl
 public:
     void DeleteOldLogFiles(size_t nKeep);                        /**< Deletes the old log files. */
     void SetLoggerModuleName(const char* loggerModuleName);      /**< Sets the current logger module name. */
+    void SetLoggerModule(CConsole::ModuleHandle loggerModule);   /**< Sets the current logger module. */
     bool getLoggingState(const char* loggerModuleName);          /**< Gets logging state for the given logger module. */
     void SetLoggingState(const char* loggerModule, bool state);  /**< Sets logging on or off for the given logger module. */
     void SetErrorsAlwaysOn(bool state);                          /**< Sets errors always appear irrespective of logging state of current logger module. */
+    int  getLoggingLevel();                                      /**< Gets runtime minimum log level of the level macros. */
+    void SetLoggingLevel(int level);                             /**< Sets runtime minimum log level of the level macros. */
+    int  getErrorBacklogLines();                                 /**< Gets the number of suppressed lines kept per thread for dumping them on error. */
+    void SetErrorBacklogLines(int lines);                        /**< Sets the number of suppressed lines kept per thread for dumping them on error. */
+    int  getRepeatedLinesTimeout();                              /**< Gets the max time consecutive identical lines of a thread are collapsed for. */
+    void SetRepeatedLinesTimeout(int millisecs);                 /**< Sets consecutive identical lines of a thread to be collapsed and for how long. */
+    void SetCrashHandler(bool state);                            /**< Sets the most recent records to be written to a crash file on fatal signals or not. */
+    void WriteDroppedLines(
+        CConsole::FormatSignal mode, unsigned long long lines,
+        const char* szFile = NULL, int nLine = 0);               /**< Writes how many logs were dropped at a call site of the rate-limited log macros. */
 
     int  getIndent();             /**< Gets the current indentation. */
     void SetIndent(int value);    /**< Sets the current indentation. */
@@ -164,15 +250,52 @@ public:
     void OIEOOO(const char* text, va_list list);    /**< OI() + EO(text) + OO(). */
     void OIEOLnOO(const char* text, va_list list);  /**< OI() + EOLn(text) + OO(). */
 
+    void WriteFormat(
+        const CConsoleFormat::Format& format,
+        const CConsoleFormat::Arg* args,
+        CConsole::FormatSignal mode,
+        bool nl);                                   /**< O(), OLn(), SO(), SOLn(), EO() or EOLn() with compile-time parsed format. */
+
     int getErrorOutsCount() const;      /**< Gets total count of printouts-with-newline during error-mode. */
     int getSuccessOutsCount() const;    /**< Gets total count of printouts-with-newline during success-mode. */
     void ResetErrorOutsCount();         /**< Resets total count of printouts-with-newline during error-mode. */
     void ResetSuccessOutsCount();       /**< Resets total count of printouts-with-newline during success-mode. */
 
+    bool isAsyncLogging() const;        /**< Tells if logs are written by a background writer thread. */
+    void SetAsyncLogging(bool state);   /**< Sets logs to be written by a background writer thread or by the logging threads. */
+
+    bool isBinaryLogging() const;       /**< Tells if logs are written unformatted to a binary log file. */
+    void SetBinaryLogging(bool state);  /**< Sets logs to be written unformatted to a binary log file instead of console and html log file. */
+
+    CConsole::FlushPolicy getFlushPolicy() const;   /**< Gets when the log files are flushed. */
+    void SetFlushPolicy(
+        CConsole::FlushPolicy policy,
+        int intervalMillisecs);                     /**< Sets when the log files are flushed. */
+    void Flush();                                   /**< Writes all finished log lines to the log files. */
+
+    bool isCompactHtml() const;         /**< Tells if the html log file is written in compact html. */
+    void SetCompactHtml(bool state);    /**< Sets the html log file to be written in compact html or not. */
+
+    static CConsole::Stats getStats();  /**< Gets the logging statistics. */
+    static void ResetStats();           /**< Resets the logging statistics. */
+
+    bool isSinkOpen(CConsole::Sink sink) const;                      /**< Tells if the given sink is open. */
+    bool OpenSink(CConsole::Sink sink, const char* filename);        /**< Opens the given sink. */
+    void CloseSink(CConsole::Sink sink);                             /**< Closes the given sink. */
+    void SetSinkModeState(
+        CConsole::Sink sink, CConsole::FormatSignal mode, bool state);  /**< Sets logs of the given mode to be written to the given sink or not. */
+    void SetSinkLoggingState(
+        CConsole::Sink sink, const char* loggerModuleName, bool state); /**< Sets logs of the given logger module to be written to the given sink or not. */
+    std::string getMemorySinkText();                                 /**< Gets the text collected by the memory sink. */
+    void ClearMemorySink();                                          /**< Clears the text collected by the memory sink. */
+
     CConsole::CConsoleImpl& operator<<(const char* text);
     CConsole::CConsoleImpl& operator<<(const bool& b);
     CConsole::CConsoleImpl& operator<<(const int& n);
+    CConsole::CConsoleImpl& operator<<(const long long& n);
+    CConsole::CConsoleImpl& operator<<(const unsigned long long& n);
     CConsole::CConsoleImpl& operator<<(const float& f);
+    CConsole::CConsoleImpl& operator<<(const double& f);
     CConsole::CConsoleImpl& operator<<(const CConsole::FormatSignal& fs);
 
 protected:
@@ -184,15 +307,280 @@ private:
 
     static const int HTML_CLR_S = 7 * sizeof(char);   /**< Size to store 1 HTML-color. */
 
+    static constexpr size_t CCONSOLE_ASYNC_QUEUE_CAPACITY = 4096;  /**< Max number of queued records in async mode, must be power of 2. */
+    static constexpr int    CCONSOLE_WRITER_IDLE_WAIT_MS = 10;     /**< Max time the idle writer thread sleeps before checking the queue again. */
+    static constexpr int    CCONSOLE_TICK_MS = 50;                 /**< Time between the periodic checks of the tick thread. */
+    static constexpr size_t CCONSOLE_BINARY_BUFFER_SIZE = 64 * 1024;  /**< Encoded binary records are written to file in chunks of this size. */
+    static constexpr size_t CCONSOLE_SINK_COUNT = 6;               /**< Number of values of CConsole::Sink. */
+    static constexpr size_t CCONSOLE_FILE_BUFFER_SIZE = 256 * 1024;   /**< File sinks write rendered records to file in chunks of this size. */
+
     static CConsoleImpl consoleImplInstance;
+    static std::atomic<unsigned int> nLastInstanceId;  /**< Last id given to a CConsoleImpl instance. */
+
+    static constexpr size_t      CCONSOLE_MAX_LOGGER_MODULES = 1024;    /**< Max number of distinct logger module names, must be multiple of 64. */
+    static constexpr const char* CCONSOLE_ALL_MODULES = "4LLM0DUL3S";   /**< Magic module name for turning on all logging. */
+
+    static std::map<std::string, CConsole::ModuleHandle, std::less<>>
+        moduleHandles;                                              /**< Registered logger module names, protected by mainMutex. */
+    static const char* moduleNames[CCONSOLE_MAX_LOGGER_MODULES];    /**< Names of the registered logger modules indexed by handle, set before the handle is given out. */
+    static std::atomic<std::uint64_t>
+        enabledModules[CCONSOLE_MAX_LOGGER_MODULES / 64];           /**< Bitmap of logger modules for which logging is enabled, indexed by handle. */
+    static std::atomic<bool> bAllModulesEnabled;                    /**< True if logging is enabled for all modules by CCONSOLE_ALL_MODULES. */
+
+    static CConsole::ModuleHandle findModule(const char* loggerModuleName);      /**< Gets handle of the given logger module if it is registered. */
+    static CConsole::ModuleHandle registerModule(const char* loggerModuleName);  /**< Gets handle of the given logger module, registers it if needed. */
+    static bool isModuleEnabled(CConsole::ModuleHandle loggerModule);            /**< Tells if logging is enabled for the given logger module. */
+    static void ClearEnabledModules();                                           /**< Disables logging for all logger modules. */
 
     static int      nErrorOutCount;         /**< Total OLn() during error mode. */
     static int      nSuccessOutCount;       /**< Total OLn() during success mode. */
 
+    /**
+        Formatted output of a log line, waiting to be written to the sinks.
+        Logging threads collect their current line into a LogRecord, and the finished line is written
+        by the logging thread itself or by the writer thread in async mode.
+        The line is formatted only once into sink-neutral spans, every sink renders the spans in its own way.
+    */
+    struct LogRecord
+    {
+        /**
+            Tells the sinks how to render a span.
+        */
+        enum class SpanType : std::uint8_t
+        {
+            Text,       /* literal text */
+            Spaces,     /* text of spaces only, html renders it with non-breakable spaces */
+            Indent,     /* indentation at the start of a line, nIndent columns of spaces, no text */
+            Value,      /* formatted value of a placeholder, html renders it with clrHtml */
+            NewLine,    /* end of line */
+            ModeBegin,  /* start of text printed in error or success mode, html renders it with clrHtml, no text */
+            ModeEnd     /* end of text printed in error or success mode, no text */
+        };
+
+        struct Span
+        {
+            SpanType type;
+            WORD clr;                   /**< Console text attribute of sText. */
+            char clrHtml[HTML_CLR_S];   /**< Html color of Value and ModeBegin spans. */
+            int  nIndent;               /**< Number of columns of Indent spans. */
+            std::string sText;          /**< Text of the span. */
+        };
+
+        std::vector<Span> spans;        /**< Output of the line, in the order as it was produced. */
+        CConsole::ModuleHandle loggerModule{CConsole::ModuleHandle::None};  /**< Logger module of the thread when the line was finished. */
+        int  nMode{0};                  /**< Mode of the thread when the line was finished. */
+
+        bool isEmpty() const
+        {
+            return spans.empty();
+        }
+
+        void Clear()
+        {
+            spans.clear();
+            loggerModule = CConsole::ModuleHandle::None;
+            nMode = 0;
+        }
+    };
+
+    /**
+        Output of the log records, see CConsole::Sink.
+        Every sink has its own filter, and renders the spans of the accepted records into its own buffer which is
+        then written in one go. Filters are atomic because they are set by the thread holding mainMutex while
+        records might be written by writerThread at the same time.
+    */
+    class LogSink
+    {
+    public:
+        LogSink();
+        virtual ~LogSink();
+
+        bool accepts(const LogRecord& rec) const;          /**< Tells if the given record passes the filter of this sink. */
+        void SetModeState(int nMode, bool state);          /**< Sets records of the given mode to be accepted or not. */
+        void SetModuleState(
+            CConsole::ModuleHandle loggerModule,
+            bool state);                                   /**< Sets records of the given logger module to be accepted or not. */
+
+        virtual size_t Write(const LogRecord& rec) = 0;    /**< Renders the given record and writes it, returns the number of bytes written. */
+        virtual void Flush();                              /**< Makes the written records really reach their destination. */
+
+    protected:
+        std::string sBuffer;                               /**< Rendered output of the current record. */
+
+        static void AppendPlainText(
+            std::string& out, const LogRecord& rec);       /**< Renders the given record as plain text. */
+        static void AppendSpaces(
+            std::string& out, size_t n);                   /**< Appends n spaces to out, used for rendering indentation. */
+
+    private:
+        std::atomic<unsigned int> nModes;                  /**< Bit n is set if records of mode n are accepted. */
+        std::atomic<std::uint64_t>
+            disabledModules[CCONSOLE_MAX_LOGGER_MODULES / 64];  /**< Bitmap of logger modules whose records are not accepted. */
+
+        LogSink(const LogSink&);
+        LogSink& operator=(const LogSink&);
+    };
+
+    /**
+        Console window on Windows, stdout and stderr on other platforms.
+    */
+    class ConsoleSink : public LogSink
+    {
+    public:
+        ConsoleSink();
+        virtual ~ConsoleSink();
+
+        bool Open(const char* title);                      /**< Creates or attaches the console. */
+        virtual size_t Write(const LogRecord& rec) override;
+
+    private:
+        bool bOpen;
+#ifdef _WIN32
+        HANDLE hConsole;                                   /**< Console output handle. */
+        WORD   clrAttrWritten;                             /**< Console text attribute last set by Write(). */
+        bool   bAttrWritten;                               /**< True if Write() has already set clrAttrWritten. */
+
+        size_t WriteRun(WORD clr);                         /**< Writes sBuffer with the given console text attribute, returns its length. */
+#else
+        bool bStdoutColors;                                /**< True if stdout is a terminal, so colors can be written there as escape sequences. */
+        bool bStderrColors;                                /**< True if stderr is a terminal, so colors can be written there as escape sequences. */
+#endif
+    };
+
+    /**
+        Common part of the sinks writing to a file.
+        Rendered records are collected in a big buffer, the file is written only when the buffer is full or when
+        the sink is flushed, so many log lines are written by a single write call.
+    */
+    class FileSink : public LogSink
+    {
+    public:
+        FileSink();
+        virtual ~FileSink();
+
+        bool Open(const char* filename);                   /**< Opens the file for writing, existing file is overwritten. */
+        virtual void Flush() override;
+
+    protected:
+        std::ofstream f;
+
+        size_t WriteBuffer();                              /**< Moves sBuffer to sFileBuffer, writes sFileBuffer to the file if it is full, returns length of sBuffer. */
+
+    private:
+        std::string sFileBuffer;                           /**< Rendered records not yet written to the file. */
+
+        void WriteFileBuffer();                            /**< Writes sFileBuffer to the file and clears it. */
+    };
+
+    /**
+        Html log file, same indentations and colors as in the console.
+    */
+    class HtmlFileSink : public FileSink
+    {
+    public:
+        HtmlFileSink();
+        virtual ~HtmlFileSink();
+
+        bool Open(const char* filename, const char* title);  /**< Opens the file and writes the html header. */
+        virtual size_t Write(const LogRecord& rec) override;
+
+        void SetCompact(bool state);                       /**< Sets subsequent records to be written in compact html or not. */
+
+    private:
+        std::atomic<bool> bCompact;                        /**< True if records are written in compact html, see CConsoleHtml.h. */
+        bool   bInPre;                                     /**< True if a <pre> block is open. */
+        size_t nPreLines;                                  /**< Number of lines written into the open <pre> block. */
+        int    nOpenModeTags;                              /**< Number of tags opened by ModeBegin spans and not yet closed. */
+        const char* clrValueTag;                           /**< Html color of the open tag of Value spans, NULL if there is no such tag. */
+
+        size_t WriteCompact(const LogRecord& rec);         /**< Writes a record in compact html. */
+        void CloseValueTag();                              /**< Closes the tag of Value spans, if open. */
+    };
+
+    /**
+        Plain text file, same text as in the console, without colors.
+    */
+    class TextFileSink : public FileSink
+    {
+    public:
+        virtual size_t Write(const LogRecord& rec) override;
+    };
+
+    /**
+        JSON-lines file, one object per log line with the logger module, the mode and the text of the line.
+    */
+    class JsonFileSink : public FileSink
+    {
+    public:
+        virtual size_t Write(const LogRecord& rec) override;
+
+    private:
+        std::string sLine;                                 /**< Temp, text of the current line. */
+
+        void AppendLine(const LogRecord& rec);             /**< Appends sLine as a JSON object to sBuffer. */
+        void AppendEscaped(std::string_view text);         /**< Appends text to sBuffer, escaped as JSON string content. */
+    };
+
+    /**
+        Plain text collected in memory, see CConsole::getMemorySinkText().
+        Text is read by the thread holding mainMutex while records might be written by writerThread, hence the mutex.
+    */
+    class MemorySink : public LogSink
+    {
+    public:
+        virtual size_t Write(const LogRecord& rec) override;
+
+        std::string getText();                             /**< Gets the text collected so far. */
+        void Clear();                                      /**< Clears the text collected so far. */
+
+    private:
+        std::mutex textMutex;
+        std::string sText;
+    };
+
+    /**
+        Discards the records, for measuring the cost of logging without any output.
+    */
+    class NullSink : public LogSink
+    {
+    public:
+        virtual size_t Write(const LogRecord& rec) override;
+    };
+
+    /**
+        Ring of the most recent lines of a thread suppressed by the filter settings, dumped after the next error
+        of the thread, see CConsole::SetErrorBacklogLines().
+        Printouts are kept unformatted, every printout is: format string, int32 indentation, uint8 new line flag,
+        then the raw argument values encoded the same way as in the binary log, see CConsoleBinaryLog.h.
+        Line slots are reused so collecting doesn't allocate once the strings have grown.
+    */
+    class Backlog
+    {
+    public:
+        bool bDumpPending{false};             /**< True if an error was written since the last dump, see DumpBacklog(). */
+
+        std::string& getOpenLine(size_t nCapacity);  /**< Gets the line being collected, starts a new one if needed. */
+        void   EndLine();                            /**< Ends the line being collected, next printout starts a new line. */
+        void   Clear();                              /**< Drops all lines. */
+        bool   isEmpty() const;                      /**< Tells if there is no line in the ring. */
+        bool   isLineOpen() const;                   /**< Tells if the newest line is not yet ended. */
+        size_t getLineCount() const;                 /**< Gets the number of lines in the ring. */
+        const std::string& getLine(size_t i) const;  /**< Gets the i-th line, oldest first. */
+
+    private:
+        std::vector<std::string> lines;       /**< Line slots, size is the capacity of the ring. */
+        size_t nFirst{0};                     /**< Index of the oldest line in lines. */
+        size_t nCount{0};                     /**< Number of lines in the ring. */
+        bool   bLineOpen{false};              /**< True if the newest line is not yet ended. */
+    };
+
+    struct RepeatState;
+
     struct LogState
     {
+        int  nRefCount{0};                        /**< Number of Initialize() calls of the thread not yet matched by Deinitialize(). */
         int  nIndentValue{0};                     /**< Current indentation. */
-        std::string sLoggerName;                  /**< Name of the current logger module that last invoked getConsoleInstance(). */
+        CConsole::ModuleHandle loggerModule{CConsole::ModuleHandle::None};  /**< Current logger module that last invoked getConsoleInstance(). */
         int  nMode{0};                            /**< Current mode: 0 if normal, 1 is error, 2 is success (EOn()/EOff()/SOn()/SOff()/NOn()/RestoreDefaultColors() set this). */
         WORD clrFG{CCONSOLE_DEF_CLR_FG},
              clrBG{0};                            /**< Current foreground and background colors. */
@@ -215,28 +603,214 @@ private:
             dLastFloatsColorHtml[HTML_CLR_S]{0},
             dLastStringsColorHtml[HTML_CLR_S]{0},
             dLastBoolsColorHtml[HTML_CLR_S]{0};   /**< Saved html colors for ints, strings, floats and bools. */
+        WORD clrConsoleAttr{0};                   /**< Console text attribute set by last SetConsoleAttr(), used by AddSpan(). */
+        LogRecord line;                           /**< Output of the current line, collected until the line is finished. */
+        bool bFirstWriteTextCallAfterWriteTextLn{true};  /**< True if we are at the 1st no-new-line-print after a new-line-print. */
+        std::uint16_t nThreadIndex{0};            /**< Index of the thread in the binary log file, 0 until its 1st binary record. */
+        Backlog backlog;                          /**< Recent suppressed lines, used only if CConsole::SetErrorBacklogLines() is set. */
+        RepeatState* pLastLine{NULL};             /**< Last line of the thread, so its pending repeats can be written by other threads, see WritePendingRepeats(). */
+    };
+
+    /**
+        Copy of the filter-related fields of LogState of current thread, so that the public functions can tell without
+        taking mainMutex if a printout would be filtered out anyway.
+        Only the owner thread reads and writes it, see PublishFilterState().
+    */
+    struct FilterState
+    {
+        unsigned int nInstanceId{0};              /**< nInstanceId of the instance this copy belongs to, 0 if there is none. */
+        CConsole::ModuleHandle loggerModule{CConsole::ModuleHandle::None};  /**< Copy of LogState::loggerModule. */
+        int  nMode{0};                            /**< Copy of LogState::nMode. */
+    };
+
+    /**
+        Last line written by current thread, and the number of its identical lines suppressed since then,
+        see CConsole::SetRepeatedLinesTimeout().
+        Lines are compared by format string pointer, logger module, mode and raw argument values, so no text is built.
+        Only the owner thread writes it, so repeats are suppressed without taking mainMutex, see isRepeatedLine().
+        Other threads holding mainMutex might read it and take its nRepeats, see WritePendingRepeats(), this is why
+        the owner changes anything else only with mainMutex held.
+    */
+    struct RepeatState
+    {
+        unsigned int nInstanceId{0};              /**< nInstanceId of the instance the line was written by, 0 if there is no line to compare with. */
+        const char* fmt{NULL};                    /**< Format string of the line. */
+        CConsole::ModuleHandle loggerModule{CConsole::ModuleHandle::None};  /**< Logger module of the line. */
+        int  nMode{0};                            /**< Mode of the line. */
+        std::string sArgs;                        /**< Raw argument values of the line, encoded as in the binary log. */
+        std::string sNextArgs;                    /**< Temp, raw argument values of the line being compared. */
+        std::atomic<std::uint64_t> nRepeats{0};   /**< Number of identical lines suppressed since the line was written and not yet reported. */
+        std::chrono::steady_clock::time_point
+            timeWritten;                          /**< When the line was written. */
+    };
+
+    /**
+        Caches the address of the log state of current thread, and releases that log state when the thread exits,
+        so logState doesn't grow with threads born and died, and a newly born thread never gets the log state of a
+        died thread having the same thread id.
+    */
+    struct ThreadStateGuard
+    {
+        unsigned int nInstanceId{0};              /**< nInstanceId of the instance pState belongs to, 0 if there is none. */
+        LogState* pState{NULL};                   /**< Log state of current thread in logState of that instance. */
+        RepeatState lastLine;                     /**< Kept here so it is still alive when the thread exits and its repeats are written. */
+
+        ~ThreadStateGuard();
+    };
+
+    static thread_local ThreadStateGuard threadStateGuard;  /**< Log state of current thread, see getLogState(). */
+    static thread_local FilterState filterState;     /**< Filter-related state of current thread, see FilterState. */
+    static std::atomic<unsigned int> nActiveInstanceId;  /**< nInstanceId of the initialized instance, 0 if there is none. */
+    static std::atomic<bool> bErrorsAlwaysOn;        /**< Should module error logs always appear or not. */
+    static std::atomic<int>  nLoggingLevel;          /**< Runtime minimum log level of the level macros. */
+    static std::atomic<int>  nErrorBacklogLines;     /**< Capacity of Backlog of every thread, 0 if suppressed lines are not kept. */
+    static std::atomic<int>  nRepeatedLinesTimeout;  /**< Max time in millisecs identical lines are collapsed for, 0 if they are not collapsed. */
+
+    static bool isSurelyFilteredOut(
+        CConsole::FormatSignal mode, bool nl);       /**< Tells without mainMutex if a printout of current thread would be filtered out. */
+    static bool mightBeRepeatedLine(
+        CConsole::FormatSignal mode, const char* fmt);  /**< Tells without mainMutex if a line of current thread might repeat its last line. */
+    static bool isRepeatedLine(
+        CConsole::FormatSignal mode,
+        const char* fmt, va_list list);              /**< Tells without mainMutex if a line of current thread repeats its last line, counts it if so. */
+    static bool isRepeatedLine(
+        CConsole::FormatSignal mode,
+        const CConsoleFormat::Format& format,
+        const CConsoleFormat::Arg* args);            /**< Tells without mainMutex if a line of current thread repeats its last line, counts it if so. */
+    static bool CountRepeatedLine();                 /**< Counts the line being compared if its argument values are the same as of the last line. */
+
+    /**
+        Counters of CConsole::getStats().
+        Lock-free, since they are updated by logging threads with or without mainMutex, and by writerThread.
+    */
+    struct StatCounters
+    {
+        std::atomic<std::uint64_t> nLines[CCONSOLE_MAX_LOGGER_MODULES][3];            /**< Lines written, indexed by module handle and mode. */
+        std::atomic<std::uint64_t> nSuppressedLines[CCONSOLE_MAX_LOGGER_MODULES][3];  /**< Lines dropped by filters, indexed by module handle and mode. */
+        std::atomic<std::uint64_t> nSinkBytes[CCONSOLE_SINK_COUNT];                   /**< Bytes written, indexed by CConsole::Sink. */
+        std::atomic<std::uint64_t> nFlushes;                                          /**< Number of FlushSinks() calls. */
+        std::atomic<std::uint64_t> nSinkWriteNanosecs;                                /**< Time spent in WriteRecord() and FlushSinks(). */
+    };
+
+    static StatCounters stats;                       /**< Counters of CConsole::getStats(), zero-initialized as static. */
+
+    static void CountLine(
+        CConsole::ModuleHandle loggerModule, int nMode, bool bSuppressed);   /**< Counts a written or suppressed line. */
+    static void CountSuppressedLine(CConsole::FormatSignal mode);            /**< Counts a suppressed line of current thread without mainMutex. */
+
+    static constexpr size_t CCONSOLE_CRASH_FILENAME_SIZE = 1024;  /**< Max length of the crash file name, including terminating zero. */
+
+    static CConsoleFlightRecorder::Ring flightRecorder;      /**< Most recent records of the process, always recorded, see CConsoleFlightRecorder.h. */
+    static char szCrashFilename[CCONSOLE_CRASH_FILENAME_SIZE];  /**< The crash handler writes flightRecorder here, to stderr if empty. */
+    static bool bCrashHandlerSet;                            /**< True if CrashSignalHandler() is installed. */
+
+    static constexpr int CCONSOLE_CRASH_SIGNALS[] =
+    {
+        SIGSEGV, SIGABRT, SIGFPE, SIGILL
+#ifdef SIGBUS
+        , SIGBUS
+#endif
+    };                                                       /**< Fatal signals handled by CrashSignalHandler(). */
+    static constexpr size_t CCONSOLE_CRASH_SIGNAL_COUNT = sizeof(CCONSOLE_CRASH_SIGNALS) / sizeof(CCONSOLE_CRASH_SIGNALS[0]);
+#ifdef _WIN32
+    static void (*prevCrashHandlers[CCONSOLE_CRASH_SIGNAL_COUNT])(int);     /**< Handlers replaced by InstallCrashHandler(). */
+#else
+    static struct sigaction prevCrashActions[CCONSOLE_CRASH_SIGNAL_COUNT];  /**< Handlers replaced by InstallCrashHandler(). */
+#endif
+
+    static void InstallCrashHandler();                       /**< Installs CrashSignalHandler() for the fatal signals. */
+    static void RemoveCrashHandler();                        /**< Restores the previous handlers of the fatal signals. */
+    static void CrashSignalHandler(int sig);                 /**< Writes flightRecorder on a fatal signal, then invokes the previous handler. */
+
+
+    /**
+        Bounded lock-free multi-producer single-consumer queue of LogRecords.
+        Based on Dmitry Vyukov's bounded MPMC queue: every cell has a sequence number telling whether
+        the cell is free for the producer or ready for the consumer at the current position.
+        Only the writer thread pops, so the consumer side does not need compare-and-swap.
+    */
+    class LogQueue
+    {
+    public:
+        explicit LogQueue(size_t nCapacity);
+
+        bool tryPush(LogRecord& rec);   /**< Moves rec into the queue, returns false if the queue is full. */
+        bool tryPop(LogRecord& rec);    /**< Moves the oldest record into rec, returns false if the queue is empty. */
+        bool isEmpty() const;           /**< Tells if there is nothing to be popped right now. */
+
+    private:
+        struct Cell
+        {
+            std::atomic<size_t> nSeq;
+            LogRecord rec;
+        };
+
+        const size_t nMask;
+        std::unique_ptr<Cell[]> cells;
+        char padding1[64];                  /**< Keeps producer and consumer positions on different cache lines. */
+        std::atomic<size_t> nEnqueuePos;
+        char padding2[64];
+        std::atomic<size_t> nDequeuePos;
+
+        LogQueue(const LogQueue&);
+        LogQueue& operator=(const LogQueue&);
     };
 
     // ---------------------------------------------------------------------------
 
     bool bInited;                              /**< False by default, Initialize() sets it to true, Deinitialize() sets it to false. */
-    int  nRefCount;                            /**< 0 by default, Initialize() increases it by 1, Deinitialize() decreases it by 1. */ 
-    bool bFirstWriteTextCallAfterWriteTextLn;  /**< True if we are at the 1st no-new-line-print after a new-line-print. */
 
-    std::map<std::thread::id, LogState> logState;  /**< Per-thread log state. */
+    std::map<std::thread::id, LogState> logState;  /**< Per-thread log state, use getLogState() to access the state of current thread. */
+    unsigned int nInstanceId;                      /**< Unique id of this instance, key of the per-thread cache in getLogState(). */
     
-    HANDLE hConsole;                    /**< Console output handle. */
+    std::unique_ptr<LogSink> sinks[CCONSOLE_SINK_COUNT];  /**< Open sinks indexed by CConsole::Sink, NULL if the sink is closed. */
 
-    char  vmi[80];                   /**< Temp, always used for the current printout. */
     DWORD wrt;                       /**< Temp, always used for the current printout. */
     WORD  oldClrFG;                  /**< Temp, always used for the current printout. */
     char  oldClrFGhtml[HTML_CLR_S];  /**< Temp, always used for the current printout. */
 
-    std::ofstream fLog;
-    bool bAllowLogFile;
-
-    std::set<std::string> enabledModules;  /**< Contains logger module names for which logging is enabled. */
-    bool        bErrorsAlwaysOn;           /**< Should module error logs always appear or not. */
+    std::string sLogTitle;              /**< Title given to Initialize(), also written to the binary log file. */
+    std::string sLogFilename;           /**< Name of the html log file, name of the binary log file is derived from this. */
+
+    bool          bBinaryLog;           /**< True if logs are written unformatted to fBinaryLog instead of console and html log file. */
+    std::ofstream fBinaryLog;
+    std::string   sBinaryBuffer;        /**< Encoded records not yet written to fBinaryLog. */
+    std::map<std::string, std::uint32_t, std::less<>>
+        binaryFormatIds;                /**< Format strings already written to fBinaryLog in current session, with their ids. */
+    std::vector<bool> binaryModulesWritten;  /**< Tells for every logger module if its name is already written to fBinaryLog in current session. */
+    std::uint16_t nLastThreadIndex;     /**< Last thread index given to a thread in binary log file. */
+    const char*   binaryRecordFmt;      /**< Format string of the record being appended, for flightRecorder. */
+    std::uint8_t  binaryRecordFlags;    /**< Flags of the record being appended, for flightRecorder. */
+    size_t        nBinaryRecordArgs;    /**< Position of the argument values of the record being appended in sBinaryBuffer. */
+
+    bool      bAsync;                         /**< True if logs are written by writerThread instead of the logging threads. */
+    std::unique_ptr<LogQueue> asyncQueue;     /**< Records waiting for writerThread in async mode. */
+    std::thread writerThread;                 /**< Writes the queued records to console and log file in async mode. */
+    std::atomic<bool> bWriterRunning;         /**< Cleared by StopWriterThread() to make writerThread drain the queue and exit. */
+    std::atomic<bool> bWriterSleeping;        /**< True while writerThread is waiting for new records. */
+    std::mutex writerMutex;                   /**< Used only for waking up writerThread. */
+    std::condition_variable writerCv;         /**< Used only for waking up writerThread. */
+
+    std::thread tickThread;                   /**< Does periodic work that cannot wait for the next log, see Tick(). */
+    std::atomic<bool> bTickRunning;           /**< Cleared by StopTickThread() to make tickThread exit. */
+    std::mutex tickMutex;                     /**< Used only for waking up tickThread. */
+    std::condition_variable tickCv;           /**< Used only for waking up tickThread. */
+
+    bool bCompactHtml;                        /**< True if the html log file is written in compact html. */
+
+    bool bDumpingBacklog;                     /**< True while DumpBacklog() is writing, filter settings are bypassed then. */
+    bool bWritingCounts;                      /**< True while counts of repeated or dropped lines are written, filter settings are bypassed then. */
+    LogState siteDropsState;                  /**< Log state for writing the dropped logs of silent call sites, see WriteSiteDrops(). */
+    bool bWritingBatch;                       /**< True while WriteBatch() is writing, sinks are flushed only at its end then. */
+    bool bBatchFlushDue;                      /**< Set if a line written by WriteBatch() should have flushed the sinks. */
+
+    std::atomic<CConsole::FlushPolicy> flushPolicy;   /**< When the sinks are flushed, see CConsole::SetFlushPolicy(). */
+    std::atomic<int> nFlushIntervalMillisecs;         /**< Time between flushes with FlushPolicy::Interval. */
+    std::chrono::steady_clock::time_point
+        timeLastFlush;                                /**< Time of last FlushSinks(), used by the thread writing the sinks. */
+    std::atomic<unsigned int> nFlushRequests;         /**< Incremented by Flush() in async mode to make writerThread flush the sinks. */
+    std::atomic<unsigned int> nFlushesDone;           /**< Last value of nFlushRequests handled by writerThread. */
+    bool bUnflushedLines;                             /**< Set in sync mode if lines were written since the last flush by FlushPolicy::Interval. */
 
     // ---------------------------------------------------------------------------
 
@@ -247,21 +821,106 @@ private:
 
     virtual ~CConsoleImpl();
 
+    LogState& getLogState();                  /**< Gets the log state of current thread. */
+    int  getRefCount() const;                 /**< Gets the sum of the reference counts of all threads. */
+    void ReleaseRef();                        /**< Decreases the reference count of current thread, or of another thread if it has none. */
+    bool ReleaseThreadState();                /**< Releases the log state of current thread, tells if the reference count reached 0 by this. */
+    void PublishFilterState(const LogState& state);  /**< Updates filterState from the log state of current thread. */
     bool canWeWriteBasedOnFilterSettings();
 
+    std::string* BacklogBeginPrintout(
+        const char* fmt, bool nl);                   /**< Starts recording a suppressed printout of current thread into its backlog. */
+    template <class T>
+    void BacklogValue(const char* fmt, T value);     /**< Records a suppressed single value printed by operator<< into the backlog. */
+    void DumpBacklog();                              /**< Writes the backlog of current thread, then clears it. */
+    bool WriteEncodedPrintout(
+        const char*& p, const char* end,
+        int nBaseIndent);                            /**< Decodes and writes a single printout of the backlog or of a batch. */
+
+    static void BatchAdd(
+        std::string& sPrintouts,
+        CConsole::FormatSignal mode, int nIndent, bool nl,
+        const char* fmt, va_list list);              /**< Encodes a printout into a CConsole::Batch. */
+    void WriteBatch(
+        const std::string& sPrintouts,
+        int nBatchIndent);                           /**< Writes the printouts of a CConsole::Batch. */
+
+    std::string* RememberLine(const char* fmt);      /**< Makes the line just written by current thread its last line for detecting repeats. */
+    void EndRepeats();                               /**< Writes how many times the last line of current thread was repeated, then forgets that line. */
+    void WriteRepeatCount(
+        const RepeatState& lastLine,
+        unsigned long long nRepeats);                /**< Writes how many times the given last line was repeated. */
+    void WritePendingRepeats(bool bAll);             /**< Writes the repeats of the last lines of all threads, see RepeatState. */
+    void WriteSiteDrops(bool bAll);                  /**< Writes the dropped logs of the silent call sites of the rate-limited log macros. */
+    void SwitchMode(int nFrom, int nTo);             /**< Switches current thread from one mode to another. */
+
+    void SetConsoleAttr(WORD clr);                  /**< Sets the console text attribute for subsequent AddSpan() calls. */
+    void AddSpan(
+        LogRecord::SpanType type,
+        const char* text,
+        size_t len,
+        const char* clrHtml = NULL);                /**< Appends a span to the current line of current thread. */
+    void CommitLine(LogState& state);               /**< Writes or queues the collected line of the given thread. */
+    void RecordFlightText(const LogRecord& rec);    /**< Records the plain text of a line into flightRecorder. */
+    void RecordFlightBinary();                      /**< Records the binary record being appended into flightRecorder. */
+    void CommitFinishedLine();                      /**< Writes or queues the collected line of current thread if it is finished. */
+    void CommitAllLines();                          /**< Writes or queues the collected lines of all threads, even if not finished. */
+    void WriteRecord(const LogRecord& rec);         /**< Writes a record to the sinks. */
+    void FlushSinks();                              /**< Flushes the open sinks. */
+    bool isFlushDue(int nMode) const;               /**< Tells if the sinks should be flushed after writing a record of the given mode. */
+    std::unique_ptr<LogSink> CreateSink(
+        CConsole::Sink sink, const char* filename); /**< Creates and opens a sink. */
+    void StartWriterThread();                       /**< Starts writerThread. */
+    void StopWriterThread();                        /**< Makes writerThread write all queued records and then stops it. */
+    void WriterThreadMain();                        /**< Main function of writerThread. */
+    void StartTickThread();                         /**< Starts tickThread. */
+    void StopTickThread();                          /**< Stops tickThread. */
+    void TickThreadMain();                          /**< Main function of tickThread. */
+    void Tick();                                    /**< Periodic work of tickThread, with mainMutex held. */
+
+    void BinaryBeginRecord(
+        const char* fmt, std::uint8_t flags);       /**< Appends a log record without argument values to the binary buffer. */
+    void BinaryEndRecord();                         /**< Writes the binary buffer to fBinaryLog if it is big enough. */
+    void BinaryFlush();                             /**< Writes the binary buffer to fBinaryLog. */
+    static void PutFormattedArgs(
+        std::string& buf,
+        const char* fmt, va_list list);             /**< Appends the raw arguments of a format string to buf. */
+    static void PutCompiledArgs(
+        std::string& buf,
+        const CConsoleFormat::Format& format,
+        const CConsoleFormat::Arg* args);           /**< Appends the raw arguments of a compile-time parsed format string to buf. */
+    void BinaryWriteFormattedText(
+        const char* fmt, va_list list, bool nl);    /**< Writes text with its raw arguments to the binary log. */
+    void BinaryWriteCompiledFormat(
+        const CConsoleFormat::Format& format,
+        const CConsoleFormat::Arg* args,
+        bool nl);                                   /**< Writes text with compile-time parsed format with its raw arguments to the binary log. */
+    template <class T>
+    void BinaryWriteValue(const char* fmt, T value);  /**< Writes a single value printed by operator<< to the binary log. */
+
     void ImmediateWriteString(const char* text);    /**< Directly writes formatted string value to the console. */
     void ImmediateWriteBool(bool b);                /**< Directly writes formatted boolean value to the console. */
-    void ImmediateWriteInt(int n);                  /**< Directly writes formatted signed integer value to the console. */
-    void ImmediateWriteUInt(unsigned int n);        /**< Directly writes formatted unsigned integer value to the console. */
-    void ImmediateWriteFloat(float f);              /**< Directly writes formatted floating-point value to the console. */
+    void ImmediateWriteInt(long long n);            /**< Directly writes formatted signed integer value to the console. */
+    void ImmediateWriteUInt(unsigned long long n);  /**< Directly writes formatted unsigned integer value to the console. */
+    void ImmediateWriteFloat(double f);             /**< Directly writes formatted floating-point value to the console. */
     
     void WriteText(const char* text);             /**< Directly writes unformatted text to the console. */
+    void WriteIndentation();                      /**< Writes the indentation if current thread is at the start of a line. */
     void WriteFormattedTextEx(
         const char* fmt, va_list list);           /**< Writes text to the console. */
 
     void WriteFormattedTextExCaller(
         const char* fmt, va_list list, bool nl);  /**< Writes text to the console. */
 
+    void WriteCompiledFormat(
+        const CConsoleFormat::Format& format,
+        const CConsoleFormat::Arg* args);         /**< Writes text with compile-time parsed format to the console. */
+
+    void WriteCompiledFormatCaller(
+        const CConsoleFormat::Format& format,
+        const CConsoleFormat::Arg* args,
+        bool nl);                                 /**< Writes text with compile-time parsed format to the console. */
+
     friend class CConsole;
 
 }; // class CConsoleImpl
@@ -298,6 +957,13 @@ void CConsole::CConsoleImpl::DeleteOldLogFiles(size_t nKeep)
             {
                 EOLn("  ERROR: Could not remove above file, error code: %d, message: %s", errCode.value(), errCode.message().c_str());
             }
+            // binary, text and JSON-lines log files of the same run, if any
+            for (const char* extension : { CConsoleBinaryLog::FILE_EXTENSION, ".txt", ".jsonl" })
+            {
+                std::filesystem::path siblingLogFile = logFile;
+                siblingLogFile.replace_extension(extension);
+                std::filesystem::remove(siblingLogFile, errCode);
+            }
             if (++iLogFileToDelete == nLogFilesToDelete)
             {
                 break;
@@ -313,7 +979,21 @@ void CConsole::CConsoleImpl::DeleteOldLogFiles(size_t nKeep)
 */
 void CConsole::CConsoleImpl::SetLoggerModuleName(const char* loggerModuleName)
 {
-    logState[std::this_thread::get_id()].sLoggerName = loggerModuleName;
+    LogState& state = getLogState();
+    state.loggerModule = registerModule(loggerModuleName);
+    PublishFilterState(state);
+}
+
+
+/**
+    Sets the current logger module.
+    Per-thread property.
+*/
+void CConsole::CConsoleImpl::SetLoggerModule(CConsole::ModuleHandle loggerModule)
+{
+    LogState& state = getLogState();
+    state.loggerModule = loggerModule;
+    PublishFilterState(state);
 }
 
 
@@ -332,13 +1012,13 @@ bool CConsole::CConsoleImpl::getLoggingState(const char* loggerModuleName)
         return false;
     }
 
-    std::string sLoggerModuleName = loggerModuleName;
-    if (sLoggerModuleName.empty())
+    if (loggerModuleName[0] == '\0')
     {
         return true;
     }
 
-    return enabledModules.end() != enabledModules.find(sLoggerModuleName);
+    const CConsole::ModuleHandle loggerModule = findModule(loggerModuleName);
+    return (loggerModule != CConsole::ModuleHandle::None) && isModuleEnabled(loggerModule);
 }
 
 
@@ -365,7 +1045,7 @@ void CConsole::CConsoleImpl::SetLoggingState(const char* loggerModuleName, bool
     if (newNameLoggerModule == nullptr)
         return;
 
-    strncpy_s(newNameLoggerModule, sizeOfLoggerModuleNameBuffer, loggerModuleName, sizeOfLoggerModuleNameBuffer);
+    memcpy(newNameLoggerModule, loggerModuleName, sizeOfLoggerModuleNameBuffer);
     PFL::strClr(newNameLoggerModule);
     if (strlen(newNameLoggerModule) == 0)
     {
@@ -374,13 +1054,26 @@ void CConsole::CConsoleImpl::SetLoggingState(const char* loggerModuleName, bool
     }
     free(newNameLoggerModule);
 
+    const CConsole::ModuleHandle loggerModule = state ? registerModule(loggerModuleName) : findModule(loggerModuleName);
+    if (loggerModule == CConsole::ModuleHandle::None)
+    {
+        return;
+    }
+
+    const size_t nModule = static_cast<size_t>(loggerModule);
+    const std::uint64_t nBit = std::uint64_t(1) << (nModule % 64);
     if (state)
     {
-        enabledModules.insert(loggerModuleName);
+        enabledModules[nModule / 64].fetch_or(nBit, std::memory_order_relaxed);
     }
     else
     {
-        enabledModules.erase(loggerModuleName);
+        enabledModules[nModule / 64].fetch_and(~nBit, std::memory_order_relaxed);
+    }
+
+    if (strcmp(loggerModuleName, CCONSOLE_ALL_MODULES) == 0)
+    {
+        bAllModulesEnabled.store(state, std::memory_order_relaxed);
     }
 } // SetLoggingState 
 
@@ -402,6 +1095,158 @@ void CConsole::CConsoleImpl::SetErrorsAlwaysOn(bool state)
 } // SetErrorsAlwaysOn()
 
 
+/**
+    Gets runtime minimum log level of the level macros.
+    Per-process property.
+*/
+int CConsole::CConsoleImpl::getLoggingLevel()
+{
+    if ( !bInited )
+        return CCONSOLE_LEVEL_TRACE;
+
+    return nLoggingLevel.load(std::memory_order_relaxed);
+} // getLoggingLevel()
+
+
+/**
+    Sets runtime minimum log level of the level macros.
+    Default value is CCONSOLE_LEVEL_TRACE.
+    Per-process property.
+*/
+void CConsole::CConsoleImpl::SetLoggingLevel(int level)
+{
+    if ( !bInited )
+        return;
+
+    nLoggingLevel.store(level, std::memory_order_relaxed);
+} // SetLoggingLevel()
+
+
+/**
+    Gets the number of suppressed lines kept per thread for dumping them on error.
+    Per-process property.
+*/
+int CConsole::CConsoleImpl::getErrorBacklogLines()
+{
+    if ( !bInited )
+        return 0;
+
+    return nErrorBacklogLines.load(std::memory_order_relaxed);
+} // getErrorBacklogLines()
+
+
+/**
+    Sets the number of suppressed lines kept per thread for dumping them on error.
+    Lines already kept by the threads are dropped.
+    Per-process property.
+*/
+void CConsole::CConsoleImpl::SetErrorBacklogLines(int lines)
+{
+    if ( !bInited )
+        return;
+
+    nErrorBacklogLines.store((lines > 0) ? lines : 0, std::memory_order_relaxed);
+    for (auto& it : logState)
+    {
+        it.second.backlog.Clear();
+    }
+} // SetErrorBacklogLines()
+
+
+/**
+    Gets the max time consecutive identical lines of a thread are collapsed for, 0 if they are not collapsed.
+    Per-process property.
+*/
+int CConsole::CConsoleImpl::getRepeatedLinesTimeout()
+{
+    if ( !bInited )
+        return 0;
+
+    return nRepeatedLinesTimeout.load(std::memory_order_relaxed);
+} // getRepeatedLinesTimeout()
+
+
+/**
+    Sets consecutive identical lines of a thread to be collapsed and for how long.
+    Per-process property.
+*/
+void CConsole::CConsoleImpl::SetRepeatedLinesTimeout(int millisecs)
+{
+    if ( !bInited )
+        return;
+
+    nRepeatedLinesTimeout.store((millisecs > 0) ? millisecs : 0, std::memory_order_relaxed);
+} // SetRepeatedLinesTimeout()
+
+
+/**
+    Writes how many logs were dropped at a call site of the rate-limited log macros, and counts them as suppressed lines.
+    @param mode   N for logs printed in current mode, S for logs printed in success mode, E for logs printed in error mode.
+    @param lines  Number of dropped logs.
+    @param szFile Source file of the call site, written only if not NULL.
+    @param nLine  Source line of the call site.
+*/
+void CConsole::CConsoleImpl::WriteDroppedLines(CConsole::FormatSignal mode, unsigned long long lines, const char* szFile, int nLine)
+{
+    if ( !bInited )
+        return;
+
+    const LogState& state = getLogState();
+    const int nMode = (mode == CConsole::E) ? 1 : ((mode == CConsole::S) ? 2 : state.nMode);
+    stats.nSuppressedLines[static_cast<size_t>(state.loggerModule)][nMode].fetch_add(lines, std::memory_order_relaxed);
+
+    if ( szFile )
+    {
+        const char* const fmt = (lines == 1) ? "%llu similar log was dropped by rate limit at %s:%d" : "%llu similar logs were dropped by rate limit at %s:%d";
+        if ( mode == CConsole::E )
+            EOLn(fmt, lines, szFile, nLine);
+        else if ( mode == CConsole::S )
+            SOLn(fmt, lines, szFile, nLine);
+        else
+            OLn(fmt, lines, szFile, nLine);
+        return;
+    }
+
+    const char* const fmt = (lines == 1) ? "%llu similar log was dropped by rate limit" : "%llu similar logs were dropped by rate limit";
+    if ( mode == CConsole::E )
+        EOLn(fmt, lines);
+    else if ( mode == CConsole::S )
+        SOLn(fmt, lines);
+    else
+        OLn(fmt, lines);
+} // WriteDroppedLines()
+
+
+/**
+    Sets the most recent records to be written to a crash file on fatal signals or not.
+    Crash file is next to the log file, stderr is used instead if there is no log file.
+    Per-process property.
+*/
+void CConsole::CConsoleImpl::SetCrashHandler(bool state)
+{
+    if ( !bInited )
+        return;
+
+    if ( !state )
+    {
+        RemoveCrashHandler();
+        return;
+    }
+
+    const std::string sCrashFilename = sLogFilename.empty() ?
+        std::string() : (sLogFilename.substr(0, sLogFilename.rfind('.')) + CConsoleFlightRecorder::CRASH_FILE_EXTENSION);
+    if ( sCrashFilename.length() < CCONSOLE_CRASH_FILENAME_SIZE )
+    {
+        strcpy(szCrashFilename, sCrashFilename.c_str());
+    }
+    else
+    {
+        szCrashFilename[0] = '\0';
+    }
+    InstallCrashHandler();
+} // SetCrashHandler()
+
+
 /**
     Gets the current indentation.
     Per-thread property.
@@ -411,7 +1256,7 @@ int CConsole::CConsoleImpl::getIndent()
     if ( !bInited )
         return 0;
 
-    return logState[std::this_thread::get_id()].nIndentValue;
+    return getLogState().nIndentValue;
 } // getIndent()
 
 
@@ -424,9 +1269,13 @@ void CConsole::CConsoleImpl::SetIndent(int value)
     if ( !bInited )
         return;
 
-    logState[std::this_thread::get_id()].nIndentValue = value;
-    if (logState[std::this_thread::get_id()].nIndentValue < 0)
-        logState[std::this_thread::get_id()].nIndentValue = 0;
+    EndRepeats();
+    LogState& state = getLogState();
+    if ( state.backlog.bDumpPending && (value > state.nIndentValue) )
+        DumpBacklog();
+    state.nIndentValue = value;
+    if (state.nIndentValue < 0)
+        state.nIndentValue = 0;
 } // SetIndent()
 
 
@@ -439,7 +1288,11 @@ void CConsole::CConsoleImpl::Indent()
     if ( !bInited )
         return;
 
-    logState[std::this_thread::get_id()].nIndentValue += CConsoleImpl::CCONSOLE_INDENTATION_CHANGE;
+    EndRepeats();
+    LogState& state = getLogState();
+    if ( state.backlog.bDumpPending )
+        DumpBacklog();
+    state.nIndentValue += CConsoleImpl::CCONSOLE_INDENTATION_CHANGE;
 } // Indent()
 
 
@@ -452,9 +1305,13 @@ void CConsole::CConsoleImpl::IndentBy(int value)
     if ( !bInited )
         return;
 
-    logState[std::this_thread::get_id()].nIndentValue += value;
-    if (logState[std::this_thread::get_id()].nIndentValue < 0)
-        logState[std::this_thread::get_id()].nIndentValue = 0;
+    EndRepeats();
+    LogState& state = getLogState();
+    if ( state.backlog.bDumpPending && (value > 0) )
+        DumpBacklog();
+    state.nIndentValue += value;
+    if (state.nIndentValue < 0)
+        state.nIndentValue = 0;
 } // IndentBy()
 
 
@@ -467,9 +1324,11 @@ void CConsole::CConsoleImpl::Outdent()
     if ( !bInited )
         return;
 
-    logState[std::this_thread::get_id()].nIndentValue -= CConsoleImpl::CCONSOLE_INDENTATION_CHANGE;
-    if (logState[std::this_thread::get_id()].nIndentValue < 0)
-        logState[std::this_thread::get_id()].nIndentValue = 0;
+    EndRepeats();
+    LogState& state = getLogState();
+    state.nIndentValue -= CConsoleImpl::CCONSOLE_INDENTATION_CHANGE;
+    if (state.nIndentValue < 0)
+        state.nIndentValue = 0;
 } // Outdent()
 
 
@@ -482,9 +1341,11 @@ void CConsole::CConsoleImpl::OutdentBy(int value)
     if ( !bInited )
         return;
 
-    logState[std::this_thread::get_id()].nIndentValue -= value;
-    if (logState[std::this_thread::get_id()].nIndentValue < 0)
-        logState[std::this_thread::get_id()].nIndentValue = 0;
+    EndRepeats();
+    LogState& state = getLogState();
+    state.nIndentValue -= value;
+    if (state.nIndentValue < 0)
+        state.nIndentValue = 0;
 } // OutdentBy()
 
 
@@ -497,11 +1358,12 @@ void CConsole::CConsoleImpl::LoadColors()
     if ( !bInited )
         return;
 
-    SetFGColor(logState[std::this_thread::get_id()].dLastFGColor, logState[std::this_thread::get_id()].dLastBoolsColorHtml);
-    SetStringsColor(logState[std::this_thread::get_id()].dLastStringsColor, logState[std::this_thread::get_id()].dLastStringsColorHtml);
-    SetFloatsColor(logState[std::this_thread::get_id()].dLastFloatsColor, logState[std::this_thread::get_id()].dLastFloatsColorHtml);
-    SetIntsColor(logState[std::this_thread::get_id()].dLastIntsColor, logState[std::this_thread::get_id()].dLastIntsColorHtml);
-    SetBoolsColor(logState[std::this_thread::get_id()].dLastBoolsColor, logState[std::this_thread::get_id()].dLastBoolsColorHtml);
+    LogState& state = getLogState();
+    SetFGColor(state.dLastFGColor, state.dLastBoolsColorHtml);
+    SetStringsColor(state.dLastStringsColor, state.dLastStringsColorHtml);
+    SetFloatsColor(state.dLastFloatsColor, state.dLastFloatsColorHtml);
+    SetIntsColor(state.dLastIntsColor, state.dLastIntsColorHtml);
+    SetBoolsColor(state.dLastBoolsColor, state.dLastBoolsColorHtml);
 } // LoadColors()
 
 
@@ -516,16 +1378,17 @@ void CConsole::CConsoleImpl::SaveColors()
     //if (!bInited)
     //    return;
 
-    logState[std::this_thread::get_id()].dLastFGColor = logState[std::this_thread::get_id()].clrFG;
-    logState[std::this_thread::get_id()].dLastStringsColor = logState[std::this_thread::get_id()].clrStrings;
-    logState[std::this_thread::get_id()].dLastFloatsColor = logState[std::this_thread::get_id()].clrFloats;
-    logState[std::this_thread::get_id()].dLastIntsColor = logState[std::this_thread::get_id()].clrInts;
-    logState[std::this_thread::get_id()].dLastBoolsColor = logState[std::this_thread::get_id()].clrBools;
-    strcpy(logState[std::this_thread::get_id()].dLastFGColorHtml, logState[std::this_thread::get_id()].clrFGhtml);
-    strcpy(logState[std::this_thread::get_id()].dLastStringsColorHtml, logState[std::this_thread::get_id()].clrStringsHtml);
-    strcpy(logState[std::this_thread::get_id()].dLastFloatsColorHtml, logState[std::this_thread::get_id()].clrFloatsHtml);
-    strcpy(logState[std::this_thread::get_id()].dLastIntsColorHtml, logState[std::this_thread::get_id()].clrIntsHtml);
-    strcpy(logState[std::this_thread::get_id()].dLastBoolsColorHtml, logState[std::this_thread::get_id()].clrBoolsHtml);
+    LogState& state = getLogState();
+    state.dLastFGColor = state.clrFG;
+    state.dLastStringsColor = state.clrStrings;
+    state.dLastFloatsColor = state.clrFloats;
+    state.dLastIntsColor = state.clrInts;
+    state.dLastBoolsColor = state.clrBools;
+    strcpy(state.dLastFGColorHtml, state.clrFGhtml);
+    strcpy(state.dLastStringsColorHtml, state.clrStringsHtml);
+    strcpy(state.dLastFloatsColorHtml, state.clrFloatsHtml);
+    strcpy(state.dLastIntsColorHtml, state.clrIntsHtml);
+    strcpy(state.dLastBoolsColorHtml, state.clrBoolsHtml);
 #endif
 }
 
@@ -541,29 +1404,30 @@ void CConsole::CConsoleImpl::RestoreDefaultColors()
     //if (!bInited)
     //    return;
 
-    logState[std::this_thread::get_id()].clrFG = CCONSOLE_DEF_CLR_FG;
-    logState[std::this_thread::get_id()].clrBG = 0;
-    logState[std::this_thread::get_id()].clrInts = logState[std::this_thread::get_id()].clrFG;
-    logState[std::this_thread::get_id()].clrFloats = logState[std::this_thread::get_id()].clrFG;
-    logState[std::this_thread::get_id()].clrStrings = logState[std::this_thread::get_id()].clrFG;
-    logState[std::this_thread::get_id()].clrBools = logState[std::this_thread::get_id()].clrFG;
-
-    memset(logState[std::this_thread::get_id()].clrFGhtml, 0, HTML_CLR_S);
-    memset(logState[std::this_thread::get_id()].clrStringsHtml, 0, HTML_CLR_S);
-    memset(logState[std::this_thread::get_id()].clrIntsHtml, 0, HTML_CLR_S);
-    memset(logState[std::this_thread::get_id()].clrFloatsHtml, 0, HTML_CLR_S);
-    memset(logState[std::this_thread::get_id()].clrBoolsHtml, 0, HTML_CLR_S);
-    memset(logState[std::this_thread::get_id()].dLastFGColorHtml, 0, HTML_CLR_S);
-    memset(logState[std::this_thread::get_id()].dLastStringsColorHtml, 0, HTML_CLR_S);
-    memset(logState[std::this_thread::get_id()].dLastIntsColorHtml, 0, HTML_CLR_S);
-    memset(logState[std::this_thread::get_id()].dLastFloatsColorHtml, 0, HTML_CLR_S);
-    memset(logState[std::this_thread::get_id()].dLastBoolsColorHtml, 0, HTML_CLR_S);
-
-    strcpy(logState[std::this_thread::get_id()].clrFGhtml, "999999");
-    strcpy(logState[std::this_thread::get_id()].clrIntsHtml, logState[std::this_thread::get_id()].clrFGhtml);
-    strcpy(logState[std::this_thread::get_id()].clrFloatsHtml, logState[std::this_thread::get_id()].clrFGhtml);
-    strcpy(logState[std::this_thread::get_id()].clrStringsHtml, logState[std::this_thread::get_id()].clrFGhtml);
-    strcpy(logState[std::this_thread::get_id()].clrBoolsHtml, logState[std::this_thread::get_id()].clrFGhtml);
+    LogState& state = getLogState();
+    state.clrFG = CCONSOLE_DEF_CLR_FG;
+    state.clrBG = 0;
+    state.clrInts = state.clrFG;
+    state.clrFloats = state.clrFG;
+    state.clrStrings = state.clrFG;
+    state.clrBools = state.clrFG;
+
+    memset(state.clrFGhtml, 0, HTML_CLR_S);
+    memset(state.clrStringsHtml, 0, HTML_CLR_S);
+    memset(state.clrIntsHtml, 0, HTML_CLR_S);
+    memset(state.clrFloatsHtml, 0, HTML_CLR_S);
+    memset(state.clrBoolsHtml, 0, HTML_CLR_S);
+    memset(state.dLastFGColorHtml, 0, HTML_CLR_S);
+    memset(state.dLastStringsColorHtml, 0, HTML_CLR_S);
+    memset(state.dLastIntsColorHtml, 0, HTML_CLR_S);
+    memset(state.dLastFloatsColorHtml, 0, HTML_CLR_S);
+    memset(state.dLastBoolsColorHtml, 0, HTML_CLR_S);
+
+    strcpy(state.clrFGhtml, "999999");
+    strcpy(state.clrIntsHtml, state.clrFGhtml);
+    strcpy(state.clrFloatsHtml, state.clrFGhtml);
+    strcpy(state.clrStringsHtml, state.clrFGhtml);
+    strcpy(state.clrBoolsHtml, state.clrFGhtml);
 #endif
 }
 
@@ -577,7 +1441,7 @@ WORD CConsole::CConsoleImpl::getFGColor()
     if ( !bInited )
         return 0;
 
-    return logState[std::this_thread::get_id()].clrFG;
+    return getLogState().clrFG;
 } // getFGColor()
 
 
@@ -590,7 +1454,7 @@ const char* CConsole::CConsoleImpl::getFGColorHtml()
     if ( !bInited )
         return "#DDBEEF";
 
-    return logState[std::this_thread::get_id()].clrFGhtml;
+    return getLogState().clrFGhtml;
 } // getFGColorHtml()
 
 
@@ -603,10 +1467,11 @@ void CConsole::CConsoleImpl::SetFGColor(WORD clr, const char* html)
     if ( !bInited )
         return;
 
-    logState[std::this_thread::get_id()].clrFG = clr;
-    SetConsoleTextAttribute(hConsole, logState[std::this_thread::get_id()].clrFG | logState[std::this_thread::get_id()].clrBG);
+    LogState& state = getLogState();
+    state.clrFG = clr;
+    SetConsoleAttr(state.clrFG | state.clrBG);
     if (html)
-        strcpy_s(logState[std::this_thread::get_id()].clrFGhtml, CConsoleImpl::HTML_CLR_S, html);
+        snprintf(state.clrFGhtml, CConsoleImpl::HTML_CLR_S, "%s", html);
 } // SetFGColor()
 
 
@@ -619,7 +1484,7 @@ WORD CConsole::CConsoleImpl::getBGColor()
     if ( !bInited )
         return 0;
 
-    return logState[std::this_thread::get_id()].clrBG;
+    return getLogState().clrBG;
 } // getBGColor()
 
 
@@ -632,8 +1497,9 @@ void CConsole::CConsoleImpl::SetBGColor(WORD clr)
     if ( !bInited )
         return;
 
-    logState[std::this_thread::get_id()].clrBG = clr;
-    SetConsoleTextAttribute(hConsole, logState[std::this_thread::get_id()].clrFG | logState[std::this_thread::get_id()].clrBG);
+    LogState& state = getLogState();
+    state.clrBG = clr;
+    SetConsoleAttr(state.clrFG | state.clrBG);
 } // SetBGColor()
 
 
@@ -646,7 +1512,7 @@ WORD CConsole::CConsoleImpl::getIntsColor()
     if ( !bInited )
         return 0;
 
-    return logState[std::this_thread::get_id()].clrInts;
+    return getLogState().clrInts;
 } // getIntsColor()
 
 
@@ -659,7 +1525,7 @@ const char* CConsole::CConsoleImpl::getIntsColorHtml()
     if ( !bInited )
         return "#DDBEEF";
 
-    return logState[std::this_thread::get_id()].clrIntsHtml;
+    return getLogState().clrIntsHtml;
 } // getIntsColorHtml()
 
 
@@ -672,9 +1538,10 @@ void CConsole::CConsoleImpl::SetIntsColor(WORD clr, const char* html)
     if ( !bInited )
         return;
 
-    logState[std::this_thread::get_id()].clrInts = clr;
+    LogState& state = getLogState();
+    state.clrInts = clr;
     if (html)
-        strcpy_s(logState[std::this_thread::get_id()].clrIntsHtml, CConsoleImpl::HTML_CLR_S, html);
+        snprintf(state.clrIntsHtml, CConsoleImpl::HTML_CLR_S, "%s", html);
 } // SetIntsColor()
 
 
@@ -687,7 +1554,7 @@ WORD CConsole::CConsoleImpl::getStringsColor()
     if ( !bInited )
         return 0;
 
-    return logState[std::this_thread::get_id()].clrStrings;
+    return getLogState().clrStrings;
 } // getStringsColor()
 
 
@@ -700,7 +1567,7 @@ const char* CConsole::CConsoleImpl::getStringsColorHtml()
     if ( !bInited )
         return "#DDBEEF";
 
-    return logState[std::this_thread::get_id()].clrStringsHtml;
+    return getLogState().clrStringsHtml;
 } // getStringsColorHtml()
 
 
@@ -713,9 +1580,10 @@ void CConsole::CConsoleImpl::SetStringsColor(WORD clr, const char* html)
     if ( !bInited )
         return;
 
-    logState[std::this_thread::get_id()].clrStrings = clr;
+    LogState& state = getLogState();
+    state.clrStrings = clr;
     if (html)
-        strcpy_s(logState[std::this_thread::get_id()].clrStringsHtml, CConsoleImpl::HTML_CLR_S, html);
+        snprintf(state.clrStringsHtml, CConsoleImpl::HTML_CLR_S, "%s", html);
 } // SetStringsColor()
 
 
@@ -728,7 +1596,7 @@ WORD CConsole::CConsoleImpl::getFloatsColor()
     if ( !bInited )
         return 0;
 
-    return logState[std::this_thread::get_id()].clrFloats;
+    return getLogState().clrFloats;
 } // getFloatsColor()
 
 
@@ -741,7 +1609,7 @@ const char* CConsole::CConsoleImpl::getFloatsColorHtml()
     if ( !bInited )
         return "#DDBEEF";
 
-    return logState[std::this_thread::get_id()].clrFloatsHtml;
+    return getLogState().clrFloatsHtml;
 } // getFloatsColorHtml()
 
 
@@ -754,9 +1622,10 @@ void CConsole::CConsoleImpl::SetFloatsColor(WORD clr, const char* html)
     if ( !bInited )
         return;
 
-    logState[std::this_thread::get_id()].clrFloats = clr;
+    LogState& state = getLogState();
+    state.clrFloats = clr;
     if (html)
-        strcpy_s(logState[std::this_thread::get_id()].clrFloatsHtml, CConsoleImpl::HTML_CLR_S, html);
+        snprintf(state.clrFloatsHtml, CConsoleImpl::HTML_CLR_S, "%s", html);
 } // SetFloatsColor()
 
 
@@ -769,7 +1638,7 @@ WORD CConsole::CConsoleImpl::getBoolsColor()
     if ( !bInited )
         return 0;
 
-    return logState[std::this_thread::get_id()].clrBools;
+    return getLogState().clrBools;
 } // getBoolsColor()
 
 
@@ -782,7 +1651,7 @@ const char* CConsole::CConsoleImpl::getBoolsColorHtml()
     if ( !bInited )
         return "#DDBEEF";
 
-    return logState[std::this_thread::get_id()].clrBoolsHtml;
+    return getLogState().clrBoolsHtml;
 } // getBoolsColorHtml()
 
 
@@ -795,9 +1664,10 @@ void CConsole::CConsoleImpl::SetBoolsColor(WORD clr, const char* html)
     if ( !bInited )
         return;
 
-    logState[std::this_thread::get_id()].clrBools = clr;
+    LogState& state = getLogState();
+    state.clrBools = clr;
     if (html)
-        strcpy_s(logState[std::this_thread::get_id()].clrBoolsHtml, CConsoleImpl::HTML_CLR_S, html);
+        snprintf(state.clrBoolsHtml, CConsoleImpl::HTML_CLR_S, "%s", html);
 } // SetBoolsColor()
 
 
@@ -1022,7 +1892,9 @@ void CConsole::CConsoleImpl::NOn()
     if ( !bInited )
         return;
 
-    logState[std::this_thread::get_id()].nMode = 0;
+    LogState& state = getLogState();
+    state.nMode = 0;
+    PublishFilterState(state);
     LoadColors();
 } // NOn()
 
@@ -1036,16 +1908,18 @@ void CConsole::CConsoleImpl::EOn()
     if ( !bInited )
         return;
 
-    if (logState[std::this_thread::get_id()].nMode == 1)
+    LogState& state = getLogState();
+    if (state.nMode == 1)
     {
         return;
     }
-    else if (logState[std::this_thread::get_id()].nMode == 2)
+    else if (state.nMode == 2)
     {
         SOff();
     }
 
-    logState[std::this_thread::get_id()].nMode = 1;
+    state.nMode = 1;
+    PublishFilterState(state);
     SaveColors();
     SetFGColor(FOREGROUND_RED | FOREGROUND_INTENSITY, "FF0000");
     SetStringsColor(FOREGROUND_RED | FOREGROUND_GREEN, "DDDD00");
@@ -1077,16 +1951,18 @@ void CConsole::CConsoleImpl::SOn()
     if ( !bInited )
         return;
 
-    if (logState[std::this_thread::get_id()].nMode == 2)
+    LogState& state = getLogState();
+    if (state.nMode == 2)
     {
         return;
     }
-    else if (logState[std::this_thread::get_id()].nMode == 1)
+    else if (state.nMode == 1)
     {
         EOff();
     }
 
-    logState[std::this_thread::get_id()].nMode = 2;
+    state.nMode = 2;
+    PublishFilterState(state);
     SaveColors();
     SetFGColor(FOREGROUND_GREEN, "00DD00");
     SetStringsColor(FOREGROUND_GREEN | FOREGROUND_INTENSITY, "00FF00");
@@ -1499,6 +2375,41 @@ void CConsole::CConsoleImpl::OIEOLnOO(const char* text, va_list list)
 } // OIEOLnOO
 
 
+/**
+    Common part of the template overloads of O(), OLn(), SO(), SOLn(), EO() and EOLn().
+    @param format Format string parsed at compile time.
+    @param args   Arguments already checked and converted at compile time.
+    @param mode   N for normal, S for success, E for error mode.
+    @param nl     Whether to print newline after the text or not.
+*/
+void CConsole::CConsoleImpl::WriteFormat(
+    const CConsoleFormat::Format& format,
+    const CConsoleFormat::Arg* args,
+    CConsole::FormatSignal mode,
+    bool nl)
+{
+    if ( !bInited )
+        return;
+
+    if ( mode == CConsole::FormatSignal::S )
+    {
+        SOn();
+        WriteCompiledFormatCaller(format, args, nl);
+        SOff();
+    }
+    else if ( mode == CConsole::FormatSignal::E )
+    {
+        EOn();
+        WriteCompiledFormatCaller(format, args, nl);
+        EOff();
+    }
+    else
+    {
+        WriteCompiledFormatCaller(format, args, nl);
+    }
+} // WriteFormat()
+
+
 /**
     Gets total count of printouts-with-newline during error-mode.
 */
@@ -1550,183 +2461,3101 @@ void CConsole::CConsoleImpl::ResetSuccessOutsCount()
 
 
 /**
-    O("%s", text).
+    Tells if logs are written by a background writer thread.
+    Per-process property.
 */
-CConsole::CConsoleImpl& CConsole::CConsoleImpl::operator<<(const char* text)
+bool CConsole::CConsoleImpl::isAsyncLogging() const
 {
-    if ( !bInited )
-        return *this;
+    if (!bInited)
+        return false;
 
-    if (bFirstWriteTextCallAfterWriteTextLn)
-    {
-        for (int i = 0; i < logState[std::this_thread::get_id()].nIndentValue; i++)
-        {
-            WriteText(" ");
-        }
+    return bAsync;
+}
+
+
+/**
+    Sets logs to be written by a background writer thread or by the logging threads.
+    See more explanation at CConsole::SetAsyncLogging().
+    Per-process property.
+*/
+void CConsole::CConsoleImpl::SetAsyncLogging(bool state)
+{
+    if (!bInited)
+        return;
+
+    if (bAsync == state)
+        return;
+
+    if (state)
+    {
+        StartWriterThread();
+    }
+    else
+    {
+        StopWriterThread();
+    }
+}
+
+
+/**
+    Tells if logs are written unformatted to a binary log file.
+    Per-process property.
+*/
+bool CConsole::CConsoleImpl::isBinaryLogging() const
+{
+    return bBinaryLog;
+} // isBinaryLogging()
+
+
+/**
+    Sets logs to be written unformatted to a binary log file instead of console and html log file.
+    See more explanation at CConsole::SetBinaryLogging().
+*/
+void CConsole::CConsoleImpl::SetBinaryLogging(bool state)
+{
+    if ( !bInited )
+        return;
+
+    if ( bBinaryLog == state )
+        return;
+
+    if ( state )
+    {
+        if ( sLogFilename.empty() )
+        {
+            EOLn("ERROR: Binary logging needs log file, see Initialize()!");
+            return;
+        }
+
+        const std::string sBinaryLogFilename = sLogFilename.substr(0, sLogFilename.rfind('.')) + CConsoleBinaryLog::FILE_EXTENSION;
+        fBinaryLog.open(sBinaryLogFilename, std::ios::out | std::ios::binary | std::ios::app);
+        if ( fBinaryLog.fail() )
+        {
+            EOLn("ERROR: Couldn't open binary log file %s for writing!", sBinaryLogFilename.c_str());
+            return;
+        }
+        OLn("Binary logging is ON, logs are written to %s", sBinaryLogFilename.c_str());
+
+        // unfinished lines are written now so they don't need to be mixed with binary records later
+        CommitAllLines();
+
+        // every session starts with a header so the decoder knows that ids of earlier sessions are not valid anymore
+        sBinaryBuffer.clear();
+        CConsoleBinaryLog::Put(sBinaryBuffer, CConsoleBinaryLog::RecordType::Header);
+        sBinaryBuffer.append(CConsoleBinaryLog::MAGIC, sizeof(CConsoleBinaryLog::MAGIC));
+        CConsoleBinaryLog::Put(sBinaryBuffer, CConsoleBinaryLog::VERSION);
+        CConsoleBinaryLog::PutString(sBinaryBuffer, sLogTitle.c_str());
+        binaryFormatIds.clear();
+        binaryModulesWritten.assign(CCONSOLE_MAX_LOGGER_MODULES, false);
+        bBinaryLog = true;
+    }
+    else
+    {
+        BinaryFlush();
+        fBinaryLog.close();
+        bBinaryLog = false;
+        OLn("Binary logging is OFF");
+    }
+} // SetBinaryLogging()
+
+
+/**
+    Gets when the log files are flushed.
+*/
+CConsole::FlushPolicy CConsole::CConsoleImpl::getFlushPolicy() const
+{
+    return flushPolicy.load(std::memory_order_relaxed);
+} // getFlushPolicy()
+
+
+/**
+    Sets when the log files are flushed.
+    See more explanation at CConsole::SetFlushPolicy().
+*/
+void CConsole::CConsoleImpl::SetFlushPolicy(CConsole::FlushPolicy policy, int intervalMillisecs)
+{
+    if ( !bInited )
+        return;
+
+    nFlushIntervalMillisecs.store((intervalMillisecs > 0) ? intervalMillisecs : 1, std::memory_order_relaxed);
+    flushPolicy.store(policy, std::memory_order_relaxed);
+} // SetFlushPolicy()
+
+
+/**
+    Writes all finished log lines to the log files.
+    See more explanation at CConsole::Flush().
+*/
+void CConsole::CConsoleImpl::Flush()
+{
+    if ( !bInited )
+        return;
+
+    if ( bBinaryLog )
+    {
+        BinaryFlush();
+    }
+
+    if ( !bAsync )
+    {
+        FlushSinks();
+        return;
+    }
+
+    // writerThread owns the sinks, it handles the request after writing the records queued so far
+    const unsigned int nRequest = nFlushRequests.fetch_add(1, std::memory_order_acq_rel) + 1;
+    while ( nFlushesDone.load(std::memory_order_acquire) != nRequest )
+    {
+        writerCv.notify_one();
+        std::this_thread::yield();
+    }
+} // Flush()
+
+
+/**
+    Tells if the html log file is written in compact html.
+*/
+bool CConsole::CConsoleImpl::isCompactHtml() const
+{
+    if ( !bInited )
+        return false;
+
+    return bCompactHtml;
+} // isCompactHtml()
+
+
+/**
+    Sets the html log file to be written in compact html or not.
+    See more explanation at CConsole::SetCompactHtml().
+*/
+void CConsole::CConsoleImpl::SetCompactHtml(bool state)
+{
+    if ( !bInited )
+        return;
+
+    bCompactHtml = state;
+    if ( isSinkOpen(CConsole::Sink::HtmlFile) )
+    {
+        static_cast<HtmlFileSink*>(sinks[static_cast<size_t>(CConsole::Sink::HtmlFile)].get())->SetCompact(state);
+    }
+} // SetCompactHtml()
+
+
+/**
+    Gets the logging statistics.
+    Caller must hold mainMutex, for the module names and the waiting time of mainMutex.
+    See more explanation at CConsole::getStats().
+*/
+CConsole::Stats CConsole::CConsoleImpl::getStats()
+{
+    CConsole::Stats result{};
+    for (size_t nModule = 0; nModule < CCONSOLE_MAX_LOGGER_MODULES; nModule++)
+    {
+        CConsole::ModuleStats moduleStats{};
+        bool bAny = false;
+        for (size_t nMode = 0; nMode < 3; nMode++)
+        {
+            moduleStats.nLines[nMode] = stats.nLines[nModule][nMode].load(std::memory_order_relaxed);
+            moduleStats.nSuppressedLines[nMode] = stats.nSuppressedLines[nModule][nMode].load(std::memory_order_relaxed);
+            result.nLines[nMode] += moduleStats.nLines[nMode];
+            result.nSuppressedLines[nMode] += moduleStats.nSuppressedLines[nMode];
+            bAny = bAny || (moduleStats.nLines[nMode] != 0) || (moduleStats.nSuppressedLines[nMode] != 0);
+        }
+        if ( bAny )
+        {
+            moduleStats.sName = ((nModule == 0) || !moduleNames[nModule]) ? "" : moduleNames[nModule];
+            result.modules.push_back(moduleStats);
+        }
+    }
+    for (size_t i = 0; i < CCONSOLE_SINK_COUNT; i++)
+    {
+        result.nSinkBytes[i] = stats.nSinkBytes[i].load(std::memory_order_relaxed);
+    }
+    result.nFlushes = stats.nFlushes.load(std::memory_order_relaxed);
+    result.nMutexWaitMicrosecs = mainMutex.getWaitNanosecs() / 1000;
+    result.nSinkWriteMicrosecs = stats.nSinkWriteNanosecs.load(std::memory_order_relaxed) / 1000;
+    return result;
+} // getStats()
+
+
+/**
+    Resets the logging statistics.
+    Caller must hold mainMutex.
+*/
+void CConsole::CConsoleImpl::ResetStats()
+{
+    for (size_t nModule = 0; nModule < CCONSOLE_MAX_LOGGER_MODULES; nModule++)
+    {
+        for (size_t nMode = 0; nMode < 3; nMode++)
+        {
+            stats.nLines[nModule][nMode].store(0, std::memory_order_relaxed);
+            stats.nSuppressedLines[nModule][nMode].store(0, std::memory_order_relaxed);
+        }
+    }
+    for (auto& nBytes : stats.nSinkBytes)
+    {
+        nBytes.store(0, std::memory_order_relaxed);
+    }
+    stats.nFlushes.store(0, std::memory_order_relaxed);
+    stats.nSinkWriteNanosecs.store(0, std::memory_order_relaxed);
+    mainMutex.ResetWaitNanosecs();
+} // ResetStats()
+
+
+/**
+    Tells if the given sink is open.
+*/
+bool CConsole::CConsoleImpl::isSinkOpen(CConsole::Sink sink) const
+{
+    if ( !bInited )
+        return false;
+
+    return static_cast<size_t>(sink) < CCONSOLE_SINK_COUNT && sinks[static_cast<size_t>(sink)];
+} // isSinkOpen()
+
+
+/**
+    Opens the given sink.
+    See more explanation at CConsole::OpenSink().
+*/
+bool CConsole::CConsoleImpl::OpenSink(CConsole::Sink sink, const char* filename)
+{
+    if ( !bInited )
+        return false;
+
+    const size_t nSink = static_cast<size_t>(sink);
+    if ( nSink >= CCONSOLE_SINK_COUNT )
+        return false;
+
+    if ( sinks[nSink] )
+        return true;
+
+    std::unique_ptr<LogSink> newSink = CreateSink(sink, filename);
+    if ( !newSink )
+    {
+        EOLn("ERROR: Couldn't open sink %d, file name: %s", static_cast<int>(sink), filename);
+        return false;
+    }
+
+    // writerThread must not use the sinks while we change them
+    const bool bWasAsync = bAsync;
+    if ( bWasAsync )
+        StopWriterThread();
+    sinks[nSink] = std::move(newSink);
+    if ( bWasAsync )
+        StartWriterThread();
+    return true;
+} // OpenSink()
+
+
+/**
+    Closes the given sink.
+    See more explanation at CConsole::CloseSink().
+*/
+void CConsole::CConsoleImpl::CloseSink(CConsole::Sink sink)
+{
+    if ( !bInited )
+        return;
+
+    const size_t nSink = static_cast<size_t>(sink);
+    if ( (nSink >= CCONSOLE_SINK_COUNT) || !sinks[nSink] )
+        return;
+
+    // writerThread must not use the sinks while we change them, and records queued so far still go to this sink
+    const bool bWasAsync = bAsync;
+    if ( bWasAsync )
+        StopWriterThread();
+    sinks[nSink].reset();
+    if ( bWasAsync )
+        StartWriterThread();
+} // CloseSink()
+
+
+/**
+    Sets logs of the given mode to be written to the given sink or not.
+    See more explanation at CConsole::SetSinkModeState().
+*/
+void CConsole::CConsoleImpl::SetSinkModeState(CConsole::Sink sink, CConsole::FormatSignal mode, bool state)
+{
+    if ( !isSinkOpen(sink) )
+        return;
+
+    switch ( mode )
+    {
+    case N: sinks[static_cast<size_t>(sink)]->SetModeState(0, state); break;
+    case E: sinks[static_cast<size_t>(sink)]->SetModeState(1, state); break;
+    case S: sinks[static_cast<size_t>(sink)]->SetModeState(2, state); break;
+    default: break;
+    }
+} // SetSinkModeState()
+
+
+/**
+    Sets logs of the given logger module to be written to the given sink or not.
+    See more explanation at CConsole::SetSinkLoggingState().
+*/
+void CConsole::CConsoleImpl::SetSinkLoggingState(CConsole::Sink sink, const char* loggerModuleName, bool state)
+{
+    if ( !isSinkOpen(sink) || (loggerModuleName == NULL) )
+        return;
+
+    const CConsole::ModuleHandle loggerModule = registerModule(loggerModuleName);
+    if ( loggerModule == CConsole::ModuleHandle::None )
+        return;
+
+    sinks[static_cast<size_t>(sink)]->SetModuleState(loggerModule, state);
+} // SetSinkLoggingState()
+
+
+/**
+    Gets the text collected by the memory sink.
+*/
+std::string CConsole::CConsoleImpl::getMemorySinkText()
+{
+    if ( !isSinkOpen(CConsole::Sink::Memory) )
+        return std::string();
+
+    return static_cast<MemorySink&>(*sinks[static_cast<size_t>(CConsole::Sink::Memory)]).getText();
+} // getMemorySinkText()
+
+
+/**
+    Clears the text collected by the memory sink.
+*/
+void CConsole::CConsoleImpl::ClearMemorySink()
+{
+    if ( !isSinkOpen(CConsole::Sink::Memory) )
+        return;
+
+    static_cast<MemorySink&>(*sinks[static_cast<size_t>(CConsole::Sink::Memory)]).Clear();
+} // ClearMemorySink()
+
+
+/**
+    O("%s", text).
+*/
+CConsole::CConsoleImpl& CConsole::CConsoleImpl::operator<<(const char* text)
+{
+    if ( !bInited )
+        return *this;
+
+    if ( bBinaryLog )
+    {
+        BinaryWriteValue("%s", text);
+        return *this;
+    }
+
+    WriteIndentation();
+    ImmediateWriteString(text);
+    CommitFinishedLine();
+    return *this;
+} // operator<<()
+
+
+/**
+    O("%b", b).
+*/
+CConsole::CConsoleImpl& CConsole::CConsoleImpl::operator<<(const bool& b)
+{
+    if ( !bInited )
+        return *this;
+
+    if ( bBinaryLog )
+    {
+        BinaryWriteValue("%b", static_cast<std::uint8_t>(b ? 1 : 0));
+        return *this;
+    }
+
+    WriteIndentation();
+    ImmediateWriteBool(b);
+    CommitFinishedLine();
+    return *this;
+} // operator<<()
+
+
+/**
+    O("%d", n).
+*/
+CConsole::CConsoleImpl& CConsole::CConsoleImpl::operator<<(const int& n)
+{
+    if ( !bInited )
+        return *this;
+
+    if ( bBinaryLog )
+    {
+        BinaryWriteValue("%d", static_cast<std::int32_t>(n));
+        return *this;
+    }
+
+    WriteIndentation();
+    ImmediateWriteInt(n);
+    CommitFinishedLine();
+    return *this;
+} // operator<<()
+
+/**
+    O("%lld", n).
+*/
+CConsole::CConsoleImpl& CConsole::CConsoleImpl::operator<<(const long long& n)
+{
+    if ( !bInited )
+        return *this;
+
+    if ( bBinaryLog )
+    {
+        BinaryWriteValue("%lld", static_cast<std::int64_t>(n));
+        return *this;
+    }
+
+    WriteIndentation();
+    ImmediateWriteInt(n);
+    CommitFinishedLine();
+    return *this;
+} // operator<<()
+
+/**
+    O("%llu", n).
+*/
+CConsole::CConsoleImpl& CConsole::CConsoleImpl::operator<<(const unsigned long long& n)
+{
+    if ( !bInited )
+        return *this;
+
+    if ( bBinaryLog )
+    {
+        BinaryWriteValue("%llu", static_cast<std::uint64_t>(n));
+        return *this;
+    }
+
+    WriteIndentation();
+    ImmediateWriteUInt(n);
+    CommitFinishedLine();
+    return *this;
+} // operator<<()
+
+
+/**
+    O("%f", f).
+*/
+CConsole::CConsoleImpl& CConsole::CConsoleImpl::operator<<(const float& f)
+{
+    if ( !bInited )
+        return *this;
+
+    if ( bBinaryLog )
+    {
+        BinaryWriteValue("%f", static_cast<double>(f));
+        return *this;
+    }
+
+    WriteIndentation();
+    ImmediateWriteFloat(f);
+    CommitFinishedLine();
+    return *this;
+} // operator<<()
+
+/**
+    O("%f", f).
+*/
+CConsole::CConsoleImpl& CConsole::CConsoleImpl::operator<<(const double& f)
+{
+    if ( !bInited )
+        return *this;
+
+    if ( bBinaryLog )
+    {
+        BinaryWriteValue("%f", f);
+        return *this;
+    }
+
+    WriteIndentation();
+    ImmediateWriteFloat(f);
+    CommitFinishedLine();
+    return *this;
+} // operator<<()
+
+
+/**
+    Changes current mode or adds a new line.
+    Based on value of fs, equals to calling EOn()/EOff()/SOn()/SOff()/NOn() accordingly.
+    If fs is FormatSignal::NL, the behavior is same as OLn("").
+*/
+CConsole::CConsoleImpl& CConsole::CConsoleImpl::operator<<(const CConsole::FormatSignal& fs)
+{
+    if ( !bInited )
+        return *this;
+
+    switch (fs)
+    {
+    case NL:
+        if ( bBinaryLog )
+        {
+            if ( canWeWriteBasedOnFilterSettings() )
+            {
+                BinaryBeginRecord("", static_cast<std::uint8_t>(CConsoleBinaryLog::FLAG_VALUE | CConsoleBinaryLog::FLAG_NEWLINE));
+                getLogState().bFirstWriteTextCallAfterWriteTextLn = true;
+                BinaryEndRecord();
+            }
+            else
+            {
+                const LogState& state = getLogState();
+                CountLine(state.loggerModule, state.nMode, true);
+                BacklogBeginPrintout("", true);
+            }
+        }
+        else
+        {
+            WriteText("\n\r");
+        }
+        break;
+    case  S: SOn(); break;
+    case  E: EOn(); break;
+    default: NOn(); break;
+    }
+    CommitFinishedLine();
+    return *this;
+} // operator<<()
+
+
+// ############################## PROTECTED ##############################
+
+
+// ############################### PRIVATE ###############################
+
+
+std::atomic<unsigned int> CConsole::CConsoleImpl::nLastInstanceId{0};
+thread_local CConsole::CConsoleImpl::ThreadStateGuard CConsole::CConsoleImpl::threadStateGuard;
+thread_local CConsole::CConsoleImpl::FilterState CConsole::CConsoleImpl::filterState;
+std::atomic<unsigned int> CConsole::CConsoleImpl::nActiveInstanceId{0};
+std::atomic<bool> CConsole::CConsoleImpl::bErrorsAlwaysOn{true};
+std::atomic<int> CConsole::CConsoleImpl::nLoggingLevel{CCONSOLE_LEVEL_TRACE};
+std::atomic<int> CConsole::CConsoleImpl::nErrorBacklogLines{0};
+std::atomic<int> CConsole::CConsoleImpl::nRepeatedLinesTimeout{0};
+CConsole::CConsoleImpl CConsole::CConsoleImpl::consoleImplInstance;
+std::map<std::string, CConsole::ModuleHandle, std::less<>> CConsole::CConsoleImpl::moduleHandles;
+const char* CConsole::CConsoleImpl::moduleNames[CConsole::CConsoleImpl::CCONSOLE_MAX_LOGGER_MODULES];
+std::atomic<std::uint64_t> CConsole::CConsoleImpl::enabledModules[CCONSOLE_MAX_LOGGER_MODULES / 64];
+std::atomic<bool> CConsole::CConsoleImpl::bAllModulesEnabled{false};
+CConsole::CConsoleImpl::StatCounters CConsole::CConsoleImpl::stats;
+CConsoleFlightRecorder::Ring CConsole::CConsoleImpl::flightRecorder;
+char CConsole::CConsoleImpl::szCrashFilename[CConsole::CConsoleImpl::CCONSOLE_CRASH_FILENAME_SIZE];
+bool CConsole::CConsoleImpl::bCrashHandlerSet = false;
+#ifdef _WIN32
+void (*CConsole::CConsoleImpl::prevCrashHandlers[CConsole::CConsoleImpl::CCONSOLE_CRASH_SIGNAL_COUNT])(int);
+#else
+struct sigaction CConsole::CConsoleImpl::prevCrashActions[CConsole::CConsoleImpl::CCONSOLE_CRASH_SIGNAL_COUNT];
+#endif
+int CConsole::CConsoleImpl::nErrorOutCount = 0;     /**< Total OLn() during error mode. */
+int CConsole::CConsoleImpl::nSuccessOutCount = 0;   /**< Total OLn() during success mode. */
+
+
+CConsole::CConsoleImpl::CConsoleImpl()
+{
+    nInstanceId = ++nLastInstanceId;
+    bInited = false;
+    bErrorsAlwaysOn = true;
+    nLoggingLevel = CCONSOLE_LEVEL_TRACE;
+    nErrorBacklogLines = 0;
+    nRepeatedLinesTimeout = 0;
+    bAsync = false;
+    bBinaryLog = false;
+    nLastThreadIndex = 0;
+    binaryRecordFmt = "";
+    binaryRecordFlags = 0;
+    nBinaryRecordArgs = 0;
+    bWriterRunning = false;
+    bWriterSleeping = false;
+    bTickRunning = false;
+    bCompactHtml = false;
+    bDumpingBacklog = false;
+    bWritingCounts = false;
+    bWritingBatch = false;
+    bBatchFlushDue = false;
+    flushPolicy = CConsole::FlushPolicy::EveryLine;
+    nFlushIntervalMillisecs = 1000;
+    timeLastFlush = std::chrono::steady_clock::now();
+    nFlushRequests = 0;
+    nFlushesDone = 0;
+    bUnflushedLines = false;
+    RestoreDefaultColors();
+    SaveColors();
+} // CConsoleImpl(...)
+
+
+CConsole::CConsoleImpl::CConsoleImpl(const CConsoleImpl&)
+{
+
+}
+
+
+CConsole::CConsoleImpl& CConsole::CConsoleImpl::operator=(const CConsoleImpl&)
+{
+    return *this;
+}
+
+
+CConsole::CConsoleImpl::~CConsoleImpl()
+{
+#ifdef CCONSOLE_IS_ENABLED
+    // tickThread might be still using this instance
+    StopTickThread();
+    // from now on the public functions must not skip anything based on filterState of this instance
+    unsigned int nExpectedInstanceId = nInstanceId;
+    nActiveInstanceId.compare_exchange_strong(nExpectedInstanceId, 0);
+    // unfinished lines and writer thread must be finished before we close console and log file
+    CommitAllLines();
+    StopWriterThread();
+    if ( bBinaryLog )
+    {
+        BinaryFlush();
+        fBinaryLog.close();
+    }
+    // logging states belong to the console, module handles are kept for the process lifetime
+    ClearEnabledModules();
+    RemoveCrashHandler();
+    for (auto& sink : sinks)
+    {
+        sink.reset();
+    }
+#endif
+} // ~CConsoleImpl()
+
+
+/**
+    Gets the log state of current thread.
+    The state is looked up in logState only at the 1st call of a thread, then its address is cached in
+    threadStateGuard so logging functions don't have to walk the map at every call.
+    Elements of logState are erased only by the threadStateGuard of their own thread, so the cached address stays valid.
+    The cache is keyed by nInstanceId so that a state cached for an already destroyed instance is never used.
+*/
+CConsole::CConsoleImpl::LogState& CConsole::CConsoleImpl::getLogState()
+{
+    ThreadStateGuard& guard = threadStateGuard;
+    if ( guard.nInstanceId != nInstanceId )
+    {
+        guard.pState = &logState[std::this_thread::get_id()];
+        guard.nInstanceId = nInstanceId;
+        guard.pState->pLastLine = &guard.lastLine;
+        PublishFilterState(*guard.pState);
+    }
+    return *guard.pState;
+} // getLogState()
+
+
+/**
+    Gets the sum of the reference counts of all threads.
+    Threads that died are not included, see ThreadStateGuard.
+*/
+int CConsole::CConsoleImpl::getRefCount() const
+{
+    int nSum = 0;
+    for (const auto& it : logState)
+    {
+        nSum += it.second.nRefCount;
+    }
+    return nSum;
+} // getRefCount()
+
+
+/**
+    Decreases the reference count of current thread by 1.
+    If current thread has no reference, e.g. Initialize() was invoked by another thread, the reference of another
+    thread is released instead, as reference counting was per-process earlier.
+*/
+void CConsole::CConsoleImpl::ReleaseRef()
+{
+    LogState& state = getLogState();
+    if ( state.nRefCount > 0 )
+    {
+        state.nRefCount--;
+        return;
+    }
+
+    for (auto& it : logState)
+    {
+        if ( it.second.nRefCount > 0 )
+        {
+            it.second.nRefCount--;
+            return;
+        }
+    }
+} // ReleaseRef()
+
+
+/**
+    Releases the log state of current thread, when the thread is exiting.
+    Unfinished line of the thread is written first, so no log is lost.
+    References of the thread not released by Deinitialize() are dropped together with the log state.
+    Caller must hold mainMutex.
+    @return True if the thread had references and the sum of reference counts of the remaining threads is 0,
+            so the console should be deinitialized as if the last Deinitialize() was invoked.
+*/
+bool CConsole::CConsoleImpl::ReleaseThreadState()
+{
+    const auto it = logState.find(std::this_thread::get_id());
+    if ( it == logState.end() )
+        return false;
+
+    if ( bInited )
+    {
+        EndRepeats();
+        if ( it->second.backlog.bDumpPending )
+            DumpBacklog();
+        CommitLine(it->second);
+    }
+    const bool bHadRefs = it->second.nRefCount > 0;
+    logState.erase(it);
+    threadStateGuard.nInstanceId = 0;
+    threadStateGuard.pState = NULL;
+    return bHadRefs && (getRefCount() == 0);
+} // ReleaseThreadState()
+
+
+/**
+    Releases the log state of the exiting thread in the currently existing instance, see ReleaseThreadState().
+    The instance in which the state was cached might be already deleted, in that case there is nothing to release.
+    If this was the last reference, the instance is deleted by CConsole::Shutdown(), the static CConsole object
+    itself is never destroyed here.
+*/
+CConsole::CConsoleImpl::ThreadStateGuard::~ThreadStateGuard()
+{
+#ifdef CCONSOLE_IS_ENABLED
+    if ( nInstanceId == 0 )
+        return;
+
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
+
+    CConsoleImpl* const impl = CConsole::consoleInstance.consoleImpl;
+    if ( !impl || (impl->nInstanceId != nInstanceId) )
+        return;
+
+    if ( impl->ReleaseThreadState() )
+    {
+        CConsole::consoleInstance.Shutdown();
+    }
+#endif
+} // ~ThreadStateGuard()
+
+
+/**
+    Installs CrashSignalHandler() for the fatal signals, if not yet installed.
+    The replaced handlers are saved, so they can be restored by RemoveCrashHandler().
+*/
+void CConsole::CConsoleImpl::InstallCrashHandler()
+{
+    if ( bCrashHandlerSet )
+        return;
+
+    for (size_t i = 0; i < CCONSOLE_CRASH_SIGNAL_COUNT; i++)
+    {
+#ifdef _WIN32
+        prevCrashHandlers[i] = signal(CCONSOLE_CRASH_SIGNALS[i], CrashSignalHandler);
+#else
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = CrashSignalHandler;
+        sigemptyset(&action.sa_mask);
+        sigaction(CCONSOLE_CRASH_SIGNALS[i], &action, &prevCrashActions[i]);
+#endif
+    }
+    bCrashHandlerSet = true;
+} // InstallCrashHandler()
+
+
+/**
+    Restores the handlers replaced by InstallCrashHandler(), if installed.
+    Async-signal-safe.
+*/
+void CConsole::CConsoleImpl::RemoveCrashHandler()
+{
+    if ( !bCrashHandlerSet )
+        return;
+
+    for (size_t i = 0; i < CCONSOLE_CRASH_SIGNAL_COUNT; i++)
+    {
+#ifdef _WIN32
+        signal(CCONSOLE_CRASH_SIGNALS[i], prevCrashHandlers[i]);
+#else
+        sigaction(CCONSOLE_CRASH_SIGNALS[i], &prevCrashActions[i], NULL);
+#endif
+    }
+    bCrashHandlerSet = false;
+} // RemoveCrashHandler()
+
+
+/**
+    Writes flightRecorder to the crash file on a fatal signal, then raises the signal again for the previous handler,
+    which is by default the one terminating the process.
+    Only async-signal-safe functions are used: no lock, no allocation, output is done by open() and write().
+*/
+void CConsole::CConsoleImpl::CrashSignalHandler(int sig)
+{
+    int fd = 2;   // stderr
+    if ( szCrashFilename[0] != '\0' )
+    {
+#ifdef _WIN32
+        const int fdCrashFile = _open(szCrashFilename, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+        const int fdCrashFile = open(szCrashFilename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+        if ( fdCrashFile >= 0 )
+            fd = fdCrashFile;
+    }
+
+    {
+        CConsoleFlightRecorder::FdWriter out(fd);
+        char szSignal[CConsoleNumberFormat::BUFFER_SIZE];
+        out.Append("CConsole: fatal signal ");
+        out.Append(szSignal, CConsoleNumberFormat::FormatInteger(szSignal, sig));
+        out.Append(", most recent log records:\n");
+    }
+    flightRecorder.Dump(fd, CConsoleFlightRecorder::RECORDS);
+
+    if ( fd != 2 )
+    {
+#ifdef _WIN32
+        _close(fd);
+#else
+        close(fd);
+#endif
+    }
+
+    RemoveCrashHandler();
+    raise(sig);
+} // CrashSignalHandler()
+
+
+/**
+    Updates filterState from the log state of current thread.
+    Must be called whenever the logger module or the mode of current thread changes.
+*/
+void CConsole::CConsoleImpl::PublishFilterState(const LogState& state)
+{
+    filterState.nInstanceId = nInstanceId;
+    filterState.loggerModule = state.loggerModule;
+    filterState.nMode = state.nMode;
+} // PublishFilterState()
+
+
+/**
+    Tells without taking mainMutex if a printout of current thread would be filtered out, so the public functions
+    can return immediately for disabled logger modules without contending for mainMutex.
+    Only lock-free state is used: filterState of current thread, the enabled-modules bitmap and bErrorsAlwaysOn.
+    If filterState doesn't belong to the currently initialized instance, we cannot tell anything.
+    If suppressed lines are kept for dumping them on error, nothing is skipped here, since only
+    canWeWriteBasedOnFilterSettings() records them, see CConsole::SetErrorBacklogLines().
+    @param mode N for printouts in current mode, S for SO()/SOLn(), E for EO()/EOLn().
+                Since these 2 change mode, they are skipped only in normal mode where they don't leave any change behind.
+    @param nl   True if the printout would end the line, so a skipped printout is counted as a suppressed line.
+    @return True if the printout can be skipped, false if it must be decided under mainMutex.
+*/
+bool CConsole::CConsoleImpl::isSurelyFilteredOut(CConsole::FormatSignal mode, bool nl)
+{
+    if ( (filterState.nInstanceId == 0) || (filterState.nInstanceId != nActiveInstanceId.load(std::memory_order_acquire)) )
+        return false;
+
+    if ( nErrorBacklogLines.load(std::memory_order_relaxed) > 0 )
+        return false;
+
+    if ( filterState.loggerModule == CConsole::ModuleHandle::None )
+        return false;
+
+    if ( (mode != CConsole::N) && (filterState.nMode != 0) )
+        return false;
+
+    if ( isModuleEnabled(filterState.loggerModule) )
+        return false;
+
+    const int nMode = (mode == CConsole::E) ? 1 : ((mode == CConsole::S) ? 2 : filterState.nMode);
+    if ( (nMode == 1) && bErrorsAlwaysOn.load(std::memory_order_relaxed) )
+        return false;
+
+    if ( nl )
+        CountLine(filterState.loggerModule, nMode, true);
+    return true;
+} // isSurelyFilteredOut()
+
+
+/**
+    Counts a written or suppressed line for CConsole::getStats().
+    @param nMode Mode of the line: 0 for normal, 1 for error, 2 for success mode.
+*/
+void CConsole::CConsoleImpl::CountLine(CConsole::ModuleHandle loggerModule, int nMode, bool bSuppressed)
+{
+    auto& counters = bSuppressed ? stats.nSuppressedLines : stats.nLines;
+    counters[static_cast<size_t>(loggerModule)][nMode].fetch_add(1, std::memory_order_relaxed);
+} // CountLine()
+
+
+/**
+    Counts a line of current thread suppressed without taking mainMutex, e.g. by the logging level.
+    Logger module and mode are taken from filterState, if it doesn't belong to the currently initialized instance,
+    the line is counted for no logger module.
+    @param mode N for lines in current mode, S for lines in success mode, E for lines in error mode.
+*/
+void CConsole::CConsoleImpl::CountSuppressedLine(CConsole::FormatSignal mode)
+{
+    const bool bKnown = (filterState.nInstanceId != 0) && (filterState.nInstanceId == nActiveInstanceId.load(std::memory_order_acquire));
+    const int nMode = (mode == CConsole::E) ? 1 : ((mode == CConsole::S) ? 2 : (bKnown ? filterState.nMode : 0));
+    CountLine(bKnown ? filterState.loggerModule : CConsole::ModuleHandle::None, nMode, true);
+} // CountSuppressedLine()
+
+
+/**
+    Tells without taking mainMutex if a line of current thread might be the same as its last line, based on
+    everything but the argument values: format string pointer, logger module and mode.
+    Lines written after the timeout are not considered as repeats, so the count of repeats is written periodically
+    during a long run of identical lines, see CConsole::SetRepeatedLinesTimeout().
+    @param mode N for lines in current mode, S for lines in success mode, E for lines in error mode.
+*/
+bool CConsole::CConsoleImpl::mightBeRepeatedLine(CConsole::FormatSignal mode, const char* fmt)
+{
+    const int nTimeout = nRepeatedLinesTimeout.load(std::memory_order_relaxed);
+    if ( nTimeout <= 0 )
+        return false;
+
+    const RepeatState& lastLine = threadStateGuard.lastLine;
+    if ( (lastLine.nInstanceId == 0) || (lastLine.fmt != fmt) )
+        return false;
+
+    if ( (lastLine.nInstanceId != filterState.nInstanceId) || (lastLine.nInstanceId != nActiveInstanceId.load(std::memory_order_acquire)) )
+        return false;
+
+    const int nMode = (mode == CConsole::E) ? 1 : ((mode == CConsole::S) ? 2 : filterState.nMode);
+    if ( (lastLine.loggerModule != filterState.loggerModule) || (lastLine.nMode != nMode) )
+        return false;
+
+    return (std::chrono::steady_clock::now() - lastLine.timeWritten) < std::chrono::milliseconds(nTimeout);
+} // mightBeRepeatedLine()
+
+
+/**
+    Tells without taking mainMutex if a line of current thread is the same as its last line, and counts it if so.
+    Argument values are encoded only if everything else is the same, see mightBeRepeatedLine().
+    @return True if the line can be skipped.
+*/
+bool CConsole::CConsoleImpl::isRepeatedLine(CConsole::FormatSignal mode, const char* fmt, va_list list)
+{
+    if ( !mightBeRepeatedLine(mode, fmt) )
+        return false;
+
+    RepeatState& lastLine = threadStateGuard.lastLine;
+    lastLine.sNextArgs.clear();
+    PutFormattedArgs(lastLine.sNextArgs, fmt, list);
+    return CountRepeatedLine();
+} // isRepeatedLine()
+
+
+/**
+    Same as isRepeatedLine() but with compile-time parsed format.
+*/
+bool CConsole::CConsoleImpl::isRepeatedLine(CConsole::FormatSignal mode, const CConsoleFormat::Format& format, const CConsoleFormat::Arg* args)
+{
+    if ( !mightBeRepeatedLine(mode, format.text) )
+        return false;
+
+    RepeatState& lastLine = threadStateGuard.lastLine;
+    lastLine.sNextArgs.clear();
+    PutCompiledArgs(lastLine.sNextArgs, format, args);
+    return CountRepeatedLine();
+} // isRepeatedLine()
+
+
+/**
+    Counts the line being compared as a repeat of the last line of current thread if their argument values are the same.
+    Repeats are also counted as suppressed lines for CConsole::getStats().
+*/
+bool CConsole::CConsoleImpl::CountRepeatedLine()
+{
+    RepeatState& lastLine = threadStateGuard.lastLine;
+    if ( lastLine.sNextArgs != lastLine.sArgs )
+        return false;
+
+    lastLine.nRepeats.fetch_add(1, std::memory_order_relaxed);
+    CountLine(lastLine.loggerModule, lastLine.nMode, true);
+    return true;
+} // CountRepeatedLine()
+
+
+/**
+    Tells if current thread can write based on its logger module and mode.
+    Also drives the backlog of suppressed lines: an error written by the thread makes the backlog pending, and
+    it is dumped at the first next non-error printout, see DumpBacklog().
+    Any printout also ends the run of repeats of the last line of the thread, see EndRepeats().
+*/
+bool CConsole::CConsoleImpl::canWeWriteBasedOnFilterSettings()
+{
+    if ( bDumpingBacklog || bWritingCounts )
+    {
+        return true;
+    }
+
+    EndRepeats();
+
+    LogState& state = getLogState();
+    if ( state.backlog.bDumpPending && (state.nMode != 1) )
+    {
+        DumpBacklog();
+    }
+
+    const bool bCanWrite =
+        (state.loggerModule == CConsole::ModuleHandle::None) ||
+        isModuleEnabled(state.loggerModule) ||
+        (bErrorsAlwaysOn && (state.nMode == 1));
+
+    if ( bCanWrite && (state.nMode == 1) && !state.backlog.isEmpty() )
+    {
+        state.backlog.bDumpPending = true;
+    }
+
+    return bCanWrite;
+} // canWeWriteBasedOnFilterSettings()
+
+
+/**
+    Gets the line being collected.
+    If there is no such line, a new line is started in the oldest slot, dropping the oldest line if the ring is full.
+    @param nCapacity Max number of lines, the ring is cleared if it is changed.
+*/
+std::string& CConsole::CConsoleImpl::Backlog::getOpenLine(size_t nCapacity)
+{
+    if ( lines.size() != nCapacity )
+    {
+        lines.resize(nCapacity);
+        Clear();
+    }
+
+    if ( !bLineOpen )
+    {
+        if ( nCount == lines.size() )
+            nFirst = (nFirst + 1) % lines.size();
+        else
+            nCount++;
+        lines[(nFirst + nCount - 1) % lines.size()].clear();
+        bLineOpen = true;
+    }
+    return lines[(nFirst + nCount - 1) % lines.size()];
+} // getOpenLine()
+
+
+void CConsole::CConsoleImpl::Backlog::EndLine()
+{
+    bLineOpen = false;
+} // EndLine()
+
+
+void CConsole::CConsoleImpl::Backlog::Clear()
+{
+    nFirst = 0;
+    nCount = 0;
+    bLineOpen = false;
+    bDumpPending = false;
+} // Clear()
+
+
+bool CConsole::CConsoleImpl::Backlog::isEmpty() const
+{
+    return nCount == 0;
+} // isEmpty()
+
+
+bool CConsole::CConsoleImpl::Backlog::isLineOpen() const
+{
+    return bLineOpen;
+} // isLineOpen()
+
+
+size_t CConsole::CConsoleImpl::Backlog::getLineCount() const
+{
+    return nCount;
+} // getLineCount()
+
+
+const std::string& CConsole::CConsoleImpl::Backlog::getLine(size_t i) const
+{
+    return lines[(nFirst + i) % lines.size()];
+} // getLine()
+
+
+/**
+    Starts recording a printout of current thread suppressed by the filter settings into its backlog.
+    Format string, indentation and new line flag are appended, the caller appends the argument values.
+    @param fmt Format string of the printout.
+    @param nl  Whether the printout ends the line or not.
+    @return The backlog line to append the argument values to, NULL if suppressed lines are not kept.
+*/
+std::string* CConsole::CConsoleImpl::BacklogBeginPrintout(const char* fmt, bool nl)
+{
+    const int nLines = nErrorBacklogLines.load(std::memory_order_relaxed);
+    if ( nLines <= 0 )
+        return NULL;
+
+    LogState& state = getLogState();
+    std::string& line = state.backlog.getOpenLine(static_cast<size_t>(nLines));
+    CConsoleBinaryLog::PutString(line, fmt);
+    CConsoleBinaryLog::Put(line, static_cast<std::int32_t>(state.nIndentValue));
+    CConsoleBinaryLog::Put(line, static_cast<std::uint8_t>(nl ? 1 : 0));
+    if ( nl )
+        state.backlog.EndLine();
+    return &line;
+} // BacklogBeginPrintout()
+
+
+/**
+    Records a single value printed by operator<< and suppressed by the filter settings into the backlog.
+    @param fmt   Format string matching the type of value, e.g. "%d".
+    @param value Value already converted to its type in the binary log, see CConsoleBinaryLog.h.
+*/
+template <class T>
+void CConsole::CConsoleImpl::BacklogValue(const char* fmt, T value)
+{
+    std::string* const pLine = BacklogBeginPrintout(fmt, false);
+    if ( pLine == NULL )
+        return;
+
+    if constexpr ( std::is_same_v<T, const char*> )
+        CConsoleBinaryLog::PutString(*pLine, value);
+    else
+        CConsoleBinaryLog::Put(*pLine, value);
+} // BacklogValue()
+
+
+/**
+    Writes the suppressed lines kept in the backlog of current thread, then clears the backlog.
+    Invoked at the first non-error printout or indentation increase after an error, instead of right at the error,
+    so a series of errors following each other dumps the backlog only once, after the last error.
+    Lines are written with their recorded indentation, in the current logger module and mode, bypassing the filter
+    settings. The current line is ended before, if not yet ended.
+*/
+void CConsole::CConsoleImpl::DumpBacklog()
+{
+    LogState& state = getLogState();
+    state.backlog.bDumpPending = false;
+    if ( state.backlog.isEmpty() )
+        return;
+
+    bDumpingBacklog = true;
+    const int nIndentValue = state.nIndentValue;
+    if ( !state.bFirstWriteTextCallAfterWriteTextLn )
+    {
+        *this << CConsole::NL;
+    }
+
+    OLn("Suppressed logs before the error:");
+    for (size_t i = 0; i < state.backlog.getLineCount(); i++)
+    {
+        const std::string& line = state.backlog.getLine(i);
+        const char* p = line.data();
+        const char* const end = p + line.size();
+        bool bOk = true;
+        while ( bOk && (p < end) )
+        {
+            bOk = WriteEncodedPrintout(p, end, 0);
+        }
+    }
+    if ( state.backlog.isLineOpen() )
+    {
+        *this << CConsole::NL;
+    }
+    state.nIndentValue = nIndentValue;
+    OLn("End of suppressed logs.");
+
+    state.backlog.Clear();
+    bDumpingBacklog = false;
+} // DumpBacklog()
+
+
+/**
+    Decodes a single printout of the backlog or of a batch and writes it with its recorded indentation.
+    Format string is parsed at runtime the same way as compile-time format strings.
+    @param p           Start of the printout, advanced to the next printout.
+    @param end         End of the encoded printouts.
+    @param nBaseIndent Added to the recorded indentation.
+    @return False if the printout is truncated, nothing is written then.
+*/
+bool CConsole::CConsoleImpl::WriteEncodedPrintout(const char*& p, const char* end, int nBaseIndent)
+{
+    std::string sFormat;
+    bool bNull;
+    std::int32_t nIndent;
+    std::uint8_t nl;
+    if ( !CConsoleBinaryLog::GetString(p, end, sFormat, bNull) || !CConsoleBinaryLog::Get(p, end, nIndent) ||
+         !CConsoleBinaryLog::Get(p, end, nl) )
+    {
+        return false;
+    }
+
+    std::vector<CConsoleFormat::Segment> segments(CConsoleFormat::parse(sFormat.c_str(), NULL));
+    CConsoleFormat::parse(sFormat.c_str(), segments.data());
+
+    std::vector<CConsoleFormat::Arg> args;
+    std::vector<std::string> strings;
+    args.reserve(segments.size());
+    strings.reserve(segments.size());   // no reallocation, so string args can point into strings
+    for (const auto& segment : segments)
+    {
+        if ( segment.type == 0 )
+            continue;
+
+        CConsoleFormat::Arg arg;
+        arg.type = segment.type;
+        bool bOk = false;
+        switch ( segment.type )
+        {
+        case 's':
+            strings.emplace_back();
+            bOk = CConsoleBinaryLog::GetString(p, end, strings.back(), bNull);
+            arg.value.s = bNull ? NULL : strings.back().c_str();
+            break;
+        case 'i':
+        case 'd':
+            {
+                std::int32_t nValue = 0;
+                bOk = CConsoleBinaryLog::Get(p, end, nValue);
+                arg.value.i = nValue;
+            }
+            break;
+        case 'u':
+            {
+                std::uint32_t nValue = 0;
+                bOk = CConsoleBinaryLog::Get(p, end, nValue);
+                arg.value.u = nValue;
+            }
+            break;
+        case 'D':
+            {
+                std::int64_t nValue = 0;
+                bOk = CConsoleBinaryLog::Get(p, end, nValue);
+                arg.value.ll = nValue;
+            }
+            break;
+        case 'U':
+            {
+                std::uint64_t nValue = 0;
+                bOk = CConsoleBinaryLog::Get(p, end, nValue);
+                arg.value.ull = nValue;
+            }
+            break;
+        case 'b':
+            {
+                std::uint8_t bValue = 0;
+                bOk = CConsoleBinaryLog::Get(p, end, bValue);
+                arg.value.b = (bValue != 0);
+            }
+            break;
+        case 'f':
+            bOk = CConsoleBinaryLog::Get(p, end, arg.value.f);
+            break;
+        default:
+            break;
+        } // switch
+        if ( !bOk )
+            return false;
+        args.push_back(arg);
+    } // for segment
+
+    const CConsoleFormat::Format format{
+        sFormat.c_str(), segments.data(), segments.size(),
+        !CConsoleFormat::contains(sFormat.c_str(), '%'), CConsoleFormat::contains(sFormat.c_str(), '\n') };
+    getLogState().nIndentValue = (nBaseIndent + nIndent > 0) ? (nBaseIndent + nIndent) : 0;
+    WriteCompiledFormatCaller(format, args.data(), nl != 0);
+    return true;
+} // WriteEncodedPrintout()
+
+
+/**
+    Encodes a printout into the printouts of a CConsole::Batch, without taking mainMutex.
+    Layout is the mode as uint8, then the same as of a printout of the backlog, see BacklogBeginPrintout().
+    Printouts surely filtered out are not encoded at all, see isSurelyFilteredOut().
+    @param mode    N for printouts in current mode, S for success mode, E for error mode.
+    @param nIndent Indentation relative to the indentation of the thread at commit.
+*/
+void CConsole::CConsoleImpl::BatchAdd(
+    std::string& sPrintouts, CConsole::FormatSignal mode, int nIndent, bool nl, const char* fmt, va_list list)
+{
+    if ( isSurelyFilteredOut(mode, nl) )
+        return;
+
+    CConsoleBinaryLog::Put(sPrintouts, static_cast<std::uint8_t>(mode));
+    CConsoleBinaryLog::PutString(sPrintouts, fmt);
+    CConsoleBinaryLog::Put(sPrintouts, static_cast<std::int32_t>(nIndent));
+    CConsoleBinaryLog::Put(sPrintouts, static_cast<std::uint8_t>(nl ? 1 : 0));
+    PutFormattedArgs(sPrintouts, fmt, list);
+} // BatchAdd()
+
+
+/**
+    Writes the printouts of a CConsole::Batch, encoded by BatchAdd().
+    Sinks are flushed at most once, after all printouts are written.
+    Caller must hold mainMutex, so the printouts are not mixed with printouts of other threads.
+    @param nBatchIndent Indentation change of the batch, kept by the thread after the printouts.
+*/
+void CConsole::CConsoleImpl::WriteBatch(const std::string& sPrintouts, int nBatchIndent)
+{
+    if ( !bInited )
+        return;
+
+    const int nBaseIndent = getLogState().nIndentValue;
+    bWritingBatch = true;
+    bBatchFlushDue = false;
+    const char* p = sPrintouts.data();
+    const char* const end = p + sPrintouts.size();
+    bool bOk = true;
+    while ( bOk && (p < end) )
+    {
+        std::uint8_t mode = 0;
+        bOk = CConsoleBinaryLog::Get(p, end, mode);
+        if ( !bOk )
+            break;
+
+        if ( mode == CConsole::S )
+        {
+            SOn();
+            bOk = WriteEncodedPrintout(p, end, nBaseIndent);
+            SOff();
+        }
+        else if ( mode == CConsole::E )
+        {
+            EOn();
+            bOk = WriteEncodedPrintout(p, end, nBaseIndent);
+            EOff();
+        }
+        else
+        {
+            bOk = WriteEncodedPrintout(p, end, nBaseIndent);
+        }
+    }
+    bWritingBatch = false;
+
+    getLogState().nIndentValue = nBaseIndent;
+    SetIndent(nBaseIndent + nBatchIndent);
+    if ( bBatchFlushDue )
+    {
+        FlushSinks();
+    }
+} // WriteBatch()
+
+
+/**
+    Makes the line just written by current thread its last line, so its identical lines can be suppressed by
+    isRepeatedLine() without taking mainMutex.
+    Must be called only for lines written at the start of a line.
+    @param fmt Format string of the line.
+    @return The string to append the argument values of the line to, NULL if identical lines are not collapsed.
+*/
+std::string* CConsole::CConsoleImpl::RememberLine(const char* fmt)
+{
+    // a count might be written on behalf of another thread, see WritePendingRepeats()
+    if ( bWritingCounts || (nRepeatedLinesTimeout.load(std::memory_order_relaxed) <= 0) )
+        return NULL;
+
+    const LogState& state = getLogState();
+    RepeatState& lastLine = threadStateGuard.lastLine;
+    lastLine.nInstanceId = nInstanceId;
+    lastLine.fmt = fmt;
+    lastLine.loggerModule = state.loggerModule;
+    lastLine.nMode = state.nMode;
+    lastLine.nRepeats.store(0, std::memory_order_relaxed);
+    lastLine.timeWritten = std::chrono::steady_clock::now();
+    lastLine.sArgs.clear();
+    return &lastLine.sArgs;
+} // RememberLine()
+
+
+/**
+    Ends the run of repeats of the last line of current thread: writes how many times the line was repeated, if it was,
+    then forgets the line, so the next identical line is written again.
+    Must be called before anything else is printed by the thread, or its indentation is changed.
+    Count is written in the mode of the line and current indentation of the thread, bypassing filter settings.
+*/
+void CConsole::CConsoleImpl::EndRepeats()
+{
+    RepeatState& lastLine = threadStateGuard.lastLine;
+    const unsigned long long nRepeats = lastLine.nRepeats.exchange(0, std::memory_order_relaxed);
+    if ( (nRepeats > 0) && (lastLine.nInstanceId == nInstanceId) )
+    {
+        WriteRepeatCount(lastLine, nRepeats);
+    }
+    lastLine.nInstanceId = 0;
+} // EndRepeats()
+
+
+/**
+    Writes how many times the given last line was repeated, for current thread.
+    Count is written in the mode of the line and current indentation of the thread, bypassing filter settings.
+*/
+void CConsole::CConsoleImpl::WriteRepeatCount(const RepeatState& lastLine, unsigned long long nRepeats)
+{
+    bWritingCounts = true;
+    const int nMode = getLogState().nMode;
+    SwitchMode(nMode, lastLine.nMode);
+    OLn((nRepeats == 1) ? "Last message repeated %llu time" : "Last message repeated %llu times", nRepeats);
+    SwitchMode(lastLine.nMode, nMode);
+    bWritingCounts = false;
+} // WriteRepeatCount()
+
+
+/**
+    Writes the pending repeats of the last lines of all threads, so a run of repeats followed by silence is not kept
+    pending until the next printout of its thread.
+    Counts are written by current thread as if the owner threads were writing them, with their log states: while
+    mainMutex is held, an owner thread might only count its repeats, see RepeatState.
+    Caller must hold mainMutex.
+    @param bAll False to write only the runs not continued anymore since their line is older than the timeout,
+                true to write all, e.g. when console is shut down.
+*/
+void CConsole::CConsoleImpl::WritePendingRepeats(bool bAll)
+{
+    const auto timeNow = std::chrono::steady_clock::now();
+    const std::chrono::milliseconds timeout(nRepeatedLinesTimeout.load(std::memory_order_relaxed));
+    ThreadStateGuard& guard = threadStateGuard;
+    const unsigned int nPrevInstanceId = guard.nInstanceId;
+    LogState* const pPrevState = guard.pState;
+    for (auto& it : logState)
+    {
+        const RepeatState* const pLastLine = it.second.pLastLine;
+        if ( !pLastLine || (pLastLine->nInstanceId != nInstanceId) )
+            continue;
+
+        if ( !bAll && ((timeNow - pLastLine->timeWritten) < timeout) )
+            continue;
+
+        const unsigned long long nRepeats = it.second.pLastLine->nRepeats.exchange(0, std::memory_order_relaxed);
+        if ( nRepeats == 0 )
+            continue;
+
+        guard.nInstanceId = nInstanceId;
+        guard.pState = &it.second;
+        WriteRepeatCount(*pLastLine, nRepeats);
+    }
+    guard.nInstanceId = nPrevInstanceId;
+    guard.pState = pPrevState;
+    if ( pPrevState && (nPrevInstanceId == nInstanceId) )
+    {
+        // changing mode above updated filterState of current thread from the other log states
+        PublishFilterState(*pPrevState);
+    }
+} // WritePendingRepeats()
+
+
+/**
+    Writes the dropped logs of the call sites of the rate-limited log macros that couldn't write them by themselves,
+    since they got no more calls, see CConsoleRateLimit::takeDrops().
+    The thread logging at the site is not known, so the count is written with the source location of the site, in its
+    mode, with siteDropsState: without indentation and logger module, bypassing filter settings.
+    Caller must hold mainMutex.
+    @param bAll False to write only the drops of sites idle for 2 seconds, true to write all, e.g. when console is shut down.
+*/
+void CConsole::CConsoleImpl::WriteSiteDrops(bool bAll)
+{
+    ThreadStateGuard& guard = threadStateGuard;
+    const unsigned int nPrevInstanceId = guard.nInstanceId;
+    LogState* const pPrevState = guard.pState;
+    bool bWritten = false;
+    for (CConsoleRateLimit::Site* pSite = CConsoleRateLimit::registeredSites.load(std::memory_order_acquire); pSite; pSite = pSite->pNext)
+    {
+        const unsigned long long nDropped = CConsoleRateLimit::takeDrops(*pSite, bAll ? 0 : 2);
+        if ( nDropped == 0 )
+            continue;
+
+        guard.nInstanceId = nInstanceId;
+        guard.pState = &siteDropsState;
+        RestoreDefaultColors();
+        bWritingCounts = true;
+        WriteDroppedLines(static_cast<CConsole::FormatSignal>(pSite->nMode), nDropped, pSite->szFile, pSite->nLine);
+        bWritingCounts = false;
+        bWritten = true;
+    }
+    if ( !bWritten )
+        return;
+
+    guard.nInstanceId = nPrevInstanceId;
+    guard.pState = pPrevState;
+    if ( pPrevState && (nPrevInstanceId == nInstanceId) )
+    {
+        PublishFilterState(*pPrevState);
+    }
+} // WriteSiteDrops()
+
+
+/**
+    Switches current thread from one mode to another.
+    @param nFrom Current mode: 0 for normal, 1 for error, 2 for success mode.
+    @param nTo   New mode, nothing happens if it is the same as nFrom.
+*/
+void CConsole::CConsoleImpl::SwitchMode(int nFrom, int nTo)
+{
+    if ( nFrom == nTo )
+        return;
+
+    if ( nFrom == 1 )
+        EOff();
+    else if ( nFrom == 2 )
+        SOff();
+
+    if ( nTo == 1 )
+        EOn();
+    else if ( nTo == 2 )
+        SOn();
+} // SwitchMode()
+
+
+/**
+    Gets handle of the given logger module if it is registered.
+    Caller must hold mainMutex.
+    @return ModuleHandle::None for empty or not registered module name.
+*/
+CConsole::ModuleHandle CConsole::CConsoleImpl::findModule(const char* loggerModuleName)
+{
+    const auto it = moduleHandles.find(std::string_view(loggerModuleName));
+    return (it == moduleHandles.end()) ? CConsole::ModuleHandle::None : it->second;
+} // findModule()
+
+
+/**
+    Gets handle of the given logger module, registers it if needed.
+    Module names are interned into small integer handles so that per-module filtering doesn't need any string compare.
+    Handles are kept for the process lifetime.
+    Caller must hold mainMutex.
+    @return ModuleHandle::None for empty module name, or if there are already CCONSOLE_MAX_LOGGER_MODULES registered
+            modules: in that case filtering cannot be done for the module so its logs always appear.
+*/
+CConsole::ModuleHandle CConsole::CConsoleImpl::registerModule(const char* loggerModuleName)
+{
+    if ( loggerModuleName[0] == '\0' )
+        return CConsole::ModuleHandle::None;
+
+    const auto it = moduleHandles.find(std::string_view(loggerModuleName));
+    if ( it != moduleHandles.end() )
+        return it->second;
+
+    // handle 0 is ModuleHandle::None
+    const size_t nModule = moduleHandles.size() + 1;
+    if ( nModule >= CCONSOLE_MAX_LOGGER_MODULES )
+        return CConsole::ModuleHandle::None;
+
+    const CConsole::ModuleHandle loggerModule = static_cast<CConsole::ModuleHandle>(nModule);
+    moduleNames[nModule] = moduleHandles.emplace(loggerModuleName, loggerModule).first->first.c_str();
+    return loggerModule;
+} // registerModule()
+
+
+/**
+    Tells if logging is enabled for the given logger module, either by its own logging state or by CCONSOLE_ALL_MODULES.
+    Lock-free: only relaxed atomic loads, no string compare.
+*/
+bool CConsole::CConsoleImpl::isModuleEnabled(CConsole::ModuleHandle loggerModule)
+{
+    const size_t nModule = static_cast<size_t>(loggerModule);
+    return ( (enabledModules[nModule / 64].load(std::memory_order_relaxed) & (std::uint64_t(1) << (nModule % 64))) != 0 ) ||
+        bAllModulesEnabled.load(std::memory_order_relaxed);
+} // isModuleEnabled()
+
+
+/**
+    Disables logging for all logger modules.
+*/
+void CConsole::CConsoleImpl::ClearEnabledModules()
+{
+    for (auto& bits : enabledModules)
+    {
+        bits.store(0, std::memory_order_relaxed);
+    }
+    bAllModulesEnabled.store(false, std::memory_order_relaxed);
+} // ClearEnabledModules()
+
+
+CConsole::CConsoleImpl::LogQueue::LogQueue(size_t nCapacity) :
+    nMask(nCapacity - 1),
+    cells(new Cell[nCapacity])
+{
+    for (size_t i = 0; i < nCapacity; i++)
+    {
+        cells[i].nSeq.store(i, std::memory_order_relaxed);
+    }
+    nEnqueuePos.store(0, std::memory_order_relaxed);
+    nDequeuePos.store(0, std::memory_order_relaxed);
+} // LogQueue()
+
+
+/**
+    Moves rec into the queue.
+    Can be invoked by multiple threads in parallel.
+    @return True on success, in such case rec is left empty. False if the queue is full, in such case rec is untouched.
+*/
+bool CConsole::CConsoleImpl::LogQueue::tryPush(LogRecord& rec)
+{
+    size_t nPos = nEnqueuePos.load(std::memory_order_relaxed);
+    Cell* cell;
+    for (;;)
+    {
+        cell = &cells[nPos & nMask];
+        const size_t nSeq = cell->nSeq.load(std::memory_order_acquire);
+        const intptr_t nDiff = static_cast<intptr_t>(nSeq) - static_cast<intptr_t>(nPos);
+        if (nDiff == 0)
+        {
+            // cell is free, try to reserve it
+            if (nEnqueuePos.compare_exchange_weak(nPos, nPos + 1, std::memory_order_relaxed))
+            {
+                break;
+            }
+            // nPos has been updated by compare_exchange_weak(), retry with that
+        }
+        else if (nDiff < 0)
+        {
+            // consumer has not yet freed this cell since the previous round: queue is full
+            return false;
+        }
+        else
+        {
+            // other producer got this cell before us
+            nPos = nEnqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    cell->rec.spans.swap(rec.spans);
+    cell->rec.loggerModule = rec.loggerModule;
+    cell->rec.nMode = rec.nMode;
+    rec.Clear();
+    cell->nSeq.store(nPos + 1, std::memory_order_release);
+    return true;
+} // tryPush()
+
+
+/**
+    Moves the oldest record into rec.
+    Must be invoked by the single consumer thread only.
+    @return True on success, false if the queue is empty.
+*/
+bool CConsole::CConsoleImpl::LogQueue::tryPop(LogRecord& rec)
+{
+    const size_t nPos = nDequeuePos.load(std::memory_order_relaxed);
+    Cell& cell = cells[nPos & nMask];
+    if (cell.nSeq.load(std::memory_order_acquire) != nPos + 1)
+    {
+        return false;
+    }
+
+    rec.spans.swap(cell.rec.spans);
+    rec.loggerModule = cell.rec.loggerModule;
+    rec.nMode = cell.rec.nMode;
+    cell.rec.Clear();
+    nDequeuePos.store(nPos + 1, std::memory_order_relaxed);
+    cell.nSeq.store(nPos + nMask + 1, std::memory_order_release);
+    return true;
+} // tryPop()
+
+
+/**
+    Tells if there is nothing to be popped right now.
+    Must be invoked by the single consumer thread only.
+*/
+bool CConsole::CConsoleImpl::LogQueue::isEmpty() const
+{
+    const size_t nPos = nDequeuePos.load(std::memory_order_relaxed);
+    return cells[nPos & nMask].nSeq.load(std::memory_order_acquire) != nPos + 1;
+} // isEmpty()
+
+
+CConsole::CConsoleImpl::LogSink::LogSink() :
+    nModes(0x7u)
+{
+    for (auto& bits : disabledModules)
+    {
+        bits.store(0, std::memory_order_relaxed);
+    }
+}
+
+
+CConsole::CConsoleImpl::LogSink::~LogSink()
+{
+
+}
+
+
+/**
+    Tells if the given record passes the filter of this sink.
+    Lock-free: only relaxed atomic loads.
+*/
+bool CConsole::CConsoleImpl::LogSink::accepts(const LogRecord& rec) const
+{
+    if ( (nModes.load(std::memory_order_relaxed) & (1u << rec.nMode)) == 0 )
+        return false;
+
+    const size_t nModule = static_cast<size_t>(rec.loggerModule);
+    return (disabledModules[nModule / 64].load(std::memory_order_relaxed) & (std::uint64_t(1) << (nModule % 64))) == 0;
+} // accepts()
+
+
+/**
+    Sets records of the given mode to be accepted or not.
+    @param nMode 0 for normal, 1 for error, 2 for success mode, same as LogState::nMode.
+*/
+void CConsole::CConsoleImpl::LogSink::SetModeState(int nMode, bool state)
+{
+    if ( state )
+        nModes.fetch_or(1u << nMode, std::memory_order_relaxed);
+    else
+        nModes.fetch_and(~(1u << nMode), std::memory_order_relaxed);
+} // SetModeState()
+
+
+/**
+    Sets records of the given logger module to be accepted or not.
+    Records of all logger modules are accepted by default.
+*/
+void CConsole::CConsoleImpl::LogSink::SetModuleState(CConsole::ModuleHandle loggerModule, bool state)
+{
+    const size_t nModule = static_cast<size_t>(loggerModule);
+    const std::uint64_t bit = std::uint64_t(1) << (nModule % 64);
+    if ( state )
+        disabledModules[nModule / 64].fetch_and(~bit, std::memory_order_relaxed);
+    else
+        disabledModules[nModule / 64].fetch_or(bit, std::memory_order_relaxed);
+} // SetModuleState()
+
+
+/**
+    Makes the written records really reach their destination.
+    Nothing to do by default.
+*/
+void CConsole::CConsoleImpl::LogSink::Flush()
+{
+
+} // Flush()
+
+
+/**
+    Renders the given record as plain text: text of the spans without colors, lines are ended by a single new line char.
+*/
+void CConsole::CConsoleImpl::LogSink::AppendPlainText(std::string& out, const LogRecord& rec)
+{
+    for (const auto& span : rec.spans)
+    {
+        switch ( span.type )
+        {
+        case LogRecord::SpanType::Indent:
+            AppendSpaces(out, static_cast<size_t>(span.nIndent));
+            break;
+        case LogRecord::SpanType::NewLine:
+            out += '\n';
+            break;
+        case LogRecord::SpanType::ModeBegin:
+        case LogRecord::SpanType::ModeEnd:
+            break;
+        default:
+            out += span.sText;
+        }
+    }
+} // AppendPlainText()
+
+
+/**
+    Appends n spaces to out, in chunks of a precomputed run of spaces instead of one by one.
+*/
+void CConsole::CConsoleImpl::LogSink::AppendSpaces(std::string& out, size_t n)
+{
+    static constexpr char spaces[] = "                                                                ";
+    static constexpr size_t nSpacesLength = sizeof(spaces) - 1;
+
+    while ( n > nSpacesLength )
+    {
+        out.append(spaces, nSpacesLength);
+        n -= nSpacesLength;
+    }
+    out.append(spaces, n);
+} // AppendSpaces()
+
+
+CConsole::CConsoleImpl::ConsoleSink::ConsoleSink()
+{
+    bOpen = false;
+#ifdef _WIN32
+    hConsole = NULL;
+    clrAttrWritten = 0;
+    bAttrWritten = false;
+#else
+    bStdoutColors = false;
+    bStderrColors = false;
+#endif
+}
+
+
+CConsole::CConsoleImpl::ConsoleSink::~ConsoleSink()
+{
+#ifdef _WIN32
+    if ( bOpen )
+    {
+        FreeConsole();
+    }
+#endif
+}
+
+
+/**
+    Creates the console window, or attaches to the terminal on non-Windows platforms.
+    @return False if console couldn't be created.
+*/
+bool CConsole::CConsoleImpl::ConsoleSink::Open(const char* title)
+{
+#ifdef _WIN32
+    if ( !AllocConsole() )
+        return false;
+
+    SetConsoleTitleA( title );
+    if ( NULL != (hConsole = GetStdHandle( STD_OUTPUT_HANDLE )) )
+    {
+        COORD crd;
+        crd.X = 80;
+        crd.Y = 10000;
+        SetConsoleScreenBufferSize(hConsole, crd);
+    }
+#else
+    bStdoutColors = (isatty(STDOUT_FILENO) != 0);
+    bStderrColors = (isatty(STDERR_FILENO) != 0);
+    if ( bStdoutColors && title )
+    {
+        // terminal title
+        const std::string sTitle = std::string("\x1b]0;") + title + "\x07";
+        if ( write(STDOUT_FILENO, sTitle.data(), sTitle.length()) < 0 )
+            bStdoutColors = false;
+    }
+#endif
+    bOpen = true;
+    return true;
+} // Open()
+
+
+/**
+    Writes a record to the console.
+    On Windows the text is written by the console API, with one call per run of same color.
+    On other platforms the whole record is collected with ANSI escape sequences for the colors and written by a single
+    write() to stdout, or to stderr in case of error mode. Escape sequences are written only if the output is a terminal,
+    so redirected output stays plain text.
+*/
+size_t CConsole::CConsoleImpl::ConsoleSink::Write(const LogRecord& rec)
+{
+#ifdef _WIN32
+    size_t nBytes = 0;
+    WORD clr = 0;
+    for (const auto& span : rec.spans)
+    {
+        if ( (span.type == LogRecord::SpanType::ModeBegin) || (span.type == LogRecord::SpanType::ModeEnd) )
+            continue;
+
+        if ( !sBuffer.empty() && (clr != span.clr) )
+        {
+            nBytes += WriteRun(clr);
+        }
+        clr = span.clr;
+        if ( span.type == LogRecord::SpanType::Indent )
+            AppendSpaces(sBuffer, static_cast<size_t>(span.nIndent));
+        else
+            sBuffer += span.sText;
+    }
+    nBytes += WriteRun(clr);
+    return nBytes;
+#else
+    const bool bColors = (rec.nMode == 1) ? bStderrColors : bStdoutColors;
+    bool bColorSet = false;
+    WORD clr = 0;
+    for (const auto& span : rec.spans)
+    {
+        if ( (span.type == LogRecord::SpanType::ModeBegin) || (span.type == LogRecord::SpanType::ModeEnd) )
+            continue;
+
+        if ( bColors && (!bColorSet || (clr != span.clr)) )
+        {
+            CConsoleAnsi::AppendSgr(sBuffer, span.clr);
+            clr = span.clr;
+            bColorSet = true;
+        }
+        // console API needs "\n\r" to end a line, terminal needs only "\n"
+        if ( span.type == LogRecord::SpanType::NewLine )
+            sBuffer += '\n';
+        else if ( span.type == LogRecord::SpanType::Indent )
+            AppendSpaces(sBuffer, static_cast<size_t>(span.nIndent));
+        else
+            sBuffer += span.sText;
+    }
+    if ( bColorSet )
+        sBuffer += CConsoleAnsi::SGR_RESET;
+
+    const int fd = (rec.nMode == 1) ? STDERR_FILENO : STDOUT_FILENO;
+    const size_t nBytes = sBuffer.length();
+    const char* p = sBuffer.data();
+    size_t nRemaining = nBytes;
+    while ( nRemaining > 0 )
+    {
+        const ssize_t nWritten = write(fd, p, nRemaining);
+        if ( nWritten < 0 )
+        {
+            if ( errno == EINTR )
+                continue;
+            break;
+        }
+        p += nWritten;
+        nRemaining -= static_cast<size_t>(nWritten);
+    }
+    sBuffer.clear();
+    return nBytes;
+#endif
+} // Write()
+
+
+#ifdef _WIN32
+/**
+    Writes sBuffer to the console with the given text attribute, and clears it.
+    Text attribute is set only if it differs from the last one set.
+*/
+size_t CConsole::CConsoleImpl::ConsoleSink::WriteRun(WORD clr)
+{
+    if ( sBuffer.empty() )
+        return 0;
+
+    if ( !bAttrWritten || (clrAttrWritten != clr) )
+    {
+        SetConsoleTextAttribute(hConsole, clr);
+        clrAttrWritten = clr;
+        bAttrWritten = true;
+    }
+    const size_t nBytes = sBuffer.length();
+    DWORD dwWritten;
+    WriteConsoleA(hConsole, sBuffer.c_str(), static_cast<DWORD>(nBytes), &dwWritten, 0);
+    sBuffer.clear();
+    return nBytes;
+} // WriteRun()
+#endif
+
+
+CConsole::CConsoleImpl::FileSink::FileSink()
+{
+    sFileBuffer.reserve(CCONSOLE_FILE_BUFFER_SIZE);
+}
+
+
+CConsole::CConsoleImpl::FileSink::~FileSink()
+{
+    if ( f.is_open() )
+    {
+        WriteFileBuffer();
+        f.close();
+    }
+}
+
+
+/**
+    Opens the file for writing, existing file is overwritten.
+    @return False if the file couldn't be opened.
+*/
+bool CConsole::CConsoleImpl::FileSink::Open(const char* filename)
+{
+    // we do our own buffering, so a flush of sFileBuffer is a single write to the file
+    f.rdbuf()->pubsetbuf(NULL, 0);
+    f.open(filename);
+    return !f.fail();
+} // Open()
+
+
+/**
+    Writes the buffered records to the file.
+*/
+void CConsole::CConsoleImpl::FileSink::Flush()
+{
+    WriteFileBuffer();
+    f.flush();
+} // Flush()
+
+
+/**
+    Moves sBuffer to sFileBuffer and clears it.
+    sFileBuffer is written to the file when it reaches CCONSOLE_FILE_BUFFER_SIZE.
+*/
+size_t CConsole::CConsoleImpl::FileSink::WriteBuffer()
+{
+    const size_t nBytes = sBuffer.length();
+    sFileBuffer += sBuffer;
+    sBuffer.clear();
+    if ( sFileBuffer.length() >= CCONSOLE_FILE_BUFFER_SIZE )
+    {
+        WriteFileBuffer();
+    }
+    return nBytes;
+} // WriteBuffer()
+
+
+/**
+    Writes sFileBuffer to the file and clears it.
+*/
+void CConsole::CConsoleImpl::FileSink::WriteFileBuffer()
+{
+    if ( sFileBuffer.empty() )
+        return;
+
+    f.write(sFileBuffer.data(), static_cast<std::streamsize>(sFileBuffer.length()));
+    sFileBuffer.clear();
+} // WriteFileBuffer()
+
+
+CConsole::CConsoleImpl::HtmlFileSink::HtmlFileSink() :
+    bCompact(false),
+    bInPre(false),
+    nPreLines(0),
+    nOpenModeTags(0),
+    clrValueTag(NULL)
+{
+
+}
+
+
+CConsole::CConsoleImpl::HtmlFileSink::~HtmlFileSink()
+{
+    if ( f.is_open() )
+    {
+        if ( bInPre )
+            sBuffer += "</pre>\n";
+        sBuffer += "</font>\n";
+        sBuffer += "</body>\n";
+        sBuffer += "</html>\n";
+        WriteBuffer();
+    }
+}
+
+
+/**
+    Opens the file and writes the html header.
+    @return False if the file couldn't be opened.
+*/
+bool CConsole::CConsoleImpl::HtmlFileSink::Open(const char* filename, const char* title)
+{
+    if ( !FileSink::Open(filename) )
+        return false;
+
+    sBuffer += "<html>\n";
+    sBuffer += "<head>\n";
+    sBuffer += "<title>";
+    CConsoleHtml::AppendEscaped(sBuffer, title, strlen(title), false);
+    sBuffer += "</title>\n";
+    CConsoleHtml::AppendStyle(sBuffer);
+    sBuffer += "</head>\n";
+    sBuffer += "<body bgcolor=\"#1D1D1D\" text=\"#DDDDDD\">\n";
+    sBuffer += "<font face=\"Courier\" size=\"2\">\n";
+    WriteBuffer();
+    return true;
+} // Open()
+
+
+/**
+    Writes a record to the html file, with the same indentation and colors as in the console.
+*/
+size_t CConsole::CConsoleImpl::HtmlFileSink::Write(const LogRecord& rec)
+{
+    if ( bCompact.load(std::memory_order_relaxed) )
+    {
+        return WriteCompact(rec);
+    }
+
+    if ( bInPre )
+    {
+        sBuffer += "</pre>\n";
+        bInPre = false;
+    }
+
+    for (const auto& span : rec.spans)
+    {
+        switch ( span.type )
+        {
+        case LogRecord::SpanType::Spaces:
+            CConsoleHtml::AppendNbsp(sBuffer, span.sText.length());
+            break;
+        case LogRecord::SpanType::Indent:
+            CConsoleHtml::AppendNbsp(sBuffer, static_cast<size_t>(span.nIndent));
+            break;
+        case LogRecord::SpanType::Value:
+            sBuffer += "<font color=\"#";
+            sBuffer += span.clrHtml;
+            sBuffer += "\">";
+            CConsoleHtml::AppendEscaped(sBuffer, span.sText.data(), span.sText.length(), true);
+            sBuffer += "</font>";
+            break;
+        case LogRecord::SpanType::NewLine:
+            sBuffer += "<br>\n";
+            break;
+        case LogRecord::SpanType::ModeBegin:
+            sBuffer += "<font color=\"#";
+            sBuffer += span.clrHtml;
+            sBuffer += "\">";
+            break;
+        case LogRecord::SpanType::ModeEnd:
+            sBuffer += "</font>";
+            break;
+        default:
+            CConsoleHtml::AppendEscaped(sBuffer, span.sText.data(), span.sText.length(), true);
+        }
+    }
+    return WriteBuffer();
+} // Write()
+
+
+/**
+    Sets subsequent records to be written in compact html or not.
+    Lock-free, since records might be written by writerThread at the same time.
+*/
+void CConsole::CConsoleImpl::HtmlFileSink::SetCompact(bool state)
+{
+    bCompact.store(state, std::memory_order_relaxed);
+} // SetCompact()
+
+
+/**
+    Writes a record to the html file in compact html, see CConsoleHtml.h.
+    Adjacent Value spans of the same color share a single tag, spaces between them are also put into that tag.
+*/
+size_t CConsole::CConsoleImpl::HtmlFileSink::WriteCompact(const LogRecord& rec)
+{
+    if ( !bInPre )
+    {
+        sBuffer += "<pre>";
+        bInPre = true;
+        nPreLines = 0;
+    }
+
+    for (const auto& span : rec.spans)
+    {
+        switch ( span.type )
+        {
+        case LogRecord::SpanType::Value:
+            if ( !clrValueTag || (strcmp(clrValueTag, span.clrHtml) != 0) )
+            {
+                CloseValueTag();
+                CConsoleHtml::AppendColorTag(sBuffer, span.clrHtml);
+                clrValueTag = span.clrHtml;
+            }
+            CConsoleHtml::AppendEscaped(sBuffer, span.sText.data(), span.sText.length(), false);
+            break;
+        case LogRecord::SpanType::Spaces:
+            sBuffer += span.sText;
+            break;
+        case LogRecord::SpanType::Indent:
+            AppendSpaces(sBuffer, static_cast<size_t>(span.nIndent));
+            break;
+        case LogRecord::SpanType::NewLine:
+            CloseValueTag();
+            sBuffer += '\n';
+            nPreLines++;
+            break;
+        case LogRecord::SpanType::ModeBegin:
+            CloseValueTag();
+            CConsoleHtml::AppendColorTag(sBuffer, span.clrHtml);
+            nOpenModeTags++;
+            break;
+        case LogRecord::SpanType::ModeEnd:
+            CloseValueTag();
+            if ( nOpenModeTags > 0 )
+            {
+                sBuffer += "</i>";
+                nOpenModeTags--;
+            }
+            break;
+        default:
+            if ( span.sText.find_first_not_of(' ') != std::string::npos )
+                CloseValueTag();
+            CConsoleHtml::AppendEscaped(sBuffer, span.sText.data(), span.sText.length(), false);
+        }
+    }
+    CloseValueTag();
+
+    // block is not closed in the middle of an error or success mode text, otherwise tags would be mixed up
+    if ( (nPreLines >= CConsoleHtml::PRE_BLOCK_LINES) && (nOpenModeTags == 0) )
+    {
+        sBuffer += "</pre>\n";
+        bInPre = false;
+    }
+    return WriteBuffer();
+} // WriteCompact()
+
+
+/**
+    Closes the tag of Value spans, if open.
+*/
+void CConsole::CConsoleImpl::HtmlFileSink::CloseValueTag()
+{
+    if ( !clrValueTag )
+        return;
+
+    sBuffer += "</i>";
+    clrValueTag = NULL;
+} // CloseValueTag()
+
+
+/**
+    Writes a record to the text file as plain text.
+*/
+size_t CConsole::CConsoleImpl::TextFileSink::Write(const LogRecord& rec)
+{
+    AppendPlainText(sBuffer, rec);
+    return WriteBuffer();
+} // Write()
+
+
+/**
+    Writes a record to the JSON-lines file, one object per line of the record.
+    Unfinished line of the record, if any, is also written as a separate object.
+*/
+size_t CConsole::CConsoleImpl::JsonFileSink::Write(const LogRecord& rec)
+{
+    sLine.clear();
+    for (const auto& span : rec.spans)
+    {
+        switch ( span.type )
+        {
+        case LogRecord::SpanType::Indent:
+            AppendSpaces(sLine, static_cast<size_t>(span.nIndent));
+            break;
+        case LogRecord::SpanType::NewLine:
+            AppendLine(rec);
+            sLine.clear();
+            break;
+        case LogRecord::SpanType::ModeBegin:
+        case LogRecord::SpanType::ModeEnd:
+            break;
+        default:
+            sLine += span.sText;
+        }
+    }
+    if ( !sLine.empty() )
+    {
+        AppendLine(rec);
+    }
+    return WriteBuffer();
+} // Write()
+
+
+/**
+    Appends sLine as a JSON object to sBuffer, e.g.:
+    {"module":"MyModule","mode":"error","text":"Couldn't load file"}
+*/
+void CConsole::CConsoleImpl::JsonFileSink::AppendLine(const LogRecord& rec)
+{
+    static constexpr const char* modeNames[] = { "normal", "error", "success" };
+
+    const char* const loggerModuleName = moduleNames[static_cast<size_t>(rec.loggerModule)];
+    sBuffer += "{\"module\":\"";
+    AppendEscaped(loggerModuleName ? loggerModuleName : "");
+    sBuffer += "\",\"mode\":\"";
+    sBuffer += modeNames[((rec.nMode >= 0) && (rec.nMode <= 2)) ? rec.nMode : 0];
+    sBuffer += "\",\"text\":\"";
+    AppendEscaped(sLine);
+    sBuffer += "\"}\n";
+} // AppendLine()
+
+
+/**
+    Appends text to sBuffer, escaped as JSON string content.
+*/
+void CConsole::CConsoleImpl::JsonFileSink::AppendEscaped(std::string_view text)
+{
+    static constexpr const char* hexDigits = "0123456789abcdef";
+
+    for (const char c : text)
+    {
+        switch ( c )
+        {
+        case '"':  sBuffer += "\\\""; break;
+        case '\\': sBuffer += "\\\\"; break;
+        case '\n': sBuffer += "\\n";  break;
+        case '\r': sBuffer += "\\r";  break;
+        case '\t': sBuffer += "\\t";  break;
+        default:
+            if ( static_cast<unsigned char>(c) < 0x20 )
+            {
+                sBuffer += "\\u00";
+                sBuffer += hexDigits[(c >> 4) & 0xF];
+                sBuffer += hexDigits[c & 0xF];
+            }
+            else
+            {
+                sBuffer += c;
+            }
+        }
+    }
+} // AppendEscaped()
+
+
+/**
+    Appends a record to the collected text as plain text.
+*/
+size_t CConsole::CConsoleImpl::MemorySink::Write(const LogRecord& rec)
+{
+    std::lock_guard<std::mutex> lock(textMutex);
+    const size_t nLength = sText.length();
+    AppendPlainText(sText, rec);
+    return sText.length() - nLength;
+} // Write()
+
+
+/**
+    Discards the record.
+*/
+size_t CConsole::CConsoleImpl::NullSink::Write(const LogRecord&)
+{
+    return 0;
+} // Write()
+
+
+/**
+    Gets the text collected so far.
+*/
+std::string CConsole::CConsoleImpl::MemorySink::getText()
+{
+    std::lock_guard<std::mutex> lock(textMutex);
+    return sText;
+} // getText()
+
+
+/**
+    Clears the text collected so far.
+*/
+void CConsole::CConsoleImpl::MemorySink::Clear()
+{
+    std::lock_guard<std::mutex> lock(textMutex);
+    sText.clear();
+} // Clear()
+
+
+/**
+    Sets the console text attribute for subsequent AddSpan() calls.
+    Per-thread property: the attribute is stored with the upcoming console spans of the current line,
+    the console itself is set only when the line is written.
+*/
+void CConsole::CConsoleImpl::SetConsoleAttr(WORD clr)
+{
+    getLogState().clrConsoleAttr = clr;
+} // SetConsoleAttr()
+
+
+/**
+    Appends a span to the current line of current thread, with the console text attribute set by last SetConsoleAttr().
+    Text and Spaces spans are appended to the last span if that has the same type and color, so the line is rendered
+    with as few spans as possible.
+    @param clrHtml Html color of Value and ModeBegin spans, ignored for other spans.
+*/
+void CConsole::CConsoleImpl::AddSpan(LogRecord::SpanType type, const char* text, size_t len, const char* clrHtml)
+{
+    const bool bMergeable = (type == LogRecord::SpanType::Text) || (type == LogRecord::SpanType::Spaces);
+    if ( bMergeable && (len == 0) )
+        return;
+
+    LogState& state = getLogState();
+    std::vector<LogRecord::Span>& spans = state.line.spans;
+    if ( bMergeable && !spans.empty() && (spans.back().type == type) && (spans.back().clr == state.clrConsoleAttr) )
+    {
+        spans.back().sText.append(text, len);
+        return;
+    }
+
+    spans.emplace_back();
+    LogRecord::Span& span = spans.back();
+    span.type = type;
+    span.clr = state.clrConsoleAttr;
+    span.nIndent = 0;
+    span.clrHtml[0] = '\0';
+    if ( clrHtml )
+    {
+        strncpy(span.clrHtml, clrHtml, HTML_CLR_S - 1);
+        span.clrHtml[HTML_CLR_S - 1] = '\0';
+    }
+    span.sText.assign(text, len);
+} // AddSpan()
+
+
+/**
+    Writes the collected line of the given thread to the sinks in one go, or queues it for the writer thread in async mode.
+    Since the whole line is written at once, lines of different threads never get mixed.
+    If the queue is full, we wait for the writer thread to make some space, so no log is lost and order is kept.
+*/
+void CConsole::CConsoleImpl::CommitLine(LogState& state)
+{
+    if ( state.line.isEmpty() )
+        return;
+
+    state.line.loggerModule = state.loggerModule;
+    state.line.nMode = state.nMode;
+    RecordFlightText(state.line);
+    if ( !bAsync )
+    {
+        WriteRecord(state.line);
+        if ( !isFlushDue(state.line.nMode) )
+        {
+            // flushed later by Tick() if the policy is FlushPolicy::Interval
+            bUnflushedLines = true;
+        }
+        else if ( bWritingBatch )
+        {
+            bBatchFlushDue = true;
+        }
+        else
+        {
+            FlushSinks();
+            bUnflushedLines = false;
+        }
+        state.line.Clear();
+        return;
+    }
+
+    while ( !asyncQueue->tryPush(state.line) )
+    {
+        writerCv.notify_one();
+        std::this_thread::yield();
+    }
+
+    // pairs with the fence in WriterThreadMain(): either the writer sees our record before going to sleep,
+    // or we see that it is sleeping and wake it up
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if ( bWriterSleeping.load(std::memory_order_relaxed) )
+    {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        writerCv.notify_one();
     }
-    ImmediateWriteString(text);
-    return *this;
-} // operator<<()
+} // CommitLine()
 
 
 /**
-    O("%b", b).
+    Records the plain text of a line into flightRecorder, the same text as in the console, without colors.
+    Invoked when the line is committed, before it is queued or written to the sinks.
+    Caller must hold mainMutex, this is what serializes the recording threads.
 */
-CConsole::CConsoleImpl& CConsole::CConsoleImpl::operator<<(const bool& b)
+void CConsole::CConsoleImpl::RecordFlightText(const LogRecord& rec)
 {
-    if ( !bInited )
-        return *this;
-
-    if (bFirstWriteTextCallAfterWriteTextLn)
+    char* const data = flightRecorder.Begin(CConsoleFlightRecorder::RecordType::Text);
+    size_t nLength = 0;
+    for (const auto& span : rec.spans)
     {
-        for (int i = 0; i < logState[std::this_thread::get_id()].nIndentValue; i++)
+        switch ( span.type )
         {
-            WriteText(" ");
+        case LogRecord::SpanType::Indent:
+            nLength = CConsoleFlightRecorder::AppendSpaces(data, nLength, static_cast<size_t>(span.nIndent));
+            break;
+        case LogRecord::SpanType::NewLine:
+            nLength = CConsoleFlightRecorder::Append(data, nLength, "\n", 1);
+            break;
+        case LogRecord::SpanType::ModeBegin:
+        case LogRecord::SpanType::ModeEnd:
+            break;
+        default:
+            nLength = CConsoleFlightRecorder::Append(data, nLength, span.sText.data(), span.sText.size());
         }
     }
-    ImmediateWriteBool(b);
-    return *this;
-} // operator<<()
+    flightRecorder.End(nLength);
+} // RecordFlightText()
 
 
 /**
-    O("%d", n).
+    Records the binary record being appended into flightRecorder, unformatted, see CConsoleFlightRecorder::RecordType.
+    Caller must hold mainMutex, this is what serializes the recording threads.
 */
-CConsole::CConsoleImpl& CConsole::CConsoleImpl::operator<<(const int& n)
+void CConsole::CConsoleImpl::RecordFlightBinary()
 {
-    if ( !bInited )
-        return *this;
+    const std::int32_t nIndent = static_cast<std::int32_t>(getLogState().nIndentValue);
+    char* const data = flightRecorder.Begin(CConsoleFlightRecorder::RecordType::Binary);
+    size_t nLength = 0;
+    nLength = CConsoleFlightRecorder::Append(data, nLength, reinterpret_cast<const char*>(&nIndent), sizeof(nIndent));
+    nLength = CConsoleFlightRecorder::Append(data, nLength, reinterpret_cast<const char*>(&binaryRecordFlags), sizeof(binaryRecordFlags));
+    nLength = CConsoleFlightRecorder::Append(data, nLength, binaryRecordFmt, strlen(binaryRecordFmt) + 1);
+    nLength = CConsoleFlightRecorder::Append(data, nLength, sBinaryBuffer.data() + nBinaryRecordArgs, sBinaryBuffer.size() - nBinaryRecordArgs);
+    flightRecorder.End(nLength);
+} // RecordFlightBinary()
+
+
+/**
+    Writes or queues the collected line of current thread, if the line has been finished by a new line.
+    Unfinished lines are kept so that O() calls of different threads don't get mixed.
+*/
+void CConsole::CConsoleImpl::CommitFinishedLine()
+{
+    LogState& state = getLogState();
+    if ( state.bFirstWriteTextCallAfterWriteTextLn )
+    {
+        CommitLine(state);
+    }
+} // CommitFinishedLine()
+
+
+/**
+    Writes or queues the collected lines of all threads, even if they are not yet finished.
+    Used before shutting down so that no log is lost.
+*/
+void CConsole::CConsoleImpl::CommitAllLines()
+{
+    for (auto& it : logState)
+    {
+        CommitLine(it.second);
+    }
+} // CommitAllLines()
+
 
-    if (bFirstWriteTextCallAfterWriteTextLn)
+/**
+    Writes a record to the sinks accepting it.
+    Used by the writer thread in async mode.
+*/
+void CConsole::CConsoleImpl::WriteRecord(const LogRecord& rec)
+{
+    const auto timeStart = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < CCONSOLE_SINK_COUNT; i++)
     {
-        for (int i = 0; i < logState[std::this_thread::get_id()].nIndentValue; i++)
+        if ( sinks[i] && sinks[i]->accepts(rec) )
         {
-            WriteText(" ");
+            stats.nSinkBytes[i].fetch_add(sinks[i]->Write(rec), std::memory_order_relaxed);
         }
     }
-    ImmediateWriteInt(n);
-    return *this;
-} // operator<<()
+    stats.nSinkWriteNanosecs.fetch_add(static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - timeStart).count()),
+        std::memory_order_relaxed);
+} // WriteRecord()
 
 
 /**
-    O("%f", f).
+    Makes the records written so far really reach the destination of the open sinks.
 */
-CConsole::CConsoleImpl& CConsole::CConsoleImpl::operator<<(const float& f)
+void CConsole::CConsoleImpl::FlushSinks()
 {
-    if ( !bInited )
-        return *this;
+    const auto timeStart = std::chrono::steady_clock::now();
+    for (const auto& sink : sinks)
+    {
+        if ( sink )
+        {
+            sink->Flush();
+        }
+    }
+    timeLastFlush = std::chrono::steady_clock::now();
+    stats.nFlushes.fetch_add(1, std::memory_order_relaxed);
+    stats.nSinkWriteNanosecs.fetch_add(static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(timeLastFlush - timeStart).count()),
+        std::memory_order_relaxed);
+} // FlushSinks()
+
+
+/**
+    Tells if the sinks should be flushed after writing a record of the given mode, according to flushPolicy.
+    @param nMode Mode of the record: 0 for normal, 1 for error, 2 for success mode.
+*/
+bool CConsole::CConsoleImpl::isFlushDue(int nMode) const
+{
+    switch ( flushPolicy.load(std::memory_order_relaxed) )
+    {
+    case CConsole::FlushPolicy::EveryLine:
+        return true;
+    case CConsole::FlushPolicy::OnError:
+        return nMode == 1;
+    case CConsole::FlushPolicy::Interval:
+        return (std::chrono::steady_clock::now() - timeLastFlush) >=
+            std::chrono::milliseconds(nFlushIntervalMillisecs.load(std::memory_order_relaxed));
+    default:
+        return false;
+    }
+} // isFlushDue()
+
 
-    if (bFirstWriteTextCallAfterWriteTextLn)
+/**
+    Creates and opens a sink.
+    @param filename Name of the file for the file sinks. If NULL, text and JSON-lines file names are derived from the
+                    name of the html log file.
+    @return NULL if the sink couldn't be opened.
+*/
+std::unique_ptr<CConsole::CConsoleImpl::LogSink> CConsole::CConsoleImpl::CreateSink(CConsole::Sink sink, const char* filename)
+{
+    std::string sFilename = filename ? filename : "";
+    if ( sFilename.empty() && !sLogFilename.empty() )
+    {
+        const std::string sBase = sLogFilename.substr(0, sLogFilename.rfind('.'));
+        if ( sink == CConsole::Sink::TextFile )
+            sFilename = sBase + ".txt";
+        else if ( sink == CConsole::Sink::JsonFile )
+            sFilename = sBase + ".jsonl";
+    }
+
+    switch ( sink )
     {
-        for (int i = 0; i < logState[std::this_thread::get_id()].nIndentValue; i++)
+    case CConsole::Sink::Console:
+        {
+            std::unique_ptr<ConsoleSink> consoleSink(new ConsoleSink());
+            if ( !consoleSink->Open(sLogTitle.c_str()) )
+                return nullptr;
+            return consoleSink;
+        }
+    case CConsole::Sink::HtmlFile:
         {
-            WriteText(" ");
+            std::unique_ptr<HtmlFileSink> htmlSink(new HtmlFileSink());
+            if ( sFilename.empty() || !htmlSink->Open(sFilename.c_str(), sLogTitle.c_str()) )
+                return nullptr;
+            htmlSink->SetCompact(bCompactHtml);
+            return htmlSink;
         }
+    case CConsole::Sink::TextFile:
+        {
+            std::unique_ptr<TextFileSink> textSink(new TextFileSink());
+            if ( sFilename.empty() || !textSink->Open(sFilename.c_str()) )
+                return nullptr;
+            return textSink;
+        }
+    case CConsole::Sink::JsonFile:
+        {
+            std::unique_ptr<JsonFileSink> jsonSink(new JsonFileSink());
+            if ( sFilename.empty() || !jsonSink->Open(sFilename.c_str()) )
+                return nullptr;
+            return jsonSink;
+        }
+    case CConsole::Sink::Memory:
+        return std::unique_ptr<LogSink>(new MemorySink());
+    case CConsole::Sink::Null:
+        return std::unique_ptr<LogSink>(new NullSink());
+    default:
+        return nullptr;
     }
-    ImmediateWriteFloat(f);
-    return *this;
-} // operator<<()
+} // CreateSink()
 
 
 /**
-    Changes current mode or adds a new line.
-    Based on value of fs, equals to calling EOn()/EOff()/SOn()/SOff()/NOn() accordingly.
-    If fs is FormatSignal::NL, the behavior is same as OLn("").
+    Starts the writer thread, after this all output goes thru the queue.
 */
-CConsole::CConsoleImpl& CConsole::CConsoleImpl::operator<<(const CConsole::FormatSignal& fs)
+void CConsole::CConsoleImpl::StartWriterThread()
 {
-    if ( !bInited )
-        return *this;
+    if ( writerThread.joinable() )
+        return;
 
-    switch (fs)
+    if ( !asyncQueue )
     {
-    case NL: WriteText("\n\r"); break;
-    case  S: SOn(); break;
-    case  E: EOn(); break;
-    default: NOn(); break;
+        asyncQueue.reset(new LogQueue(CCONSOLE_ASYNC_QUEUE_CAPACITY));
     }
-    return *this;
-} // operator<<()
 
+    bWriterRunning = true;
+    try
+    {
+        writerThread = std::thread(&CConsoleImpl::WriterThreadMain, this);
+    }
+    catch (const std::system_error&)
+    {
+        bWriterRunning = false;
+        return;
+    }
+    bAsync = true;
+} // StartWriterThread()
 
-// ############################## PROTECTED ##############################
 
+/**
+    Makes the writer thread write all queued records and then stops it, after this all output is written immediately again.
+    Caller must make sure no other thread is producing records in the meantime (i.e. mainMutex is held).
+*/
+void CConsole::CConsoleImpl::StopWriterThread()
+{
+    if ( !writerThread.joinable() )
+        return;
 
-// ############################### PRIVATE ###############################
+    bWriterRunning = false;
+    {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        writerCv.notify_one();
+    }
+    writerThread.join();
+    bAsync = false;
+} // StopWriterThread()
 
 
-CConsole::CConsoleImpl CConsole::CConsoleImpl::consoleImplInstance;
-int CConsole::CConsoleImpl::nErrorOutCount = 0;     /**< Total OLn() during error mode. */
-int CConsole::CConsoleImpl::nSuccessOutCount = 0;   /**< Total OLn() during success mode. */
+/**
+    Main function of the writer thread.
+    Pops records from the queue and writes them until StopWriterThread() is invoked, then writes the remaining records and exits.
+    The sinks are flushed according to flushPolicy, with FlushPolicy::EveryLine whenever there is nothing more to write.
+    Flush requests of Flush() are handled when there is nothing more to write.
+*/
+void CConsole::CConsoleImpl::WriterThreadMain()
+{
+    LogRecord rec;
+    bool bFlushNeeded = false;
+    for (;;)
+    {
+        // records pushed before this flush request are already visible to us, so they are written before we handle it
+        const unsigned int nRequests = nFlushRequests.load(std::memory_order_acquire);
+        if ( asyncQueue->tryPop(rec) )
+        {
+            WriteRecord(rec);
+            bFlushNeeded = true;
+            // with EveryLine policy, records written in a burst are flushed together when the queue gets empty
+            if ( (flushPolicy.load(std::memory_order_relaxed) != CConsole::FlushPolicy::EveryLine) && isFlushDue(rec.nMode) )
+            {
+                FlushSinks();
+                bFlushNeeded = false;
+            }
+            continue;
+        }
 
+        if ( (bFlushNeeded && isFlushDue(0)) || (nRequests != nFlushesDone.load(std::memory_order_relaxed)) )
+        {
+            FlushSinks();
+            bFlushNeeded = false;
+            nFlushesDone.store(nRequests, std::memory_order_release);
+        }
 
-CConsole::CConsoleImpl::CConsoleImpl()
+        if ( !bWriterRunning.load(std::memory_order_acquire) )
+        {
+            // StopWriterThread() was invoked, records pushed before that are already visible to us
+            while ( asyncQueue->tryPop(rec) )
+            {
+                WriteRecord(rec);
+            }
+            break;
+        }
+
+        std::unique_lock<std::mutex> lock(writerMutex);
+        bWriterSleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if ( asyncQueue->isEmpty() && bWriterRunning.load(std::memory_order_acquire) &&
+             (nFlushRequests.load(std::memory_order_relaxed) == nFlushesDone.load(std::memory_order_relaxed)) )
+        {
+            writerCv.wait_for(lock, std::chrono::milliseconds(CCONSOLE_WRITER_IDLE_WAIT_MS));
+        }
+        bWriterSleeping.store(false, std::memory_order_relaxed);
+    }
+
+    FlushSinks();
+} // WriterThreadMain()
+
+
+/**
+    Starts the tick thread, invoked once when console is initialized.
+    Without the tick thread, the work of Tick() would wait for the next log, that might never come.
+*/
+void CConsole::CConsoleImpl::StartTickThread()
 {
-    hConsole = NULL;
-    nRefCount = 0;
-    bInited = false;
-    bErrorsAlwaysOn = true;
-    bFirstWriteTextCallAfterWriteTextLn = true;
-    RestoreDefaultColors();
-    SaveColors();
-} // CConsoleImpl(...)
+    if ( tickThread.joinable() )
+        return;
 
+    bTickRunning = true;
+    try
+    {
+        tickThread = std::thread(&CConsoleImpl::TickThreadMain, this);
+    }
+    catch (const std::system_error&)
+    {
+        bTickRunning = false;
+    }
+} // StartTickThread()
 
-CConsole::CConsoleImpl::CConsoleImpl(const CConsoleImpl&)
+
+/**
+    Stops the tick thread.
+    Might be invoked with mainMutex held, TickThreadMain() never waits for mainMutex, so it can always exit.
+*/
+void CConsole::CConsoleImpl::StopTickThread()
 {
+    if ( !tickThread.joinable() )
+        return;
 
-}
+    {
+        std::lock_guard<std::mutex> lock(tickMutex);
+        bTickRunning = false;
+        tickCv.notify_one();
+    }
+    tickThread.join();
+} // StopTickThread()
 
 
-CConsole::CConsoleImpl& CConsole::CConsoleImpl::operator=(const CConsoleImpl&)
+/**
+    Main function of the tick thread.
+    Invokes Tick() every CCONSOLE_TICK_MS milliseconds until StopTickThread() is invoked.
+    If mainMutex is held by someone else, that tick is skipped: logging threads are busy then anyway, and this way
+    StopTickThread() can be invoked with mainMutex held.
+*/
+void CConsole::CConsoleImpl::TickThreadMain()
 {
-    return *this;
-}
+    std::unique_lock<std::mutex> lock(tickMutex);
+    while ( bTickRunning.load(std::memory_order_acquire) )
+    {
+        tickCv.wait_for(lock, std::chrono::milliseconds(CCONSOLE_TICK_MS));
+        if ( !bTickRunning.load(std::memory_order_acquire) )
+            break;
+
+        std::unique_lock<CConsoleMutex> mainLock(mainMutex, std::try_to_lock);
+        if ( mainLock.owns_lock() )
+        {
+            Tick();
+        }
+    }
+} // TickThreadMain()
 
 
-CConsole::CConsoleImpl::~CConsoleImpl()
+/**
+    Periodic work of the tick thread, invoked with mainMutex held.
+    In sync mode with FlushPolicy::Interval, lines written since the last flush are flushed when the interval elapses.
+    In async mode writerThread does the same by itself.
+    Repeats of lines not continued anymore are written, see WritePendingRepeats(), and so are the dropped logs of
+    silent call sites of the rate-limited log macros, see WriteSiteDrops().
+*/
+void CConsole::CConsoleImpl::Tick()
 {
-#ifdef CCONSOLE_IS_ENABLED
-    FreeConsole();
-    if ( bAllowLogFile )
+    if ( !bInited )
+        return;
+
+    if ( nRepeatedLinesTimeout.load(std::memory_order_relaxed) > 0 )
     {
-        fLog << "</font>" << endl;
-        fLog << "</body>" << endl;
-        fLog << "</html>" << endl;
-        fLog.close();
+        WritePendingRepeats(false);
     }
-#endif
-} // ~CConsoleImpl()
+    WriteSiteDrops(false);
+
+    if ( !bAsync && bUnflushedLines && (flushPolicy.load(std::memory_order_relaxed) == CConsole::FlushPolicy::Interval) && isFlushDue(0) )
+    {
+        FlushSinks();
+        bUnflushedLines = false;
+    }
+} // Tick()
 
 
-bool CConsole::CConsoleImpl::canWeWriteBasedOnFilterSettings()
+/**
+    Appends a log record to the binary buffer, without the argument values: those are appended by the caller.
+    Format string and logger module name are also appended before, if they are not yet in the current session.
+    Caller must also invoke BinaryEndRecord() after the argument values.
+    @param fmt   Format string of the record.
+    @param flags Flags of the record, see CConsoleBinaryLog::Flag.
+*/
+void CConsole::CConsoleImpl::BinaryBeginRecord(const char* fmt, std::uint8_t flags)
 {
-    if ( logState[std::this_thread::get_id()].sLoggerName.empty() )
+    LogState& state = getLogState();
+    if ( state.nThreadIndex == 0 )
     {
-        return true;
+        state.nThreadIndex = ++nLastThreadIndex;
     }
 
-    // magic module name for turning on all logging
-    auto it = enabledModules.find("4LLM0DUL3S");
-    if ( it != enabledModules.end() )
+    auto itFormat = binaryFormatIds.find(std::string_view(fmt));
+    if ( itFormat == binaryFormatIds.end() )
     {
-        return true;
+        itFormat = binaryFormatIds.emplace(fmt, static_cast<std::uint32_t>(binaryFormatIds.size())).first;
+        CConsoleBinaryLog::Put(sBinaryBuffer, CConsoleBinaryLog::RecordType::Format);
+        CConsoleBinaryLog::Put(sBinaryBuffer, itFormat->second);
+        CConsoleBinaryLog::PutString(sBinaryBuffer, fmt);
     }
 
-    it = enabledModules.find(logState[std::this_thread::get_id()].sLoggerName);
-    if ( it != enabledModules.end() )
+    const size_t nModule = static_cast<size_t>(state.loggerModule);
+    if ( !binaryModulesWritten[nModule] )
     {
-        return true;
+        binaryModulesWritten[nModule] = true;
+        const char* loggerModuleName = "";
+        for (const auto& it : moduleHandles)
+        {
+            if ( it.second == state.loggerModule )
+            {
+                loggerModuleName = it.first.c_str();
+                break;
+            }
+        }
+        CConsoleBinaryLog::Put(sBinaryBuffer, CConsoleBinaryLog::RecordType::Module);
+        CConsoleBinaryLog::Put(sBinaryBuffer, static_cast<std::uint16_t>(nModule));
+        CConsoleBinaryLog::PutString(sBinaryBuffer, loggerModuleName);
     }
 
-    if ( bErrorsAlwaysOn && (logState[std::this_thread::get_id()].nMode == 1) )
+    const auto timestamp = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch());
+    CConsoleBinaryLog::Put(sBinaryBuffer, CConsoleBinaryLog::RecordType::Log);
+    CConsoleBinaryLog::Put(sBinaryBuffer, static_cast<std::uint64_t>(timestamp.count()));
+    CConsoleBinaryLog::Put(sBinaryBuffer, state.nThreadIndex);
+    CConsoleBinaryLog::Put(sBinaryBuffer, static_cast<std::uint16_t>(nModule));
+    CConsoleBinaryLog::Put(sBinaryBuffer, static_cast<std::uint8_t>(state.nMode));
+    if ( flags & CConsoleBinaryLog::FLAG_NEWLINE )
+        CountLine(state.loggerModule, state.nMode, false);
+    CConsoleBinaryLog::Put(sBinaryBuffer, flags);
+    CConsoleBinaryLog::Put(sBinaryBuffer, static_cast<std::int32_t>(state.nIndentValue));
+    CConsoleBinaryLog::Put(sBinaryBuffer, itFormat->second);
+
+    binaryRecordFmt = fmt;
+    binaryRecordFlags = flags;
+    nBinaryRecordArgs = sBinaryBuffer.size();
+} // BinaryBeginRecord()
+
+
+/**
+    Finishes the record started by BinaryBeginRecord().
+    The binary buffer is written to fBinaryLog only when it is big enough, so most logs don't do any I/O at all,
+    the record is also kept in flightRecorder so it is not lost on a crash before that.
+*/
+void CConsole::CConsoleImpl::BinaryEndRecord()
+{
+    RecordFlightBinary();
+    if ( sBinaryBuffer.size() >= CCONSOLE_BINARY_BUFFER_SIZE )
     {
-        return true;
+        BinaryFlush();
     }
+} // BinaryEndRecord()
+
+
+/**
+    Writes the binary buffer to fBinaryLog.
+*/
+void CConsole::CConsoleImpl::BinaryFlush()
+{
+    if ( sBinaryBuffer.empty() )
+        return;
+
+    fBinaryLog.write(sBinaryBuffer.data(), static_cast<std::streamsize>(sBinaryBuffer.size()));
+    fBinaryLog.flush();
+    sBinaryBuffer.clear();
+} // BinaryFlush()
 
-    return false;
-} // canWeWriteBasedOnFilterSettings()
+
+/**
+    Appends the raw value of every placeholder of the format string to buf, encoded as in the binary log.
+    Format string is only scanned for the placeholders, nothing is formatted.
+    @param buf  Buffer to append to.
+    @param fmt  Format string, may contain formatting chars.
+    @param list The list of arguments passed from the calling higher-level function.
+*/
+void CConsole::CConsoleImpl::PutFormattedArgs(std::string& buf, const char* fmt, va_list list)
+{
+    for (const char* p = fmt; *p; ++p)
+    {
+        if ( *p != '%' )
+            continue;
+
+        if ( !p[1] )
+            break;
+
+        const size_t nLength = CConsoleFormat::placeholderLength(p + 1);
+        switch ( (nLength > 0) ? CConsoleFormat::placeholderType(p + 1) : 0 )
+        {
+        case 's':
+            CConsoleBinaryLog::PutString(buf, va_arg(list, const char*));
+            break;
+        case 'i':
+        case 'd':
+            CConsoleBinaryLog::Put(buf, static_cast<std::int32_t>(va_arg(list, int)));
+            break;
+        case 'u':
+            CConsoleBinaryLog::Put(buf, static_cast<std::uint32_t>(va_arg(list, unsigned int)));
+            break;
+        case 'D':
+            CConsoleBinaryLog::Put(buf, static_cast<std::int64_t>(va_arg(list, long long)));
+            break;
+        case 'U':
+            CConsoleBinaryLog::Put(buf, static_cast<std::uint64_t>(va_arg(list, unsigned long long)));
+            break;
+        case 'b':
+            // bool is promoted to int when passed thru variable-length argument list
+            CConsoleBinaryLog::Put(buf, static_cast<std::uint8_t>(va_arg(list, int) != 0 ? 1 : 0));
+            break;
+        case 'f':
+            CConsoleBinaryLog::Put(buf, va_arg(list, double));
+            break;
+        default:
+            // char after % is printed as it is
+            break;
+        }
+        p += (nLength > 0) ? nLength : 1;
+    }
+} // PutFormattedArgs()
+
+
+/**
+    Appends the raw value of every placeholder of the compile-time parsed format string to buf, encoded as in the
+    binary log.
+    @param buf    Buffer to append to.
+    @param format Format string parsed at compile time.
+    @param args   Arguments of the placeholders in format string, in order.
+*/
+void CConsole::CConsoleImpl::PutCompiledArgs(std::string& buf, const CConsoleFormat::Format& format, const CConsoleFormat::Arg* args)
+{
+    for (size_t i = 0; i < format.nSegments; i++)
+    {
+        if ( format.segments[i].type == 0 )
+            continue;
+
+        switch ( args->type )
+        {
+        case 's':
+            CConsoleBinaryLog::PutString(buf, args->value.s);
+            break;
+        case 'i':
+        case 'd':
+            CConsoleBinaryLog::Put(buf, static_cast<std::int32_t>(args->value.i));
+            break;
+        case 'u':
+            CConsoleBinaryLog::Put(buf, static_cast<std::uint32_t>(args->value.u));
+            break;
+        case 'D':
+            CConsoleBinaryLog::Put(buf, static_cast<std::int64_t>(args->value.ll));
+            break;
+        case 'U':
+            CConsoleBinaryLog::Put(buf, static_cast<std::uint64_t>(args->value.ull));
+            break;
+        case 'b':
+            CConsoleBinaryLog::Put(buf, static_cast<std::uint8_t>(args->value.b ? 1 : 0));
+            break;
+        case 'f':
+            CConsoleBinaryLog::Put(buf, args->value.f);
+            break;
+        default:
+            break;
+        } // switch
+        args++;
+    } // for i
+} // PutCompiledArgs()
+
+
+/**
+    Writes text with its raw arguments to the binary log.
+    Binary log counterpart of WriteFormattedTextEx(): format string is only scanned for the placeholders,
+    nothing is formatted, indentation and colors are applied by the decoder.
+    @param fmt  The text to be printed, may contain formatting chars.
+    @param list The list of arguments passed from the calling higher-level function.
+    @param nl   Whether to print newline after the text or not.
+*/
+void CConsole::CConsoleImpl::BinaryWriteFormattedText(const char* fmt, va_list list, bool nl)
+{
+    BinaryBeginRecord(fmt, static_cast<std::uint8_t>(nl ? CConsoleBinaryLog::FLAG_NEWLINE : 0));
+    PutFormattedArgs(sBinaryBuffer, fmt, list);
+    getLogState().bFirstWriteTextCallAfterWriteTextLn = nl || (strchr(fmt, '\n') != NULL);
+    BinaryEndRecord();
+} // BinaryWriteFormattedText()
+
+
+/**
+    Writes text with compile-time parsed format with its raw arguments to the binary log.
+    Binary log counterpart of WriteCompiledFormat().
+    @param format Format string parsed at compile time.
+    @param args   Arguments of the placeholders in format string, in order.
+    @param nl     Whether to print newline after the text or not.
+*/
+void CConsole::CConsoleImpl::BinaryWriteCompiledFormat(const CConsoleFormat::Format& format, const CConsoleFormat::Arg* args, bool nl)
+{
+    BinaryBeginRecord(format.text, static_cast<std::uint8_t>(nl ? CConsoleBinaryLog::FLAG_NEWLINE : 0));
+    PutCompiledArgs(sBinaryBuffer, format, args);
+    getLogState().bFirstWriteTextCallAfterWriteTextLn = nl || format.bNewLine;
+    BinaryEndRecord();
+} // BinaryWriteCompiledFormat()
+
+
+/**
+    Writes a single value printed by operator<< to the binary log.
+    @param fmt   Format string matching the type of value, e.g. "%d".
+    @param value Value already converted to its type in the binary log, see CConsoleBinaryLog.h.
+*/
+template <class T>
+void CConsole::CConsoleImpl::BinaryWriteValue(const char* fmt, T value)
+{
+    if ( !canWeWriteBasedOnFilterSettings() )
+    {
+        BacklogValue(fmt, value);
+        return;
+    }
+
+    BinaryBeginRecord(fmt, CConsoleBinaryLog::FLAG_VALUE);
+    if constexpr ( std::is_same_v<T, const char*> )
+        CConsoleBinaryLog::PutString(sBinaryBuffer, value);
+    else
+        CConsoleBinaryLog::Put(sBinaryBuffer, value);
+    // same as operator<<: only the indentation written at line start ends the line start
+    LogState& state = getLogState();
+    if ( state.nIndentValue > 0 )
+    {
+        state.bFirstWriteTextCallAfterWriteTextLn = false;
+    }
+    BinaryEndRecord();
+} // BinaryWriteValue()
 
 
 /**
@@ -1737,23 +5566,23 @@ void CConsole::CConsoleImpl::ImmediateWriteString(const char* text)
 {
 #ifdef CCONSOLE_IS_ENABLED
     if ( !canWeWriteBasedOnFilterSettings() )
+    {
+        BacklogValue("%s", text);
         return;
+    }
 
-    oldClrFG = logState[std::this_thread::get_id()].clrFG;
+    LogState& state = getLogState();
+    oldClrFG = state.clrFG;
     //oldClrFGhtml = clrFGhtml;
     if ( text != NULL )
     {
-        SetFGColor(logState[std::this_thread::get_id()].clrStrings);
-        WriteConsoleA(hConsole, text, strlen(text), &wrt, 0);
-        if ( bAllowLogFile )
-            fLog << "<font color=\"#" << logState[std::this_thread::get_id()].clrStringsHtml << "\">" << text << "</font>";
+        SetFGColor(state.clrStrings);
+        AddSpan(LogRecord::SpanType::Value, text, strlen(text), state.clrStringsHtml);
     }
     else
     {
         SetFGColor(oldClrFG);
-        WriteConsoleA(hConsole, "NULL", 4, &wrt, 0);
-        if ( bAllowLogFile )
-            fLog << "<font color=\"#" << logState[std::this_thread::get_id()].clrStringsHtml << "\">NULL</font>";
+        AddSpan(LogRecord::SpanType::Value, "NULL", 4, state.clrStringsHtml);
     }
     SetFGColor(oldClrFG);
 #endif
@@ -1768,13 +5597,15 @@ void CConsole::CConsoleImpl::ImmediateWriteBool(bool l)
 {
 #ifdef CCONSOLE_IS_ENABLED
     if ( !canWeWriteBasedOnFilterSettings() )
+    {
+        BacklogValue("%b", static_cast<std::uint8_t>(l ? 1 : 0));
         return;
+    }
 
-    oldClrFG = logState[std::this_thread::get_id()].clrFG;
-    SetFGColor(logState[std::this_thread::get_id()].clrBools);
-    WriteConsoleA(hConsole, l ? "true" : "false", l ? 4 : 5, &wrt, 0);
-    if ( bAllowLogFile )
-        fLog << "<font color=\"#" << logState[std::this_thread::get_id()].clrBoolsHtml << "\">" << (l ? "true" : "false") << "</font>";
+    LogState& state = getLogState();
+    oldClrFG = state.clrFG;
+    SetFGColor(state.clrBools);
+    AddSpan(LogRecord::SpanType::Value, l ? "true" : "false", l ? 4 : 5, state.clrBoolsHtml);
     SetFGColor(oldClrFG);
 #endif
 } // ImmediateWriteBool()
@@ -1784,18 +5615,20 @@ void CConsole::CConsoleImpl::ImmediateWriteBool(bool l)
     Directly writes formatted signed integer value to the console.
     Used by WriteFormattedTextEx() and operator<<()s.
 */
-void CConsole::CConsoleImpl::ImmediateWriteInt(int n)
+void CConsole::CConsoleImpl::ImmediateWriteInt(long long n)
 {
 #ifdef CCONSOLE_IS_ENABLED
     if ( !canWeWriteBasedOnFilterSettings() )
+    {
+        BacklogValue("%lld", static_cast<std::int64_t>(n));
         return;
+    }
 
-    oldClrFG = logState[std::this_thread::get_id()].clrFG;
-    SetFGColor(logState[std::this_thread::get_id()].clrInts);
-    itoa(n,vmi,10);
-    WriteConsoleA(hConsole, vmi, strlen(vmi), &wrt, 0);
-    if ( bAllowLogFile )
-        fLog << "<font color=\"#" << logState[std::this_thread::get_id()].clrIntsHtml << "\">" << vmi << "</font>";
+    LogState& state = getLogState();
+    oldClrFG = state.clrFG;
+    SetFGColor(state.clrInts);
+    char szNumber[CConsoleNumberFormat::BUFFER_SIZE];
+    AddSpan(LogRecord::SpanType::Value, szNumber, CConsoleNumberFormat::FormatInteger(szNumber, n), state.clrIntsHtml);
     SetFGColor(oldClrFG);
 #endif
 } // ImmediateWriteInt()
@@ -1805,56 +5638,70 @@ void CConsole::CConsoleImpl::ImmediateWriteInt(int n)
     Directly writes formatted unsigned integer value to the console.
     Used by WriteFormattedTextEx() and operator<<()s.
 */
-void CConsole::CConsoleImpl::ImmediateWriteUInt(unsigned int n)
+void CConsole::CConsoleImpl::ImmediateWriteUInt(unsigned long long n)
 {
 #ifdef CCONSOLE_IS_ENABLED
     if ( !canWeWriteBasedOnFilterSettings() )
+    {
+        BacklogValue("%llu", static_cast<std::uint64_t>(n));
         return;
+    }
 
-    oldClrFG = logState[std::this_thread::get_id()].clrFG;
-    SetFGColor(logState[std::this_thread::get_id()].clrInts);
-    sprintf(vmi, "%u", n);
-    WriteConsoleA(hConsole, vmi, strlen(vmi), &wrt, 0);
-    if ( bAllowLogFile )
-        fLog << "<font color=\"#" << logState[std::this_thread::get_id()].clrIntsHtml << "\">" << vmi << "</font>";
+    LogState& state = getLogState();
+    oldClrFG = state.clrFG;
+    SetFGColor(state.clrInts);
+    char szNumber[CConsoleNumberFormat::BUFFER_SIZE];
+    AddSpan(LogRecord::SpanType::Value, szNumber, CConsoleNumberFormat::FormatInteger(szNumber, n), state.clrIntsHtml);
     SetFGColor(oldClrFG);
 #endif
 } // ImmediateWriteUInt()
 
 
 /**
-    Directly writes formatted floating-point value to the console.
-    Used by WriteFormattedTextEx() and operator<<()s.
+    Directly writes formatted floating-point value to the console.
+    Used by WriteFormattedTextEx() and operator<<()s.
+*/
+void CConsole::CConsoleImpl::ImmediateWriteFloat(double f)
+{
+#ifdef CCONSOLE_IS_ENABLED
+    if ( !canWeWriteBasedOnFilterSettings() )
+    {
+        BacklogValue("%f", f);
+        return;
+    }
+
+    LogState& state = getLogState();
+    oldClrFG = state.clrFG;
+    char szNumber[CConsoleNumberFormat::BUFFER_SIZE];
+    const size_t nLength = CConsoleNumberFormat::FormatFloat(szNumber, f);
+
+    SetFGColor(state.clrFloats);
+    AddSpan(LogRecord::SpanType::Value, szNumber, nLength, state.clrFloatsHtml);
+    SetFGColor(oldClrFG);
+#endif
+} // ImmediateWriteFloat()
+
+
+/**
+    Writes the indentation if current thread is at the start of a line.
+    Indentation is a single span with the number of columns, the sinks render it from precomputed runs of spaces.
+    Used by WriteFormattedTextEx(), WriteCompiledFormat() and operator<<()s.
 */
-void CConsole::CConsoleImpl::ImmediateWriteFloat(float f)
+void CConsole::CConsoleImpl::WriteIndentation()
 {
 #ifdef CCONSOLE_IS_ENABLED
-    if ( !canWeWriteBasedOnFilterSettings() )
+    LogState& state = getLogState();
+    if ( !state.bFirstWriteTextCallAfterWriteTextLn || (state.nIndentValue <= 0) )
         return;
 
-    oldClrFG = logState[std::this_thread::get_id()].clrFG;
-    sprintf(vmi, "%0.4f", f);
-    const size_t nOriginalLen = strlen(vmi);
-    size_t newlen = strlen(vmi);
-    for (size_t blah = strlen(vmi); (vmi[blah] == '0') || (vmi[blah] == 0); blah--)
-    {
-        newlen--;
-    }
-    if (newlen < nOriginalLen)
-    {
-        newlen++;
-    }
-    vmi[newlen] = '\0';
+    if ( !canWeWriteBasedOnFilterSettings() )
+        return;
 
-    SetFGColor(logState[std::this_thread::get_id()].clrFloats);
-    WriteConsoleA(hConsole, vmi, newlen, &wrt, 0);
-    if (bAllowLogFile)
-    {
-        fLog << "<font color=\"#" << logState[std::this_thread::get_id()].clrFloatsHtml << "\">" << vmi << "</font>";
-    }
-    SetFGColor(oldClrFG);
+    AddSpan(LogRecord::SpanType::Indent, "", 0);
+    state.line.spans.back().nIndent = state.nIndentValue;
+    state.bFirstWriteTextCallAfterWriteTextLn = false;
 #endif
-} // ImmediateWriteFloat()
+} // WriteIndentation()
 
 
 /**
@@ -1864,33 +5711,32 @@ void CConsole::CConsoleImpl::ImmediateWriteFloat(float f)
 void CConsole::CConsoleImpl::WriteText(const char* text)
 {
 #ifdef CCONSOLE_IS_ENABLED
+    LogState& state = getLogState();
+    const bool bNewLine = ( strcmp("\n\r", text) == 0 );
     if ( !canWeWriteBasedOnFilterSettings() )
-        return;
-
-    oldClrFG = logState[std::this_thread::get_id()].clrFG;
-    logState[std::this_thread::get_id()].clrFG = logState[std::this_thread::get_id()].clrStrings;
-    WriteConsoleA(hConsole, text, strlen(text), &wrt, 0);
-    if ( bAllowLogFile )
     {
-        if ( strcmp("\n\r", text) == 0 )
-            fLog << "<br>" << endl;
-        else
+        if ( bNewLine )
         {
-            string tmpSpacesString;
-            tmpSpacesString = "";
-            unsigned int numspaces = PFL::numCharAppears(' ', text, strlen(text));
-            if ( numspaces == strlen(text) )
-            {
-                for (unsigned int j = 0; j < numspaces; j++)
-                    tmpSpacesString += "&nbsp;";
-                fLog << tmpSpacesString.c_str();
-            }
-            else
-                fLog << text;
+            CountLine(state.loggerModule, state.nMode, true);
+            BacklogBeginPrintout("", true);
         }
+        return;
+    }
+
+    oldClrFG = state.clrFG;
+    state.clrFG = state.clrStrings;
+    const size_t nLength = strlen(text);
+    if ( bNewLine )
+    {
+        AddSpan(LogRecord::SpanType::NewLine, text, nLength);
+        CountLine(state.loggerModule, state.nMode, false);
     }
-    bFirstWriteTextCallAfterWriteTextLn = ( strstr(text, "\n") != NULL );
-    logState[std::this_thread::get_id()].clrFG = oldClrFG;
+    else if ( PFL::numCharAppears(' ', text, nLength) == nLength )
+        AddSpan(LogRecord::SpanType::Spaces, text, nLength);
+    else
+        AddSpan(LogRecord::SpanType::Text, text, nLength);
+    state.bFirstWriteTextCallAfterWriteTextLn = ( strstr(text, "\n") != NULL );
+    state.clrFG = oldClrFG;
 #endif
 } // WriteText()
 
@@ -1907,20 +5753,18 @@ void CConsole::CConsoleImpl::WriteFormattedTextEx(const char* fmt, va_list list)
     const char *p, *r;
     int   e;
     unsigned int ue;
+    long long lle;
+    unsigned long long ulle;
     bool  l;
-    float f;                                                                            
+    double f;                                                                            
 
-    if ( bFirstWriteTextCallAfterWriteTextLn )
-        for (int i = 0; i < logState[std::this_thread::get_id()].nIndentValue; i++)
-            WriteText(" ");
+    LogState& state = getLogState();
+    WriteIndentation();
     
-    oldClrFG = logState[std::this_thread::get_id()].clrFG;
-    if (bAllowLogFile)
+    oldClrFG = state.clrFG;
+    if (state.nMode != 0)
     {
-        if (logState[std::this_thread::get_id()].nMode != 0)
-        {
-            fLog << "<font color=\"#" << logState[std::this_thread::get_id()].clrFGhtml << "\">";
-        }
+        AddSpan(LogRecord::SpanType::ModeBegin, "", 0, state.clrFGhtml);
     }
 
     if ( strstr(fmt, "%") == NULL )
@@ -1934,10 +5778,12 @@ void CConsole::CConsoleImpl::WriteFormattedTextEx(const char* fmt, va_list list)
         {
             if ( *p != '%' )
             {
+                // write the whole literal run until next placeholder at once
+                r = strchr(p, '%');
+                const size_t nRunLength = r ? static_cast<size_t>(r - p) : strlen(p);
                 SetFGColor(oldClrFG);
-                WriteConsoleA(hConsole, p, sizeof(char), &wrt, 0);
-                if ( bAllowLogFile )
-                    fLog << *p;
+                AddSpan(LogRecord::SpanType::Text, p, nRunLength);
+                p += nRunLength - 1;
             }
             else
             {
@@ -1964,35 +5810,50 @@ void CConsole::CConsoleImpl::WriteFormattedTextEx(const char* fmt, va_list list)
                     }
                 case 'b':
                     {
-                        l = va_arg(list, bool);
+                        // bool is promoted to int when passed thru variable-length argument list
+                        l = va_arg(list, int) != 0;
                         ImmediateWriteBool(l);
                         continue;
                     }
                 case 'f':
                     {                                                        
-                        f = (float) va_arg(list, double);
+                        f = va_arg(list, double);
                         ImmediateWriteFloat(f);
                         continue;
                     }
+                case 'l':
+                    {
+                        // %lld, %lli and %llu for 64-bit integers, otherwise handled as default
+                        if ( (p[1] == 'l') && ((p[2] == 'd') || (p[2] == 'i')) )
+                        {
+                            p += 2;
+                            lle = va_arg(list, long long);
+                            ImmediateWriteInt(lle);
+                            continue;
+                        }
+                        if ( (p[1] == 'l') && (p[2] == 'u') )
+                        {
+                            p += 2;
+                            ulle = va_arg(list, unsigned long long);
+                            ImmediateWriteUInt(ulle);
+                            continue;
+                        }
+                    }
+                    [[fallthrough]];
                 default:
                     {
                         SetFGColor(oldClrFG);
-                        WriteConsoleA(hConsole, p, sizeof(char), &wrt, 0);
-                        if ( bAllowLogFile )
-                            fLog << *p;
+                        AddSpan(LogRecord::SpanType::Text, p, sizeof(char));
                     }
                 } // switch
             } // else
         } // for p
     } // else
-    bFirstWriteTextCallAfterWriteTextLn = ( strstr(fmt, "\n") != NULL );
+    state.bFirstWriteTextCallAfterWriteTextLn = ( strstr(fmt, "\n") != NULL );
     SetFGColor(oldClrFG);
-    if (bAllowLogFile)
+    if (state.nMode != 0)
     {
-        if (logState[std::this_thread::get_id()].nMode != 0)
-        {
-            fLog << "</font>";
-        }
+        AddSpan(LogRecord::SpanType::ModeEnd, "", 0);
     }
 #endif
 } // WriteFormattedTextEx()
@@ -2008,24 +5869,171 @@ void CConsole::CConsoleImpl::WriteFormattedTextEx(const char* fmt, va_list list)
 void CConsole::CConsoleImpl::WriteFormattedTextExCaller(const char* fmt, va_list list, bool nl)
 {           
     if ( !canWeWriteBasedOnFilterSettings() )
+    {
+        if ( nl )
+        {
+            const LogState& state = getLogState();
+            CountLine(state.loggerModule, state.nMode, true);
+        }
+        std::string* const pLine = BacklogBeginPrintout(fmt, nl);
+        if ( pLine != NULL )
+            PutFormattedArgs(*pLine, fmt, list);
         return;
+    }
 
-    WriteFormattedTextEx(fmt, list);
+    const bool bLineStart = getLogState().bFirstWriteTextCallAfterWriteTextLn;
+    va_list listRepeat;
+    va_copy(listRepeat, list);
+    if ( bBinaryLog )
+        BinaryWriteFormattedText(fmt, list, nl);
+    else
+        WriteFormattedTextEx(fmt, list);
     if ( nl )
     {
-        WriteText("\n\r");
-        if (logState[std::this_thread::get_id()].nMode == 1)
+        if ( !bBinaryLog )
+            WriteText("\n\r");
+        const LogState& state = getLogState();
+        if (state.nMode == 1)
         {
             nErrorOutCount++;
         }
-        else if (logState[std::this_thread::get_id()].nMode == 2)
+        else if (state.nMode == 2)
         {
             nSuccessOutCount++;
         }
+        std::string* const pArgs = bLineStart ? RememberLine(fmt) : NULL;
+        if ( pArgs != NULL )
+            PutFormattedArgs(*pArgs, fmt, listRepeat);
     }
+    va_end(listRepeat);
+    CommitFinishedLine();
 } // WriteFormattedTextExCaller()
 
 
+/**
+    Writes text with compile-time parsed format to the console.
+    Same as WriteFormattedTextEx() but format string doesn't need to be scanned: literal runs are written as they are,
+    and arguments are already converted to the types expected by the placeholders.
+    @param format Format string parsed at compile time.
+    @param args   Arguments of the placeholders in format string, in order.
+*/
+void CConsole::CConsoleImpl::WriteCompiledFormat(const CConsoleFormat::Format& format, const CConsoleFormat::Arg* args)
+{
+#ifdef CCONSOLE_IS_ENABLED
+    LogState& state = getLogState();
+    WriteIndentation();
+
+    oldClrFG = state.clrFG;
+    if (state.nMode != 0)
+    {
+        AddSpan(LogRecord::SpanType::ModeBegin, "", 0, state.clrFGhtml);
+    }
+
+    if ( format.bLiteralOnly )
+    {
+        SetFGColor(oldClrFG);
+        WriteText(format.text);
+    }
+    else
+    {
+        for (size_t i = 0; i < format.nSegments; i++)
+        {
+            const CConsoleFormat::Segment& segment = format.segments[i];
+            if ( segment.type == 0 )
+            {
+                SetFGColor(oldClrFG);
+                AddSpan(LogRecord::SpanType::Text, format.text + segment.nOffset, segment.nLength);
+                continue;
+            }
+
+            switch ( args->type )
+            {
+            case 's':
+                ImmediateWriteString(args->value.s);
+                break;
+            case 'i':
+            case 'd':
+                ImmediateWriteInt(args->value.i);
+                break;
+            case 'u':
+                ImmediateWriteUInt(args->value.u);
+                break;
+            case 'D':
+                ImmediateWriteInt(args->value.ll);
+                break;
+            case 'U':
+                ImmediateWriteUInt(args->value.ull);
+                break;
+            case 'b':
+                ImmediateWriteBool(args->value.b);
+                break;
+            case 'f':
+                ImmediateWriteFloat(args->value.f);
+                break;
+            default:
+                break;
+            } // switch
+            args++;
+        } // for i
+    } // else
+    state.bFirstWriteTextCallAfterWriteTextLn = format.bNewLine;
+    SetFGColor(oldClrFG);
+    if (state.nMode != 0)
+    {
+        AddSpan(LogRecord::SpanType::ModeEnd, "", 0);
+    }
+#endif
+} // WriteCompiledFormat()
+
+
+/**
+    Writes text with compile-time parsed format to the console.
+    Same as WriteFormattedTextExCaller() but with compile-time parsed format.
+    @param format Format string parsed at compile time.
+    @param args   Arguments of the placeholders in format string, in order.
+    @param nl     Whether to print newline after the text or not. This also activates success/error counting.
+*/
+void CConsole::CConsoleImpl::WriteCompiledFormatCaller(const CConsoleFormat::Format& format, const CConsoleFormat::Arg* args, bool nl)
+{
+    if ( !canWeWriteBasedOnFilterSettings() )
+    {
+        if ( nl )
+        {
+            const LogState& state = getLogState();
+            CountLine(state.loggerModule, state.nMode, true);
+        }
+        std::string* const pLine = BacklogBeginPrintout(format.text, nl);
+        if ( pLine != NULL )
+            PutCompiledArgs(*pLine, format, args);
+        return;
+    }
+
+    const bool bLineStart = getLogState().bFirstWriteTextCallAfterWriteTextLn;
+    if ( bBinaryLog )
+        BinaryWriteCompiledFormat(format, args, nl);
+    else
+        WriteCompiledFormat(format, args);
+    if ( nl )
+    {
+        if ( !bBinaryLog )
+            WriteText("\n\r");
+        const LogState& state = getLogState();
+        if (state.nMode == 1)
+        {
+            nErrorOutCount++;
+        }
+        else if (state.nMode == 2)
+        {
+            nSuccessOutCount++;
+        }
+        std::string* const pArgs = bLineStart ? RememberLine(format.text) : NULL;
+        if ( pArgs != NULL )
+            PutCompiledArgs(*pArgs, format, args);
+    }
+    CommitFinishedLine();
+} // WriteCompiledFormatCaller()
+
+
 /*
    CConsole
    ###########################################################################
@@ -2050,7 +6058,7 @@ void CConsole::CConsoleImpl::WriteFormattedTextExCaller(const char* fmt, va_list
 */
 CConsole& CConsole::getConsoleInstance(const char* loggerModuleName)
 {
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if (consoleInstance.consoleImpl && loggerModuleName)
     {
@@ -2060,6 +6068,45 @@ CConsole& CConsole::getConsoleInstance(const char* loggerModuleName)
 } // getConsoleInstance()
 
 
+/**
+    Gets the singleton instance pre-set for the given logger module.
+    Same as getConsoleInstance(const char*) but faster because there is no need to look up the logger module name.
+
+    @param loggerModule Handle of the logger module, as returned by getModuleHandle().
+    @return The singleton instance pre-set for the specified logger module.
+*/
+CConsole& CConsole::getConsoleInstance(ModuleHandle loggerModule)
+{
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
+
+    if (consoleInstance.consoleImpl)
+    {
+        consoleInstance.consoleImpl->SetLoggerModule(loggerModule);
+    }
+    return consoleInstance;
+} // getConsoleInstance()
+
+
+/**
+    Gets the handle of the given logger module, registers the module name if needed.
+    Modules logging frequently can get their handle once, and pass it to getConsoleInstance() later.
+    Handles are valid for the process lifetime, even before Initialize() or after Deinitialize().
+    Per-process property.
+
+    @param loggerModuleName Name of the logger module.
+    @return Handle of the logger module. ModuleHandle::None for empty or NULL module name.
+*/
+CConsole::ModuleHandle CConsole::getModuleHandle(const char* loggerModuleName)
+{
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
+
+    if (!loggerModuleName)
+        return ModuleHandle::None;
+
+    return CConsoleImpl::registerModule(loggerModuleName);
+} // getModuleHandle()
+
+
 /**
     Gets logging state for the given logger module.
     See more explanation about logger module state at SetLoggingState().
@@ -2070,7 +6117,7 @@ CConsole& CConsole::getConsoleInstance(const char* loggerModuleName)
 */
 bool CConsole::getLoggingState(const char* loggerModuleName) const
 {
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return false;
@@ -2097,7 +6144,7 @@ bool CConsole::getLoggingState(const char* loggerModuleName) const
 */
 void CConsole::SetLoggingState(const char* loggerModuleName, bool state)
 {
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
@@ -2116,7 +6163,7 @@ void CConsole::SetLoggingState(const char* loggerModuleName, bool state)
 */
 void CConsole::SetErrorsAlwaysOn(bool state)
 {
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
@@ -2125,6 +6172,203 @@ void CConsole::SetErrorsAlwaysOn(bool state)
 } // SetErrorsAlwaysOn()
 
 
+/**
+    Gets runtime minimum log level of the level macros, see SetLoggingLevel().
+    Per-process property.
+*/
+int CConsole::getLoggingLevel() const
+{
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
+
+    if ( !(consoleImpl && (consoleImpl->bInited)) )
+        return CCONSOLE_LEVEL_TRACE;
+
+    return consoleImpl->getLoggingLevel();
+} // getLoggingLevel()
+
+
+/**
+    Sets runtime minimum log level of the level macros.
+    Level macros below this level don't evaluate their arguments and don't print anything.
+    Logs below the compile-time minimum level CCONSOLE_MIN_LEVEL are dropped anyway.
+    Default value is CCONSOLE_LEVEL_TRACE.
+    Per-process property.
+
+    @param level One of the CCONSOLE_LEVEL_XXX values, CCONSOLE_LEVEL_OFF turns off all level macros.
+*/
+void CConsole::SetLoggingLevel(int level)
+{
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
+
+    if ( !(consoleImpl && (consoleImpl->bInited)) )
+        return;
+
+    consoleImpl->SetLoggingLevel(level);
+} // SetLoggingLevel()
+
+
+/**
+    Gets the number of suppressed lines kept per thread for dumping them on error, see SetErrorBacklogLines().
+    Per-process property.
+*/
+int CConsole::getErrorBacklogLines() const
+{
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
+
+    if ( !(consoleImpl && (consoleImpl->bInited)) )
+        return 0;
+
+    return consoleImpl->getErrorBacklogLines();
+} // getErrorBacklogLines()
+
+
+/**
+    Sets the number of suppressed lines kept per thread for dumping them on error.
+    Every thread keeps its most recent lines suppressed by the logging state of the logger modules, unformatted.
+    After the thread logs an error, these lines are written to the log, so the log reader sees what led to the error
+    even if normal logging was disabled. They are written at the first non-error printout or indentation increase
+    of the thread after the error, so a series of errors writes them only once. Lines already kept are dropped.
+    Since suppressed printouts must take mainMutex to be kept, disabled logger modules are not that cheap anymore
+    with this turned on.
+    Default value is 0: suppressed lines are not kept.
+    Per-process property.
+
+    @param lines Number of lines kept per thread, 0 turns this off.
+*/
+void CConsole::SetErrorBacklogLines(int lines)
+{
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
+
+    if ( !(consoleImpl && (consoleImpl->bInited)) )
+        return;
+
+    consoleImpl->SetErrorBacklogLines(lines);
+} // SetErrorBacklogLines()
+
+
+/**
+    Gets the max time consecutive identical lines of a thread are collapsed for, see SetRepeatedLinesTimeout().
+    Per-process property.
+*/
+int CConsole::getRepeatedLinesTimeout() const
+{
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
+
+    if ( !(consoleImpl && (consoleImpl->bInited)) )
+        return 0;
+
+    return consoleImpl->getRepeatedLinesTimeout();
+} // getRepeatedLinesTimeout()
+
+
+/**
+    Sets consecutive identical lines of a thread to be collapsed and for how long.
+    Useful against error storms, e.g. the same EOLn() failing in a tight loop, flooding the sinks and making other
+    threads wait for the lock.
+    When a thread writes a line by OLn(), SOLn() or EOLn() that is the same as the last line it wrote, in the same
+    logger module and mode, the line is dropped without taking the lock and only counted. Lines are compared by the
+    pointer of the format string and the raw argument values, so no text is built for the comparison.
+    The number of dropped lines is written as "Last message repeated N times" when the thread prints anything else,
+    or when it writes the same line again after the timeout since the line was last written, or when the thread exits.
+    If the thread stays silent, the number is written by a background thread after the timeout, or by Deinitialize().
+    Dropped lines are also counted as suppressed lines by getStats().
+    Default value is 0: identical lines are not collapsed.
+    Per-process property.
+
+    @param millisecs Max time identical lines are collapsed for, 0 turns this off.
+*/
+void CConsole::SetRepeatedLinesTimeout(int millisecs)
+{
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
+
+    if ( !(consoleImpl && (consoleImpl->bInited)) )
+        return;
+
+    consoleImpl->SetRepeatedLinesTimeout(millisecs);
+} // SetRepeatedLinesTimeout()
+
+
+/**
+    Sets the most recent log records to be written to a crash file on fatal signals or not.
+    The most recent log records are always kept in a preallocated ring in memory, including the ones not yet written
+    to the log file, e.g. because they are still buffered or queued for the writer thread in async mode.
+    With this turned on, a handler is installed for SIGSEGV, SIGABRT, SIGFPE, SIGILL and SIGBUS which writes them
+    to the crash file next to the log file, named like the log file with .crash.txt extension, or to stderr if there
+    is no log file. Then the signal is raised again for the previously installed handler.
+    Default value is false.
+    Per-process property.
+*/
+void CConsole::SetCrashHandler(bool state)
+{
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
+
+    if ( !(consoleImpl && (consoleImpl->bInited)) )
+        return;
+
+    consoleImpl->SetCrashHandler(state);
+} // SetCrashHandler()
+
+
+/**
+    Writes the most recent log records as plain text to the given file descriptor, oldest first.
+    Doesn't lock and doesn't allocate, only write() is used, so this can be invoked from a signal handler
+    installed by the application itself, see SetCrashHandler().
+    @param fd File descriptor to write to, e.g. 2 for stderr.
+*/
+void CConsole::DumpFlightRecorder(int fd)
+{
+#ifdef CCONSOLE_IS_ENABLED
+    CConsoleImpl::flightRecorder.Dump(fd, CConsoleFlightRecorder::RECORDS);
+#endif
+} // DumpFlightRecorder()
+
+
+/**
+    Tells without locking if a log of the given level might be printed by current thread.
+    This is used by the level macros so they can skip evaluating their arguments.
+    False means the log would be surely dropped by the runtime level or by the logging state of current logger module.
+    True might still end up in being filtered out, e.g. when the state of current thread is not known without locking.
+
+    @param level One of the CCONSOLE_LEVEL_XXX values.
+    @param mode  N for logs printed in current mode, S for logs printed in success mode, E for logs printed in error mode.
+*/
+bool CConsole::isLoggingEnabled(int level, FormatSignal mode) const
+{
+#ifdef CCONSOLE_IS_ENABLED
+    if ( level < CConsoleImpl::nLoggingLevel.load(std::memory_order_relaxed) )
+    {
+        CConsoleImpl::CountSuppressedLine(mode);
+        return false;
+    }
+
+    return !CConsoleImpl::isSurelyFilteredOut(mode, true);
+#else
+    return false;
+#endif
+} // isLoggingEnabled()
+
+
+/**
+    Writes how many logs were dropped at a call site of the rate-limited log macros, e.g. CCONSOLE_DEBUG_LIMITED().
+    Invoked by these macros before the next printed log of the same call site, not meant to be invoked directly.
+    Dropped logs are also counted as suppressed lines by getStats().
+
+    @param mode  N for logs printed in current mode, S for logs printed in success mode, E for logs printed in error mode.
+    @param lines Number of dropped logs.
+*/
+void CConsole::WriteDroppedLines(FormatSignal mode, unsigned long long lines)
+{
+#ifdef CCONSOLE_IS_ENABLED
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
+
+    if ( !(consoleImpl && (consoleImpl->bInited)) )
+        return;
+
+    consoleImpl->WriteDroppedLines(mode, lines);
+#endif
+} // WriteDroppedLines()
+
+
 /**
     This creates actually the console window if not created yet.
     An internal reference count is also increased by 1. Reference count explanation is described at Deinitialize().
@@ -2137,11 +6381,16 @@ void CConsole::SetErrorsAlwaysOn(bool state)
     @param createLogFile If true, a HTML-based log file will be created and logs will be written into that in parallel with writing to the console window.
                          Ignored in subsequent calls, when CConsole is already initialized.
     @param sFilenameAux  Optional string to be included in the log file name.
+    @param createConsole If false, CConsole is initialized headless: the console window is not created at all and logs are
+                         written only to the log file and to the sinks opened later by OpenSink().
+                         If true but the console window cannot be created, CConsole still falls back to headless mode when
+                         createLogFile is true, otherwise initialization fails.
+                         Ignored in subsequent calls, when CConsole is already initialized.
 */
-void CConsole::Initialize(const char* title, bool createLogFile, const std::string& sFilenameAux)
+void CConsole::Initialize(const char* title, bool createLogFile, const std::string& sFilenameAux, bool createConsole)
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !consoleImpl )
     {
@@ -2155,11 +6404,6 @@ void CConsole::Initialize(const char* title, bool createLogFile, const std::stri
         }
     }
 
-    // refcount always needs to be incremented as soon as we reach this point;
-    // even 1 thread can increase it multiple times, that is normal, since multiple independent subsystems/libraries
-    // running on same thread invoke Initialize() during their startup
-    consoleImpl->nRefCount++;
-
     const bool bNewThread = consoleImpl->logState.end() == consoleImpl->logState.find(std::this_thread::get_id());
     if (bNewThread)
     {
@@ -2170,34 +6414,36 @@ void CConsole::Initialize(const char* title, bool createLogFile, const std::stri
         consoleImpl->SaveColors();
     }
 
+    // refcount of current thread always needs to be incremented as soon as we reach this point;
+    // even 1 thread can increase it multiple times, that is normal, since multiple independent subsystems/libraries
+    // running on same thread invoke Initialize() during their startup
+    consoleImpl->getLogState().nRefCount++;
+
     if ( !(consoleImpl->bInited) )
     {
         // we come here only once per process, even if Initialize() is invoked multiple consecutive times
         // (of course we might come here later again if sufficient number of calls to Deinitialize() completely shut console down)
 
-        if ( !AllocConsole() )
+        consoleImpl->sLogTitle = title;
+        if ( createConsole )
         {
-            return;
+            consoleImpl->sinks[static_cast<size_t>(CConsole::Sink::Console)] = consoleImpl->CreateSink(CConsole::Sink::Console, NULL);
+            if ( !consoleImpl->sinks[static_cast<size_t>(CConsole::Sink::Console)] && !createLogFile )
+            {
+                // nowhere to log to
+                return;
+            }
         }
 
         // hack to let logs of this initialize function pass thru 
-        const std::string prevLoggerName = consoleImpl->logState[std::this_thread::get_id()].sLoggerName;
-        consoleImpl->logState[std::this_thread::get_id()].sLoggerName = "";
+        const CConsole::ModuleHandle prevLoggerModule = consoleImpl->getLogState().loggerModule;
+        consoleImpl->SetLoggerModule(CConsole::ModuleHandle::None);
         
         consoleImpl->bInited = true;
         consoleImpl->nErrorOutCount = 0;
         consoleImpl->nSuccessOutCount = 0;
-        SetConsoleTitleA( title );
-        if ( NULL != (consoleImpl->hConsole = GetStdHandle( STD_OUTPUT_HANDLE )) )
-        {
-            COORD crd;
-            crd.X = 80;
-            crd.Y = 10000;
-            SetConsoleScreenBufferSize(consoleImpl->hConsole, crd);
-        }
         consoleImpl->OLn("CConsole::%s() %s", __func__, CCONSOLE_VERSION);
 
-        consoleImpl->bAllowLogFile = createLogFile;
         if ( createLogFile )
         {
             const auto time = std::time(nullptr);
@@ -2214,6 +6460,7 @@ void CConsole::Initialize(const char* title, bool createLogFile, const std::stri
                 }
             }
 
+#ifdef _WIN32
             const WORD wWsaVersionRequested = MAKEWORD(2, 2);
             WSADATA wsaData;
             const int nWsaStartupRet = WSAStartup(wWsaVersionRequested, &wsaData);
@@ -2230,10 +6477,18 @@ void CConsole::Initialize(const char* title, bool createLogFile, const std::stri
             {
                 consoleImpl->EOLn("ERROR: Couldn't initialize WSA, error code: %d", nWsaStartupRet);
             }
+#else
+            const int nGetHostNameRet = gethostname(fLogFilename + nStrLen, sizeof(fLogFilename) - nStrLen);
+            if (nGetHostNameRet != 0)
+            {
+                consoleImpl->EOLn("ERROR: Couldn't get host name, error code: %d", errno);
+            }
+            fLogFilename[sizeof(fLogFilename) - 1] = '\0';
+            nStrLen = strlen(fLogFilename);
+#endif
             
             if ( 0 == std::strftime(fLogFilename + nStrLen, sizeof(fLogFilename)- nStrLen, "_%Y-%m-%d_%H-%M-%S.html", std::gmtime(&time)) )
             {
-                consoleImpl->bAllowLogFile = false;
                 consoleImpl->EOLn("ERROR: Couldn't generate file name! Initial name was: \"%s\"", fLogFilename);
             }
             else
@@ -2241,38 +6496,46 @@ void CConsole::Initialize(const char* title, bool createLogFile, const std::stri
                 // before opening new file, let's get rid of some older log files
                 consoleImpl->DeleteOldLogFiles(3);
 
-                consoleImpl->fLog.open(fLogFilename);
-                if ( consoleImpl->fLog.fail() )
+                consoleImpl->sinks[static_cast<size_t>(CConsole::Sink::HtmlFile)] = consoleImpl->CreateSink(CConsole::Sink::HtmlFile, fLogFilename);
+                if ( !consoleImpl->sinks[static_cast<size_t>(CConsole::Sink::HtmlFile)] )
                 {
-                    consoleImpl->bAllowLogFile = false;
                     consoleImpl->EOLn("ERROR: Couldn't open output html for writing!");
                 }
                 else
                 {
-                    consoleImpl->fLog << "<html>" << endl;
-                    consoleImpl->fLog << "<head>" << endl;
-                    consoleImpl->fLog << "<title>" << title << "</title>" << endl;
-                    consoleImpl->fLog << "</head>" << endl;
-                    consoleImpl->fLog << "<body bgcolor=\"#1D1D1D\" text=\"#DDDDDD\">" << endl;
-                    consoleImpl->fLog << "<font face=\"Courier\" size=\"2\">" << endl;
+                    consoleImpl->sLogFilename = fLogFilename;
                 }
             }
         }
 
-        consoleImpl->SOLn("CConsole::%s() > CConsole has been initialized with title: %s, refcount: %d!", __func__, title, consoleImpl->nRefCount);
+        if ( !consoleImpl->sinks[static_cast<size_t>(CConsole::Sink::Console)] )
+        {
+            if ( createConsole )
+            {
+                consoleImpl->EOLn("ERROR: Couldn't create console window, continuing headless!");
+            }
+            else
+            {
+                consoleImpl->OLn("CConsole::%s() > Headless mode, no console window.", __func__);
+            }
+        }
+
+        consoleImpl->SOLn("CConsole::%s() > CConsole has been initialized with title: %s, refcount: %d!", __func__, title, consoleImpl->getRefCount());
 
         // now we get rid of our hack
-        consoleImpl->logState[std::this_thread::get_id()].sLoggerName = prevLoggerName;
+        consoleImpl->SetLoggerModule(prevLoggerModule);
+        CConsoleImpl::nActiveInstanceId = consoleImpl->nInstanceId;
+        consoleImpl->StartTickThread();
     }
     else
     {
         if (bNewThread)
         {
-            consoleImpl->SOLn("CConsole::%s() > Already initialized, but this is a new thread, and new refcount is: %d!", __func__, consoleImpl->nRefCount);
+            consoleImpl->SOLn("CConsole::%s() > Already initialized, but this is a new thread, and new refcount is: %d!", __func__, consoleImpl->getRefCount());
         }
         else
         {
-            consoleImpl->SOLn("CConsole::%s() > Already initialized, new refcount is: %d!", __func__, consoleImpl->nRefCount);
+            consoleImpl->SOLn("CConsole::%s() > Already initialized, new refcount is: %d!", __func__, consoleImpl->getRefCount());
         }
     }
 #endif
@@ -2291,16 +6554,17 @@ void CConsole::Initialize(const char* title, bool createLogFile, const std::stri
 void CConsole::Deinitialize()
 {
 #ifdef CCONSOLE_IS_ENABLED   
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !consoleImpl )
         return;
 
-    consoleImpl->nRefCount--;
-    consoleImpl->OLn("CConsole::%s() new refcount: %d", __func__, consoleImpl->nRefCount);
-    if ( consoleImpl->nRefCount == 0 )
+    consoleImpl->ReleaseRef();
+    const int nRefCount = consoleImpl->getRefCount();
+    consoleImpl->OLn("CConsole::%s() new refcount: %d", __func__, nRefCount);
+    if ( nRefCount == 0 )
     {
-        this->~CConsole();
+        Shutdown();
     }
 #endif
 } // Deinitialize()
@@ -2318,7 +6582,7 @@ void CConsole::Deinitialize()
 */
 bool CConsole::isInitialized() const
 {
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
     return consoleImpl && (consoleImpl->bInited);
 }
 
@@ -2329,7 +6593,7 @@ bool CConsole::isInitialized() const
 */
 int CConsole::getIndent() const
 {
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return 0;
@@ -2345,7 +6609,7 @@ int CConsole::getIndent() const
 void CConsole::SetIndent(int value)
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
@@ -2362,7 +6626,7 @@ void CConsole::SetIndent(int value)
 void CConsole::Indent()
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
@@ -2379,7 +6643,7 @@ void CConsole::Indent()
 void CConsole::IndentBy(int value)
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
@@ -2396,7 +6660,7 @@ void CConsole::IndentBy(int value)
 void CConsole::Outdent()
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
@@ -2413,7 +6677,7 @@ void CConsole::Outdent()
 void CConsole::OutdentBy(int value)
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
@@ -2430,7 +6694,7 @@ void CConsole::OutdentBy(int value)
 void CConsole::LoadColors()
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
@@ -2447,7 +6711,7 @@ void CConsole::LoadColors()
 void CConsole::SaveColors()
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
@@ -2464,7 +6728,7 @@ void CConsole::SaveColors()
 void CConsole::RestoreDefaultColors()
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
@@ -2480,7 +6744,7 @@ void CConsole::RestoreDefaultColors()
 */
 WORD CConsole::getFGColor() const
 {
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return 0;
@@ -2495,7 +6759,7 @@ WORD CConsole::getFGColor() const
 */
 const char* CConsole::getFGColorHtml() const
 {
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return "#DDBEEF";
@@ -2511,7 +6775,7 @@ const char* CConsole::getFGColorHtml() const
 void CConsole::SetFGColor(WORD clr, const char* html)
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
@@ -2527,7 +6791,7 @@ void CConsole::SetFGColor(WORD clr, const char* html)
 */
 WORD CConsole::getBGColor() const
 {
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return 0;
@@ -2543,7 +6807,7 @@ WORD CConsole::getBGColor() const
 void CConsole::SetBGColor(WORD clr)
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
@@ -2559,7 +6823,7 @@ void CConsole::SetBGColor(WORD clr)
 */
 WORD CConsole::getIntsColor() const
 {
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return 0;
@@ -2574,7 +6838,7 @@ WORD CConsole::getIntsColor() const
 */
 const char* CConsole::getIntsColorHtml() const
 {
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return "#DDBEEF";
@@ -2590,7 +6854,7 @@ const char* CConsole::getIntsColorHtml() const
 void CConsole::SetIntsColor(WORD clr, const char* html)
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
@@ -2606,7 +6870,7 @@ void CConsole::SetIntsColor(WORD clr, const char* html)
 */
 WORD CConsole::getStringsColor() const
 {
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return 0;
@@ -2621,7 +6885,7 @@ WORD CConsole::getStringsColor() const
 */
 const char* CConsole::getStringsColorHtml() const
 {
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return "#DDBEEF";
@@ -2637,7 +6901,7 @@ const char* CConsole::getStringsColorHtml() const
 void CConsole::SetStringsColor(WORD clr, const char* html)
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
@@ -2653,7 +6917,7 @@ void CConsole::SetStringsColor(WORD clr, const char* html)
 */
 WORD CConsole::getFloatsColor() const
 {
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return 0;
@@ -2668,7 +6932,7 @@ WORD CConsole::getFloatsColor() const
 */
 const char* CConsole::getFloatsColorHtml() const
 {
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return "#DDBEEF";
@@ -2684,7 +6948,7 @@ const char* CConsole::getFloatsColorHtml() const
 void CConsole::SetFloatsColor(WORD clr, const char* html)
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
@@ -2700,7 +6964,7 @@ void CConsole::SetFloatsColor(WORD clr, const char* html)
 */
 WORD CConsole::getBoolsColor() const
 {
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return 0;
@@ -2715,7 +6979,7 @@ WORD CConsole::getBoolsColor() const
 */
 const char* CConsole::getBoolsColorHtml() const
 {
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return "#DDBEEF";
@@ -2731,7 +6995,7 @@ const char* CConsole::getBoolsColorHtml() const
 void CConsole::SetBoolsColor(WORD clr, const char* html)
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
@@ -2747,7 +7011,10 @@ void CConsole::SetBoolsColor(WORD clr, const char* html)
 void CConsole::O(const char* text, ...)
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    if ( CConsoleImpl::isSurelyFilteredOut(CConsole::N, false) )
+        return;
+
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
@@ -2760,18 +7027,27 @@ void CConsole::O(const char* text, ...)
 } // O()
 
 
-/**
-    Prints text to console and adds a new line.
-*/
-void CConsole::OLn(const char* text, ...)
-{
-#ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+/**
+    Prints text to console and adds a new line.
+*/
+void CConsole::OLn(const char* text, ...)
+{
+#ifdef CCONSOLE_IS_ENABLED
+    if ( CConsoleImpl::isSurelyFilteredOut(CConsole::N, true) )
+        return;
+
+    va_list list;
+    va_start(list, text);
+    const bool bRepeated = CConsoleImpl::isRepeatedLine(CConsole::N, text, list);
+    va_end(list);
+    if ( bRepeated )
+        return;
+
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
 
-    va_list list;
     va_start(list, text);
     consoleImpl->OLn(text, list);
     va_end(list);
@@ -2785,7 +7061,7 @@ void CConsole::OLn(const char* text, ...)
 void CConsole::OI()
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
@@ -2801,7 +7077,7 @@ void CConsole::OI()
 void CConsole::OIO(const char* text, ...)
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
@@ -2820,7 +7096,7 @@ void CConsole::OIO(const char* text, ...)
 void CConsole::OIOLn(const char* text, ...)
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
@@ -2839,7 +7115,7 @@ void CConsole::OIOLn(const char* text, ...)
 void CConsole::OLnOI(const char* text, ...)
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
@@ -2858,7 +7134,7 @@ void CConsole::OLnOI(const char* text, ...)
 void CConsole::OIb(int value)
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
@@ -2874,7 +7150,7 @@ void CConsole::OIb(int value)
 void CConsole::OO()
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
@@ -2890,7 +7166,7 @@ void CConsole::OO()
 void CConsole::OOO(const char* text, ...)
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
@@ -2909,7 +7185,7 @@ void CConsole::OOO(const char* text, ...)
 void CConsole::OOOLn(const char* text, ...)
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
@@ -2928,7 +7204,7 @@ void CConsole::OOOLn(const char* text, ...)
 void CConsole::OLnOO(const char* text, ...)
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
@@ -2947,7 +7223,7 @@ void CConsole::OLnOO(const char* text, ...)
 void CConsole::OOb(int value)
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
@@ -2963,7 +7239,7 @@ void CConsole::OOb(int value)
 void CConsole::OIOLnOO(const char* text, ...)
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
@@ -2983,7 +7259,7 @@ void CConsole::OIOLnOO(const char* text, ...)
 void CConsole::L(int n)
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
@@ -3000,7 +7276,7 @@ void CConsole::L(int n)
 void CConsole::NOn()
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
@@ -3017,7 +7293,7 @@ void CConsole::NOn()
 void CConsole::EOn()
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
@@ -3034,7 +7310,7 @@ void CConsole::EOn()
 void CConsole::EOff()
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
@@ -3051,7 +7327,7 @@ void CConsole::EOff()
 void CConsole::SOn()
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
@@ -3068,7 +7344,7 @@ void CConsole::SOn()
 void CConsole::SOff()
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
@@ -3084,513 +7360,964 @@ void CConsole::SOff()
 void CConsole::SO(const char* text, ...)
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    if ( CConsoleImpl::isSurelyFilteredOut(CConsole::S, false) )
+        return;
+
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
+
+    if ( !(consoleImpl && (consoleImpl->bInited)) )
+        return;
+
+    va_list list;
+    va_start(list, text);
+    consoleImpl->SO(text, list);
+    va_end(list);
+#endif
+} // SO()
+
+
+/**
+    SOn() + OLn(text) + SOff().
+*/
+void CConsole::SOLn(const char* text, ...)
+{
+#ifdef CCONSOLE_IS_ENABLED
+    if ( CConsoleImpl::isSurelyFilteredOut(CConsole::S, true) )
+        return;
+
+    va_list list;
+    va_start(list, text);
+    const bool bRepeated = CConsoleImpl::isRepeatedLine(CConsole::S, text, list);
+    va_end(list);
+    if ( bRepeated )
+        return;
+
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
+
+    if ( !(consoleImpl && (consoleImpl->bInited)) )
+        return;
+
+    va_start(list, text);
+    consoleImpl->SOLn(text, list);
+    va_end(list);
+#endif
+} // SOln()
+
+
+/**
+    EOn() + O(text) + EOff().
+*/
+void CConsole::EO(const char* text, ...)
+{
+#ifdef CCONSOLE_IS_ENABLED
+    if ( CConsoleImpl::isSurelyFilteredOut(CConsole::E, false) )
+        return;
+
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
+
+    if ( !(consoleImpl && (consoleImpl->bInited)) )
+        return;
+
+    va_list list;
+    va_start(list, text);
+    consoleImpl->EO(text, list);
+    va_end(list);
+#endif
+} // EO()
+
+
+/**
+    EOn() + OLn(text) + EOff().
+*/
+void CConsole::EOLn(const char* text, ...)
+{
+#ifdef CCONSOLE_IS_ENABLED
+    if ( CConsoleImpl::isSurelyFilteredOut(CConsole::E, true) )
+        return;
+
+    va_list list;
+    va_start(list, text);
+    const bool bRepeated = CConsoleImpl::isRepeatedLine(CConsole::E, text, list);
+    va_end(list);
+    if ( bRepeated )
+        return;
+
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
+
+    if ( !(consoleImpl && (consoleImpl->bInited)) )
+        return;
+
+    va_start(list, text);
+    consoleImpl->EOLn(text, list);
+    va_end(list);
+#endif
+} // EOln()
+
+
+/**
+    OI() + SO(text).
+*/
+void CConsole::OISO(const char* text, ...)
+{
+#ifdef CCONSOLE_IS_ENABLED
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
+
+    if ( !(consoleImpl && (consoleImpl->bInited)) )
+        return;
+
+    va_list list;
+    va_start(list, text);
+    consoleImpl->OISO(text, list);
+    va_end(list);
+#endif
+} // OISO()
+
+
+/**
+    OI() + SOLn(text).
+*/
+void CConsole::OISOLn(const char* text, ...)
+{
+#ifdef CCONSOLE_IS_ENABLED
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
+
+    if ( !(consoleImpl && (consoleImpl->bInited)) )
+        return;
+
+    va_list list;
+    va_start(list, text);
+    consoleImpl->OISOLn(text, list);
+    va_end(list);
+#endif
+} // OISOLn()
+
+
+/**
+    OO() + SO(text).
+*/
+void CConsole::OOSO(const char* text, ...)
+{
+#ifdef CCONSOLE_IS_ENABLED
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
+
+    if ( !(consoleImpl && (consoleImpl->bInited)) )
+        return;
+
+    va_list list;
+    va_start(list, text);
+    consoleImpl->OOSO(text, list);
+    va_end(list);
+#endif
+} // OOSO()
+
+
+/**
+    OO() + SOLn(text).
+*/
+void CConsole::OOSOLn(const char* text, ...)
+{
+#ifdef CCONSOLE_IS_ENABLED
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
+
+    if ( !(consoleImpl && (consoleImpl->bInited)) )
+        return;
+
+    va_list list;
+    va_start(list, text);
+    consoleImpl->OOSOLn(text, list);
+    va_end(list);
+#endif
+} // OOSOLn()
+
+
+/**
+    OI() + EO(text).
+*/
+void CConsole::OIEO(const char* text, ...)
+{
+#ifdef CCONSOLE_IS_ENABLED
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
+
+    if ( !(consoleImpl && (consoleImpl->bInited)) )
+        return;
+
+    va_list list;
+    va_start(list, text);
+    consoleImpl->OIEO(text, list);
+    va_end(list);
+#endif
+} // OIEO()
+
+
+/**
+    OI() + EOLn(text).
+*/
+void CConsole::OIEOLn(const char* text, ...)
+{
+#ifdef CCONSOLE_IS_ENABLED
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
+
+    if ( !(consoleImpl && (consoleImpl->bInited)) )
+        return;
+
+    va_list list;
+    va_start(list, text);
+    consoleImpl->OIEOLn(text, list);
+    va_end(list);
+#endif
+} // OIEOLn()
+
+
+/**
+    OO() + EO(text).
+*/
+void CConsole::OOEO(const char* text, ...)
+{
+#ifdef CCONSOLE_IS_ENABLED
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
+
+    if ( !(consoleImpl && (consoleImpl->bInited)) )
+        return;
+
+    va_list list;
+    va_start(list, text);
+    consoleImpl->OOEO(text, list);
+    va_end(list);
+#endif
+} // OOEO()
+
+
+/**
+    OO() + EOLn(text).
+*/
+void CConsole::OOEOLn(const char* text, ...)
+{
+#ifdef CCONSOLE_IS_ENABLED
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
+
+    if ( !(consoleImpl && (consoleImpl->bInited)) )
+        return;
+
+    va_list list;
+    va_start(list, text);
+    consoleImpl->OOEOLn(text, list);
+    va_end(list);
+#endif
+} // OOEOLn()
+
+
+/**
+    SO(text) + OI().
+*/
+void CConsole::SOOI(const char* text, ...)
+{
+#ifdef CCONSOLE_IS_ENABLED
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
+
+    if ( !(consoleImpl && (consoleImpl->bInited)) )
+        return;
+
+    va_list list;
+    va_start(list, text);
+    consoleImpl->SOOI(text, list);
+    va_end(list);
+#endif
+} // SOOI()
+
+
+/**
+    SOLn(text) + OI().
+*/
+void CConsole::SOLnOI(const char* text, ...)
+{
+#ifdef CCONSOLE_IS_ENABLED
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
 
     va_list list;
     va_start(list, text);
-    consoleImpl->SO(text, list);
+    consoleImpl->SOLnOI(text, list);
     va_end(list);
 #endif
-} // SO()
+} // SOLnOI()
 
 
 /**
-    SOn() + OLn(text) + SOff().
+    SO(text) + OO().
 */
-void CConsole::SOLn(const char* text, ...)
+void CConsole::SOOO(const char* text, ...)
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
 
     va_list list;
     va_start(list, text);
-    consoleImpl->SOLn(text, list);
+    consoleImpl->SOOO(text, list);
     va_end(list);
 #endif
-} // SOln()
+} // SOOO()
 
 
 /**
-    EOn() + O(text) + EOff().
+    SOLn(text) + OO().
 */
-void CConsole::EO(const char* text, ...)
+void CConsole::SOLnOO(const char* text, ...)
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
 
     va_list list;
     va_start(list, text);
-    consoleImpl->EO(text, list);
+    consoleImpl->SOLnOO(text, list);
     va_end(list);
 #endif
-} // EO()
+} // SOLnOO()
 
 
 /**
-    EOn() + OLn(text) + EOff().
+    EO(text) + OI().
 */
-void CConsole::EOLn(const char* text, ...)
+void CConsole::EOOI(const char* text, ...)
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
 
     va_list list;
     va_start(list, text);
-    consoleImpl->EOLn(text, list);
+    consoleImpl->EOOI(text, list);
     va_end(list);
 #endif
-} // EOln()
+} // EOOI()
 
 
 /**
-    OI() + SO(text).
+    EOLn(text) + OI().
 */
-void CConsole::OISO(const char* text, ...)
+void CConsole::EOLnOI(const char* text, ...)
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
 
     va_list list;
     va_start(list, text);
-    consoleImpl->OISO(text, list);
+    consoleImpl->EOLnOI(text, list);
     va_end(list);
 #endif
-} // OISO()
+} // EOLnOI()
 
 
 /**
-    OI() + SOLn(text).
+    EO(text) + OO().
 */
-void CConsole::OISOLn(const char* text, ...)
+void CConsole::EOOO(const char* text, ...)
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
 
     va_list list;
     va_start(list, text);
-    consoleImpl->OISOLn(text, list);
+    consoleImpl->EOOO(text, list);
     va_end(list);
 #endif
-} // OISOLn()
+} // EOOO()
 
 
 /**
-    OO() + SO(text).
+    EOLn(text) + OO().
 */
-void CConsole::OOSO(const char* text, ...)
+void CConsole::EOLnOO(const char* text, ...)
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
 
     va_list list;
     va_start(list, text);
-    consoleImpl->OOSO(text, list);
+    consoleImpl->EOLnOO(text, list);
     va_end(list);
 #endif
-} // OOSO()
+} // EOLnOO()
 
 
 /**
-    OO() + SOLn(text).
+    OI() + SO(text) + OO().
 */
-void CConsole::OOSOLn(const char* text, ...)
+void CConsole::OISOOO(const char* text, ...)
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
 
     va_list list;
     va_start(list, text);
-    consoleImpl->OOSOLn(text, list);
+    consoleImpl->OISOOO(text, list);
     va_end(list);
 #endif
-} // OOSOLn()
+} // OISOOO
 
 
 /**
-    OI() + EO(text).
+    OI() + SOLn(text) + OO().
 */
-void CConsole::OIEO(const char* text, ...)
+void CConsole::OISOLnOO(const char* text, ...)
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
 
     va_list list;
     va_start(list, text);
-    consoleImpl->OIEO(text, list);
+    consoleImpl->OISOLnOO(text, list);
     va_end(list);
 #endif
-} // OIEO()
+} // OISOLnOO
 
 
 /**
-    OI() + EOLn(text).
+    OI() + EO(text) + OO().
 */
-void CConsole::OIEOLn(const char* text, ...)
+void CConsole::OIEOOO(const char* text, ...)
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
 
     va_list list;
     va_start(list, text);
-    consoleImpl->OIEOLn(text, list);
+    consoleImpl->OIEOOO(text, list);
     va_end(list);
 #endif
-} // OIEOLn()
+} // OIEOOO
 
 
 /**
-    OO() + EO(text).
+    OI() + EOLn(text) + OO().
 */
-void CConsole::OOEO(const char* text, ...)
+void CConsole::OIEOLnOO(const char* text, ...)
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
 
     va_list list;
     va_start(list, text);
-    consoleImpl->OOEO(text, list);
+    consoleImpl->OIEOLnOO(text, list);
     va_end(list);
 #endif
-} // OOEO()
+} // OIEOLnOO
 
 
 /**
-    OO() + EOLn(text).
+    Common part of the template overloads of O(), OLn(), SO(), SOLn(), EO() and EOLn().
+    Only this part is compiled into the library, the template overloads in the header just check and convert the arguments.
 */
-void CConsole::OOEOLn(const char* text, ...)
+void CConsole::WriteFormat(
+    const CConsoleFormat::Format& format,
+    const CConsoleFormat::Arg* args,
+    FormatSignal mode,
+    bool nl)
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    if ( CConsoleImpl::isSurelyFilteredOut(mode, nl) )
+        return;
+
+    if ( nl && CConsoleImpl::isRepeatedLine(mode, format, args) )
+        return;
+
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
 
-    va_list list;
-    va_start(list, text);
-    consoleImpl->OOEOLn(text, list);
-    va_end(list);
+    consoleImpl->WriteFormat(format, args, mode, nl);
 #endif
-} // OOEOLn()
+} // WriteFormat()
 
 
 /**
-    SO(text) + OI().
+    Gets total count of printouts-with-newline during error-mode.
+    Per-process property.
 */
-void CConsole::SOOI(const char* text, ...)
+int CConsole::getErrorOutsCount() const
 {
-#ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
-        return;
+        return 0;
 
-    va_list list;
-    va_start(list, text);
-    consoleImpl->SOOI(text, list);
-    va_end(list);
-#endif
-} // SOOI()
+    return consoleImpl->getErrorOutsCount();
+} // getErrorOutsCount()
 
 
 /**
-    SOLn(text) + OI().
+    Gets total count of printouts-with-newline during success-mode.
+    Per-process property.
 */
-void CConsole::SOLnOI(const char* text, ...)
+int CConsole::getSuccessOutsCount() const    
 {
-#ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
+        return 0;
+
+    return consoleImpl->getSuccessOutsCount();
+} // getSuccessOutsCount()
+
+
+/**
+    Resets total count of printouts-with-newline during error-mode.
+    Per-process property.
+*/
+void CConsole::ResetErrorOutsCount()
+{
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
+
+    if (!(consoleImpl && (consoleImpl->bInited)))
         return;
 
-    va_list list;
-    va_start(list, text);
-    consoleImpl->SOLnOI(text, list);
-    va_end(list);
-#endif
-} // SOLnOI()
+    consoleImpl->ResetErrorOutsCount();
+}
+
+/**
+    Resets total count of printouts-with-newline during success-mode.
+    Per-process property.
+*/
+void CConsole::ResetSuccessOutsCount()
+{
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
+
+    if (!(consoleImpl && (consoleImpl->bInited)))
+        return;
+
+    consoleImpl->ResetSuccessOutsCount();
+}
 
 
 /**
-    SO(text) + OO().
+    Tells if logs are written by a background writer thread.
+    Per-process property.
 */
-void CConsole::SOOO(const char* text, ...)
+bool CConsole::isAsyncLogging() const
+{
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
+
+    if (!(consoleImpl && (consoleImpl->bInited)))
+        return false;
+
+    return consoleImpl->isAsyncLogging();
+}
+
+
+/**
+    Sets logs to be written by a background writer thread or by the logging threads.
+    Default value is false: the logging thread writes its logs to console and log file immediately, so
+    threads logging in parallel are waiting for each other's console and file I/O.
+    When set to true, logging threads only format their logs into records and put them into a bounded
+    lock-free queue, and a dedicated writer thread writes the records to console and log file.
+    Order of logs is kept. If the queue is full, logging threads wait until the writer thread makes space.
+    When set back to false, all queued logs are written before this function returns.
+    Deinitialize() also writes all queued logs before releasing console and log file.
+    Per-process property.
+
+    @param state True to let the background writer thread write the logs, false to write them immediately.
+*/
+void CConsole::SetAsyncLogging(bool state)
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
-    if ( !(consoleImpl && (consoleImpl->bInited)) )
+    if (!(consoleImpl && (consoleImpl->bInited)))
         return;
 
-    va_list list;
-    va_start(list, text);
-    consoleImpl->SOOO(text, list);
-    va_end(list);
+    consoleImpl->SetAsyncLogging(state);
 #endif
-} // SOOO()
+}
 
 
 /**
-    SOLn(text) + OO().
+    Tells if logs are written unformatted to a binary log file.
+    Per-process property.
 */
-void CConsole::SOLnOO(const char* text, ...)
+bool CConsole::isBinaryLogging() const
+{
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
+
+    if ( !(consoleImpl && (consoleImpl->bInited)) )
+        return false;
+
+    return consoleImpl->isBinaryLogging();
+} // isBinaryLogging()
+
+
+/**
+    Sets logs to be written unformatted to a binary log file instead of console and html log file.
+    Default value is false.
+    When set to true, logs are not formatted at all: only the format string id and the raw argument values are
+    written into a binary log file, together with timestamp, thread index, logger module, mode and indentation.
+    The binary log file has the same name as the html log file but with .cclog extension, so log file must be
+    enabled in Initialize(). If the file already exists, a new session is appended to it.
+    The CConsoleDecoder tool renders the binary log file into the same html layout or into plain text afterwards.
+    Custom colors are not saved, the decoder uses the default colors of the modes.
+    Logs appear neither in the console window nor in the html log file while binary logging is on.
+    Records are collected in memory and written to file in bigger chunks, so the last logs might be lost if the
+    process crashes. All logs are written when set back to false and by Deinitialize().
+    Per-process property.
+
+    @param state True to write logs to the binary log file, false to write them formatted to console and html log file.
+*/
+void CConsole::SetBinaryLogging(bool state)
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
 
-    va_list list;
-    va_start(list, text);
-    consoleImpl->SOLnOO(text, list);
-    va_end(list);
+    consoleImpl->SetBinaryLogging(state);
 #endif
-} // SOLnOO()
+} // SetBinaryLogging()
 
 
 /**
-    EO(text) + OI().
+    Gets when the log files are flushed.
+    Per-process property.
 */
-void CConsole::EOOI(const char* text, ...)
+CConsole::FlushPolicy CConsole::getFlushPolicy() const
+{
+#ifdef CCONSOLE_IS_ENABLED
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
+
+    if ( !(consoleImpl && (consoleImpl->bInited)) )
+        return CConsole::FlushPolicy::EveryLine;
+
+    return consoleImpl->getFlushPolicy();
+#else
+    return CConsole::FlushPolicy::EveryLine;
+#endif
+} // getFlushPolicy()
+
+
+/**
+    Sets when the log files are flushed.
+    The file sinks collect the rendered log lines in a big buffer in memory, and write the buffer to the file
+    only when it is full or when the sinks are flushed. Flushing after every line means a write to the file for
+    every line, while with the other policies a single write contains many lines.
+    Default value is FlushPolicy::EveryLine, so no log is lost if the process crashes.
+    With the other policies the logs not yet flushed might be lost if the process crashes, Flush() can be used
+    to make sure logs written so far are in the files, e.g. before doing something risky.
+    All logs are written by Deinitialize().
+    In async mode with FlushPolicy::EveryLine, lines logged in a burst are flushed together when the writer
+    thread has nothing more to write.
+    With FlushPolicy::Interval, the last lines are flushed when the interval elapses even if no more lines are
+    written: by the writer thread in async mode, and by a background thread checking it every 50 ms in sync mode.
+    Console is not affected, logs always appear there immediately.
+    Per-process property.
+
+    @param policy            When the log files are flushed.
+    @param intervalMillisecs Time between flushes with FlushPolicy::Interval, ignored by the other policies.
+*/
+void CConsole::SetFlushPolicy(CConsole::FlushPolicy policy, int intervalMillisecs)
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
 
-    va_list list;
-    va_start(list, text);
-    consoleImpl->EOOI(text, list);
-    va_end(list);
+    consoleImpl->SetFlushPolicy(policy, intervalMillisecs);
 #endif
-} // EOOI()
+} // SetFlushPolicy()
 
 
 /**
-    EOLn(text) + OI().
+    Writes all finished log lines to the log files, irrespective of the flush policy.
+    In async mode, this waits for the writer thread to write the logs queued so far.
+    Unfinished lines are not written, since those might be continued later.
+    Per-process property.
 */
-void CConsole::EOLnOI(const char* text, ...)
+void CConsole::Flush()
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
 
-    va_list list;
-    va_start(list, text);
-    consoleImpl->EOLnOI(text, list);
-    va_end(list);
+    consoleImpl->Flush();
 #endif
-} // EOLnOI()
+} // Flush()
 
 
 /**
-    EO(text) + OO().
+    Tells if the html log file is written in compact html.
+    Per-process property.
 */
-void CConsole::EOOO(const char* text, ...)
+bool CConsole::isCompactHtml() const
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
-        return;
+        return false;
 
-    va_list list;
-    va_start(list, text);
-    consoleImpl->EOOO(text, list);
-    va_end(list);
+    return consoleImpl->isCompactHtml();
+#else
+    return false;
 #endif
-} // EOOO()
+} // isCompactHtml()
 
 
 /**
-    EOLn(text) + OO().
+    Sets the html log file to be written in compact html or not.
+    Default value is false: every value is wrapped into its own font tag, and spaces and new lines are written as
+    html entities and tags, as always.
+    When set to true, log lines are written into <pre> blocks so spaces and new lines need no markup, and colors
+    are referenced by short css class names defined in the header of the html log file, adjacent values of the
+    same color are put into a single tag. This makes the html log file several times smaller for logs with many
+    values, while it looks the same in the browser.
+    The css classes are defined for the default colors of CConsole, other colors are written with inline style.
+    It can be changed any time, subsequent log lines are written in the selected way. To have the whole html log
+    file compact, invoke it right after the first Initialize().
+    Per-process property.
+
+    @param state True to write compact html, false to write html as always.
 */
-void CConsole::EOLnOO(const char* text, ...)
+void CConsole::SetCompactHtml(bool state)
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
 
-    va_list list;
-    va_start(list, text);
-    consoleImpl->EOLnOO(text, list);
-    va_end(list);
+    consoleImpl->SetCompactHtml(state);
 #endif
-} // EOLnOO()
+} // SetCompactHtml()
 
 
 /**
-    OI() + SO(text) + OO().
+    Gets the logging statistics collected since the start of the process or the last ResetStats().
+    Lines are counted when they are ended, e.g. by OLn() or by operator<< with NL: written lines are counted when
+    they are passed to the sinks, suppressed lines are the ones dropped by the logging state of their logger module
+    or by the runtime logging level.
+    Sink bytes are the rendered bytes given to the sinks, the binary log file is not included.
+    Mutex waiting time is the total time logging threads spent waiting for another thread to finish its call, time
+    of sink writes includes flushing the sinks. In async mode sinks are written by the writer thread.
+    Counters are updated without locking, so they don't slow down logging, and they are available even when
+    the console is not initialized.
+    Per-process property.
+
+    @return Totals of all logger modules, and the line counters of every logger module having any nonzero counter.
 */
-void CConsole::OISOOO(const char* text, ...)
+CConsole::Stats CConsole::getStats() const
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
-    if ( !(consoleImpl && (consoleImpl->bInited)) )
-        return;
+    Stats stats = CConsoleImpl::getStats();
+    if ( consoleImpl )
+    {
+        stats.nThreadStates = consoleImpl->logState.size();
+    }
+    return stats;
+#else
+    return Stats{};
+#endif
+} // getStats()
+
+
+/**
+    Resets the logging statistics to zero.
+    Per-process property.
+*/
+void CConsole::ResetStats()
+{
+#ifdef CCONSOLE_IS_ENABLED
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
-    va_list list;
-    va_start(list, text);
-    consoleImpl->OISOOO(text, list);
-    va_end(list);
+    CConsoleImpl::ResetStats();
 #endif
-} // OISOOO
+} // ResetStats()
 
 
 /**
-    OI() + SOLn(text) + OO().
+    Tells if the given sink is open.
+    Per-process property.
 */
-void CConsole::OISOLnOO(const char* text, ...)
+bool CConsole::isSinkOpen(CConsole::Sink sink) const
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
-        return;
+        return false;
 
-    va_list list;
-    va_start(list, text);
-    consoleImpl->OISOLnOO(text, list);
-    va_end(list);
+    return consoleImpl->isSinkOpen(sink);
+#else
+    return false;
 #endif
-} // OISOLnOO
+} // isSinkOpen()
 
 
 /**
-    OI() + EO(text) + OO().
+    Opens the given sink, so logs are written there too.
+    Logs are formatted only once, and every open sink renders them in its own format: the console with colors, the html
+    log file with the same colors and indentations, the text file and the memory sink as plain text, the JSON-lines file
+    as one object per log line with the logger module and the mode. The null sink discards the logs, with that and
+    headless Initialize() without log file, the cost of logging can be measured without any output.
+    Initialize() opens the console sink, and also the html log file sink if log file is requested, other sinks are
+    closed by default. Opening an already open sink does nothing.
+    Per-process property.
+
+    @param sink     The sink to be opened.
+    @param filename Name of the file for the file sinks, existing file is overwritten. Required for the html log file.
+                    If NULL, name of the text and JSON-lines files is derived from the name of the html log file
+                    created by Initialize(), with .txt and .jsonl extension.
+    @return True if the sink is open, false otherwise.
 */
-void CConsole::OIEOOO(const char* text, ...)
+bool CConsole::OpenSink(CConsole::Sink sink, const char* filename)
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
-        return;
+        return false;
 
-    va_list list;
-    va_start(list, text);
-    consoleImpl->OIEOOO(text, list);
-    va_end(list);
+    return consoleImpl->OpenSink(sink, filename);
+#else
+    return false;
 #endif
-} // OIEOOO
+} // OpenSink()
 
 
 /**
-    OI() + EOLn(text) + OO().
+    Closes the given sink, logs are not written there anymore.
+    Logs already queued in async mode are written to the sink before it is closed.
+    Per-process property.
 */
-void CConsole::OIEOLnOO(const char* text, ...)
+void CConsole::CloseSink(CConsole::Sink sink)
 {
 #ifdef CCONSOLE_IS_ENABLED
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
 
-    va_list list;
-    va_start(list, text);
-    consoleImpl->OIEOLnOO(text, list);
-    va_end(list);
+    consoleImpl->CloseSink(sink);
 #endif
-} // OIEOLnOO
+} // CloseSink()
 
 
 /**
-    Gets total count of printouts-with-newline during error-mode.
+    Sets logs of the given mode to be written to the given sink or not.
+    This filter is applied after the logger module and mode filtering of the logs, e.g. when only errors are wanted
+    in the console while everything is written to a text file:
+        con.OpenSink(CConsole::Sink::TextFile);
+        con.SetSinkModeState(CConsole::Sink::Console, CConsole::N, false);
+        con.SetSinkModeState(CConsole::Sink::Console, CConsole::S, false);
+    Mode of a log line is the mode that is active when the line is ended.
+    Sink must be open, and its filter is reset when it is closed. By default all modes are written to every sink.
     Per-process property.
+
+    @param mode N, E or S.
 */
-int CConsole::getErrorOutsCount() const
+void CConsole::SetSinkModeState(CConsole::Sink sink, CConsole::FormatSignal mode, bool state)
 {
-    std::lock_guard<std::mutex> lock(mainMutex);
+#ifdef CCONSOLE_IS_ENABLED
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
-        return 0;
+        return;
 
-    return consoleImpl->getErrorOutsCount();
-} // getErrorOutsCount()
+    consoleImpl->SetSinkModeState(sink, mode, state);
+#endif
+} // SetSinkModeState()
 
 
 /**
-    Gets total count of printouts-with-newline during success-mode.
+    Sets logs of the given logger module to be written to the given sink or not.
+    This filter is applied after the logger module filtering set by SetLoggingState(), so it can only exclude logs
+    that would appear otherwise.
+    Sink must be open, and its filter is reset when it is closed. By default logs of all logger modules are written to every sink.
     Per-process property.
 */
-int CConsole::getSuccessOutsCount() const    
+void CConsole::SetSinkLoggingState(CConsole::Sink sink, const char* loggerModuleName, bool state)
 {
-    std::lock_guard<std::mutex> lock(mainMutex);
+#ifdef CCONSOLE_IS_ENABLED
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
-        return 0;
+        return;
 
-    return consoleImpl->getSuccessOutsCount();
-} // getSuccessOutsCount()
+    consoleImpl->SetSinkLoggingState(sink, loggerModuleName, state);
+#endif
+} // SetSinkLoggingState()
 
 
 /**
-    Resets total count of printouts-with-newline during error-mode.
+    Gets the logs collected by the memory sink as plain text.
+    In async mode, logs still in the queue are not yet included.
     Per-process property.
+
+    @return Empty string if the memory sink is not open.
 */
-void CConsole::ResetErrorOutsCount()
+std::string CConsole::getMemorySinkText() const
 {
-    std::lock_guard<std::mutex> lock(mainMutex);
+#ifdef CCONSOLE_IS_ENABLED
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
-    if (!(consoleImpl && (consoleImpl->bInited)))
-        return;
+    if ( !(consoleImpl && (consoleImpl->bInited)) )
+        return std::string();
+
+    return consoleImpl->getMemorySinkText();
+#else
+    return std::string();
+#endif
+} // getMemorySinkText()
 
-    consoleImpl->ResetErrorOutsCount();
-}
 
 /**
-    Resets total count of printouts-with-newline during success-mode.
+    Clears the logs collected by the memory sink.
     Per-process property.
 */
-void CConsole::ResetSuccessOutsCount()
+void CConsole::ClearMemorySink()
 {
-    std::lock_guard<std::mutex> lock(mainMutex);
+#ifdef CCONSOLE_IS_ENABLED
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
-    if (!(consoleImpl && (consoleImpl->bInited)))
+    if ( !(consoleImpl && (consoleImpl->bInited)) )
         return;
 
-    consoleImpl->ResetSuccessOutsCount();
-}
+    consoleImpl->ClearMemorySink();
+#endif
+} // ClearMemorySink()
 
 
 /**
@@ -3598,7 +8325,10 @@ void CConsole::ResetSuccessOutsCount()
 */
 CConsole& CConsole::operator<<(const char* text)
 {
-    std::lock_guard<std::mutex> lock(mainMutex);
+    if ( CConsoleImpl::isSurelyFilteredOut(CConsole::N, false) )
+        return *this;
+
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return *this;
@@ -3613,7 +8343,10 @@ CConsole& CConsole::operator<<(const char* text)
 */
 CConsole& CConsole::operator<<(const bool& b)
 {
-    std::lock_guard<std::mutex> lock(mainMutex);
+    if ( CConsoleImpl::isSurelyFilteredOut(CConsole::N, false) )
+        return *this;
+
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return *this;
@@ -3628,7 +8361,44 @@ CConsole& CConsole::operator<<(const bool& b)
 */
 CConsole& CConsole::operator<<(const int& n)
 {
-    std::lock_guard<std::mutex> lock(mainMutex);
+    if ( CConsoleImpl::isSurelyFilteredOut(CConsole::N, false) )
+        return *this;
+
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
+
+    if ( !(consoleImpl && (consoleImpl->bInited)) )
+        return *this;
+
+    *consoleImpl << n;
+    return *this;
+} // operator<<()
+
+/**
+    O("%lld", n).
+*/
+CConsole& CConsole::operator<<(const long long& n)
+{
+    if ( CConsoleImpl::isSurelyFilteredOut(CConsole::N, false) )
+        return *this;
+
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
+
+    if ( !(consoleImpl && (consoleImpl->bInited)) )
+        return *this;
+
+    *consoleImpl << n;
+    return *this;
+} // operator<<()
+
+/**
+    O("%llu", n).
+*/
+CConsole& CConsole::operator<<(const unsigned long long& n)
+{
+    if ( CConsoleImpl::isSurelyFilteredOut(CConsole::N, false) )
+        return *this;
+
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return *this;
@@ -3643,7 +8413,27 @@ CConsole& CConsole::operator<<(const int& n)
 */
 CConsole& CConsole::operator<<(const float& f)
 {
-    std::lock_guard<std::mutex> lock(mainMutex);
+    if ( CConsoleImpl::isSurelyFilteredOut(CConsole::N, false) )
+        return *this;
+
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
+
+    if ( !(consoleImpl && (consoleImpl->bInited)) )
+        return *this;
+
+    *consoleImpl << f;
+    return *this;
+} // operator<<()
+
+/**
+    O("%f", f).
+*/
+CConsole& CConsole::operator<<(const double& f)
+{
+    if ( CConsoleImpl::isSurelyFilteredOut(CConsole::N, false) )
+        return *this;
+
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return *this;
@@ -3660,7 +8450,7 @@ CConsole& CConsole::operator<<(const float& f)
 */
 CConsole& CConsole::operator<<(const CConsole::FormatSignal& fs)
 {
-    std::lock_guard<std::mutex> lock(mainMutex);
+    std::lock_guard<CConsoleMutex> lock(mainMutex);
 
     if ( !(consoleImpl && (consoleImpl->bInited)) )
         return *this;
@@ -3700,23 +8490,215 @@ CConsole& CConsole::operator= (const CConsole&)
 
 CConsole::~CConsole()
 {
-#ifdef CCONSOLE_IS_ENABLED
     // dtor is private, no need to use mutex here, and also it worth mentioning that
     // CConsole is existing as a single static instance, our mainMutex is also static,
     // so at the end of the running program, I'm not sure about the release order of
     // these resources but better not use that static mutex here.
     // And also, a mutex might throw exception, we should never throw exception in
     // dtor. If someone really needs mutex here, use a non-throwing mutex (see more on stackoverflow).
+    // The dtor is invoked only once at the end of the program, Deinitialize() uses Shutdown() instead,
+    // since members of an object must not be touched after its dtor was invoked.
+    Shutdown();
+}
 
+
+/**
+    Writes the last message, and deletes the implementation, so a later Initialize() creates a new one.
+    Invoked when the reference count reaches 0, and by the dtor.
+    Except for the dtor, caller should lock mainMutex.
+*/
+void CConsole::Shutdown()
+{
+#ifdef CCONSOLE_IS_ENABLED
     if ( !consoleImpl )
         return;
 
-    consoleImpl->OLn("CConsole::~CConsole() LAST MESSAGE, BYE!");
+    // pending counts of other threads are also written before the last message
+    consoleImpl->WritePendingRepeats(true);
+    consoleImpl->WriteSiteDrops(true);
+    consoleImpl->OLn("CConsole::%s() LAST MESSAGE, BYE!", __func__);
 #endif
 
     delete consoleImpl;
     consoleImpl = NULL;
-    // I know this might look unusual why I set sg to null in dtor, the answer is that the dtor is invoked
-    // manually by Deinitialize() too, in such case CConsole instance is not destroyed completely, in such
-    // case we need variables like this to be reset.
-}
\ No newline at end of file
+} // Shutdown()
+
+
+/*
+   CConsole::Batch
+   ###########################################################################
+   Not thread-safe, a batch is used by a single thread.
+*/
+
+
+// ############################### PUBLIC ################################
+
+
+/**
+    Creates an empty batch for the given CConsole instance.
+*/
+CConsole::Batch::Batch(CConsole& con) :
+    console(con),
+    nIndentValue(0)
+{
+} // Batch(...)
+
+
+/**
+    Commits the batch, see commit().
+*/
+CConsole::Batch::~Batch()
+{
+    commit();
+} // ~Batch()
+
+
+/**
+    Adds text to the batch.
+*/
+void CConsole::Batch::O(const char* text, ...)
+{
+#ifdef CCONSOLE_IS_ENABLED
+    va_list list;
+    va_start(list, text);
+    CConsoleImpl::BatchAdd(sPrintouts, CConsole::N, nIndentValue, false, text, list);
+    va_end(list);
+#endif
+} // O()
+
+
+/**
+    Adds text and a new line to the batch.
+*/
+void CConsole::Batch::OLn(const char* text, ...)
+{
+#ifdef CCONSOLE_IS_ENABLED
+    va_list list;
+    va_start(list, text);
+    CConsoleImpl::BatchAdd(sPrintouts, CConsole::N, nIndentValue, true, text, list);
+    va_end(list);
+#endif
+} // OLn()
+
+
+/**
+    Adds text in success mode to the batch.
+*/
+void CConsole::Batch::SO(const char* text, ...)
+{
+#ifdef CCONSOLE_IS_ENABLED
+    va_list list;
+    va_start(list, text);
+    CConsoleImpl::BatchAdd(sPrintouts, CConsole::S, nIndentValue, false, text, list);
+    va_end(list);
+#endif
+} // SO()
+
+
+/**
+    Adds text in success mode and a new line to the batch.
+*/
+void CConsole::Batch::SOLn(const char* text, ...)
+{
+#ifdef CCONSOLE_IS_ENABLED
+    va_list list;
+    va_start(list, text);
+    CConsoleImpl::BatchAdd(sPrintouts, CConsole::S, nIndentValue, true, text, list);
+    va_end(list);
+#endif
+} // SOLn()
+
+
+/**
+    Adds text in error mode to the batch.
+*/
+void CConsole::Batch::EO(const char* text, ...)
+{
+#ifdef CCONSOLE_IS_ENABLED
+    va_list list;
+    va_start(list, text);
+    CConsoleImpl::BatchAdd(sPrintouts, CConsole::E, nIndentValue, false, text, list);
+    va_end(list);
+#endif
+} // EO()
+
+
+/**
+    Adds text in error mode and a new line to the batch.
+*/
+void CConsole::Batch::EOLn(const char* text, ...)
+{
+#ifdef CCONSOLE_IS_ENABLED
+    va_list list;
+    va_start(list, text);
+    CConsoleImpl::BatchAdd(sPrintouts, CConsole::E, nIndentValue, true, text, list);
+    va_end(list);
+#endif
+} // EOLn()
+
+
+/**
+    Increases indentation of the subsequent logs of the batch.
+*/
+void CConsole::Batch::Indent()
+{
+    nIndentValue += CConsoleImpl::CCONSOLE_INDENTATION_CHANGE;
+} // Indent()
+
+
+/**
+    Decreases indentation of the subsequent logs of the batch.
+    Indentation of the thread never goes below 0 though.
+*/
+void CConsole::Batch::Outdent()
+{
+    nIndentValue -= CConsoleImpl::CCONSOLE_INDENTATION_CHANGE;
+} // Outdent()
+
+
+/**
+    Indent().
+*/
+void CConsole::Batch::OI()
+{
+    Indent();
+} // OI()
+
+
+/**
+    Outdent().
+*/
+void CConsole::Batch::OO()
+{
+    Outdent();
+} // OO()
+
+
+/**
+    Writes the logs collected so far with a single lock acquisition, then empties the batch.
+    Logs are written with the logger module, mode and indentation of the committing thread, so it is expected
+    to be the thread that filled the batch. Indentation changes of the batch are applied to the thread.
+    Nothing is written if CConsole is not initialized, the collected logs are dropped then.
+*/
+void CConsole::Batch::commit()
+{
+#ifdef CCONSOLE_IS_ENABLED
+    if ( sPrintouts.empty() && (nIndentValue == 0) )
+        return;
+
+    {
+        std::lock_guard<CConsoleMutex> lock(mainMutex);
+
+        if ( console.consoleImpl && console.consoleImpl->bInited )
+            console.consoleImpl->WriteBatch(sPrintouts, nIndentValue);
+    }
+    sPrintouts.clear();
+    nIndentValue = 0;
+#endif
+} // commit()
+
+
+// ############################## PROTECTED ##############################
+
+
+// ############################### PRIVATE ###############################
\ No newline at end of file
@@ -9,6 +9,10 @@
 */
 
 #include <string>
+#include <vector>
+
+#include "CConsoleFormat.h"
+#include "CConsoleRateLimit.h"
 
 // copied NULL from stdlib.h to avoid including big ass headers
 /* Define NULL pointer value */
@@ -25,69 +29,82 @@
 typedef unsigned long       DWORD;
 typedef unsigned short      WORD;
 #endif
+
+// copied FOREGROUND_XXX and BACKGROUND_XXX from wincon.h so colors are given the same way on other platforms too
+#ifndef _WIN32
+#define FOREGROUND_BLUE      0x0001 // text color contains blue.
+#define FOREGROUND_GREEN     0x0002 // text color contains green.
+#define FOREGROUND_RED       0x0004 // text color contains red.
+#define FOREGROUND_INTENSITY 0x0008 // text color is intensified.
+#define BACKGROUND_BLUE      0x0010 // background color contains blue.
+#define BACKGROUND_GREEN     0x0020 // background color contains green.
+#define BACKGROUND_RED       0x0040 // background color contains red.
+#define BACKGROUND_INTENSITY 0x0080 // background color is intensified.
+#endif
+
+/**
+    Log levels of the level macros CCONSOLE_TRACE(), CCONSOLE_DEBUG(), etc.
+*/
+#define CCONSOLE_LEVEL_TRACE    0
+#define CCONSOLE_LEVEL_DEBUG    1
+#define CCONSOLE_LEVEL_INFO     2
+#define CCONSOLE_LEVEL_WARN     3
+#define CCONSOLE_LEVEL_ERROR    4
+#define CCONSOLE_LEVEL_OFF      5
+
+/**
+    Compile-time minimum log level of the level macros.
+    Level macros below this level are compiled out: neither the call nor its arguments are evaluated, so even
+    expensive log arguments cost nothing, e.g. define it to CCONSOLE_LEVEL_INFO in release builds to get rid of
+    all trace and debug logs. Runtime minimum level can be set on top of this by CConsole::SetLoggingLevel().
+*/
+#ifndef CCONSOLE_MIN_LEVEL
+#define CCONSOLE_MIN_LEVEL CCONSOLE_LEVEL_TRACE
+#endif
     
 /**
     Class handling a console window.
     Intentionally pimpl instead of abstract interface, please don't try to change.
     Thread-safe.
-    Unfortunately logs are not buffered, instead they are written to console and log file
-    immediately. This makes logging a bit slower, but currently there is no need for a more
-    efficient behavior.
+    By default logs are buffered only until the current line is ended, then the line is written
+    to console and log file immediately by the logging thread. This makes logging a bit slower.
+    Optionally async logging can be turned on by SetAsyncLogging(): in that case the logging threads
+    only format their logs and put them into a queue, and a background writer thread writes them
+    to console and log file.
 
     Known issues:
-    A) Reference-counting is done per-process, not per-thread.
-       Reference count is increased with every call to Initialize().
-       When Deinitialize() is invoked, we cannot decide when we can
-       free up per-thread log state data. We free up per-thread state data only when
-       reference count reaches 0. However, if threads born and die and born again,
+    A) Fixed: reference-counting was done per-process, not per-thread.
+       Reference count was increased with every call to Initialize().
+       When Deinitialize() was invoked, we could not decide when we can
+       free up per-thread log state data. We freed up per-thread state data only when
+       reference count reached 0. However, if threads born and die and born again,
        a previously used thread id might be already used again by a newly born thread,
-       and that newly born thread will use the log state data of a previously died
+       and that newly born thread used the log state data of a previously died
        thread instead of clean data.
        
-       Workaround:
-       Threads should manually invoke RestoreDefaultColors() and SaveColors() after they
-       invoke their FIRST Initialize() during their birth.
-       
        Solution:
-       Reference counting should be per-thread. This also means Deinitialize() should
-       summarize all reference counts before deciding to clean everything up at the end.
-
-    B) Threads don't wait for each other to finish their current line.
-       Functions that don't start a new log line after printing the log might cause wrong log output.
-       Example: O(). This function is typically used when we are iteratively building up
-       a log line. In between consecutive calls to this function, other threads might also
-       write to log.
-       
-       Workaround:
-       If multiple threads are allowed to log, use functions that also start a new log line
-       after printing the log e.g. OLn(). Don't use O() and similar functions when multiple
-       threads are expected to log.
+       Reference counting is per-thread, and Deinitialize() summarizes all reference counts
+       before deciding to clean everything up at the end.
+       Log state data of a thread is freed up when the thread exits, so a newly born thread
+       always starts with clean data, and log state data doesn't pile up with threads born and died.
+       References of an exiting thread not released by Deinitialize() are dropped with its log state data.
+
+    B) Fixed: threads don't wait for each other to finish their current line.
+       Functions that don't start a new log line after printing the log, e.g. O(), are typically used
+       when we are iteratively building up a log line. In between consecutive calls to these functions,
+       other threads might also write to log, and previously this could cause mixed log output.
        
-       Possible Solution:
-       With lock_guard and unique_lock, the mutex should be owned until the owner finally ends the
-       current log line. Currently only lock_guard is used in all public interfacing functions, but
-       this should be changed to unique_lock in those functions that doesn't end current log line.
-       So when O() is invoked, unique_lock should be used which won't unlock at the end of function,
-       so the lock (the mutex) is kept even when the functions ends. Ending the current line in
-       another call should always unlock this lock / release the mutex.
-       To achieve this, mainMutex should be recursive, otherwise the same thread won't be able to
-       invoke any consecutive public logging function.
-       Whenever a new line is added (the current line is ended), the lock holding this mutex should be
-       unlocked as many times as needed to be finally unlocked (because the lock with recursive mutex
-       should be unlocked as many times as it was previously locked to finally release the mutex).
-       
-       Drawbacks:
-       Other threads will have to wait until a new line is started (when the thread owning the mutex
-       finally ends the current line). This means that some logs from other threads will be delayed,
-       although they would log something earlier. Buffering (queueing) would solve this issue too,
-       but currently it would take some more time to implement.
+       Solution:
+       Every thread collects its current log line in its own line buffer held in its log state.
+       The finished line is written to console and log file in one go when the line is ended,
+       e.g. by OLn() or by a new line printed with operator<<. So lines of different threads never
+       get mixed, and other threads don't have to wait either.
        
-       Decision:
-       I decided not to fix this because even if I fix this issue, still there is another legacy issue
-       even in a single-threaded scenario which makes use of O() and similar functions a bit annoying.
-       This is explained in known issue C).
+       Drawback:
+       Output of O() and similar functions appears only when the current line is ended.
+       Unfinished lines are written when CConsole is finally deinitialized.
 
-    C) Setting error mode for only a part of a log line can make error-only logging look weird and useless.
+    C) Fixed: setting error mode for only a part of a log line can make error-only logging look weird and useless.
        For example, if you log something with O() and then process something (e.g. load a bitmap), and
        then you would finish the line with either error mode or success mode based on the result of the
        processing (e.g. bitmap load failed or succeeded), then the error mode will be applied to that
@@ -95,43 +112,17 @@ typedef unsigned short      WORD;
        errors are enabled, this would lead to printing only that part of the log line, without the
        earlier part of the line. This looks bad as you dont really know what really failed.
        
-       Workaround:
-       Use functions that also start a new log line after printing the log, e.g. EOLn(), so the whole line
-       will be logged in error mode. Don't use O() and similar functions.
+       Solution:
+       With SetErrorBacklogLines(), every thread keeps its most recent suppressed lines in a fifo buffer,
+       and after it logs an error, the buffer is printed to log, so the log reader has a clue what really
+       went wrong, including the earlier part of the failed line.
+       Usually if something fails and logs error, something else depending on the previous result will
+       also fail and log error. So the buffer is not printed at the error, but delayed until the first next
+       non-error printout, or until the indentation increases, since then we most probably left that code
+       area which handled the failure. This way the buffer is printed only once after a series of errors.
        
-       Possible Solution:
-       In case of error, the previous few logged lines should be printed to log even if they were filtered
-       out by default, so the log reader has a clue what really went wrong. To accomplish this, we need to
-       maintain a fifo buffer with the most recent log lines, and being able to log it on-demand.
-       Note that this could bring in another issue:
-       usually if something fails and logs error, something else depending on the previous result will
-       also fail and log error. In such case, it can happen that the fifo buffer is printed multiple times,
-       whenever an error is logged. This also doesn't look good. To overcome this, we should delay the fifo
-       buffer printout until the first next non-error printout.
-       Also I think that checking how the indentation changes after an error is logged is also helpful because
-       usually if something fails, then the indentation is expected to be decreased and some other error
-       might be also logged, and whenever the indentation increases we most probably left that code area
-       which handled the failure so we can print out the fifo buffer.  
-
-    D) Non-breakable spaces are not always put into html log file.
-       Consider the following example:
-       OLn("apple     banana");
-       The number of spaces will be correct in the console window, but only 1 space will be visible in the
-       html log file.
-
-       Workaround:
-       O("apple");
-       O("     ");
-       OLn("banana");
-
-       Possible Solution:
-       I've just quickly checked and saw CConsoleImpl::WriteText() puts nbsp characters only when the whole
-       given string consists of space characters only. I think this should be changed: anywhere in the string
-       where we find more than 1 spaces next to each other, nbsp chars should be inserted into the html file.
-       Also it is worth noting that if the string is a formatter string (contains %), then the big switch-case
-       of WriteFormattedTextEx() will be executed instead of WriteText(), and that switch case walks the string
-       char-by-char. Similar logic should be inserted there as well: if we are encountering a space char right
-       after another space char, we should write nbsp to the html file instead of regular space char.
+       Drawback:
+       It is off by default, since printouts of disabled logger modules need to take the lock to be kept.
 */
 
 class CConsole
@@ -146,20 +137,137 @@ public:
         N   /* normal mode */
     };
 
+    /**
+        Handle of a logger module, see getModuleHandle().
+    */
+    enum class ModuleHandle : unsigned short
+    {
+        None = 0  /* no logger module, logs always appear */
+    };
+
+    /**
+        Outputs of the logs, see OpenSink().
+    */
+    enum class Sink
+    {
+        Console,   /* console window, or stdout and stderr on non-Windows platforms */
+        HtmlFile,  /* html log file */
+        TextFile,  /* plain text file */
+        JsonFile,  /* JSON-lines file, one object per log line */
+        Memory,    /* plain text collected in memory, see getMemorySinkText() */
+        Null       /* discards the logs, for measuring the cost of logging */
+    };
+
+    /**
+        When the buffered log files are written, see SetFlushPolicy().
+    */
+    enum class FlushPolicy
+    {
+        EveryLine,  /* after every log line */
+        OnError,    /* after every error-mode log line */
+        Interval,   /* after the given time elapsed since the last flush */
+        BufferFull  /* only when the buffer is full, or by Flush() */
+    };
+
+    /**
+        Line counters of a logger module, see getStats().
+        Counters are indexed by mode: 0 for normal, 1 for error, 2 for success mode.
+    */
+    struct ModuleStats
+    {
+        std::string        sName;                 /* name of the logger module, empty for ModuleHandle::None */
+        unsigned long long nLines[3];             /* lines written */
+        unsigned long long nSuppressedLines[3];   /* lines dropped by the logging state of the module, by the logging level, as repeats or by rate limit */
+    };
+
+    /**
+        Counters collected since the start of the process or the last ResetStats(), see getStats().
+        Line counters are indexed by mode: 0 for normal, 1 for error, 2 for success mode.
+    */
+    struct Stats
+    {
+        unsigned long long nLines[3];             /* lines written, all logger modules */
+        unsigned long long nSuppressedLines[3];   /* lines dropped by filters, as repeats or by rate limit, all logger modules */
+        unsigned long long nSinkBytes[6];         /* bytes written to the sinks, indexed by Sink */
+        unsigned long long nFlushes;              /* number of times the sinks were flushed */
+        unsigned long long nMutexWaitMicrosecs;   /* total time spent by logging threads waiting for each other */
+        unsigned long long nSinkWriteMicrosecs;   /* total time spent writing and flushing the sinks */
+        unsigned long long nThreadStates;         /* number of threads having log state, i.e. live threads that used CConsole */
+        std::vector<ModuleStats> modules;         /* logger modules having any nonzero line counter */
+    };
+
+    /**
+        Collects logs of a thread locally, and writes them in one go when committed, e.g. for big state dumps:
+            CConsole::Batch batch(con);
+            batch.OLn("Loaded textures:");
+            batch.OI();
+            for (const auto& tex : textures)
+                batch.OLn("%s: %d x %d", tex.name, tex.width, tex.height);
+            batch.OO();
+            batch.commit();   // or just let batch go out of scope
+        Filling the batch doesn't take the lock: the raw argument values are copied as in the binary log.
+        Committing takes the lock once, writes all the logs with the logger module, mode and indentation of the
+        committing thread, then flushes the sinks once if needed. So the logs of the batch are contiguous in the
+        output and are not mixed with logs of other threads.
+        Indentation changes of the batch are kept by the thread after committing, as if the logs were printed directly.
+        Not thread-safe: a batch must be filled and committed by a single thread.
+    */
+    class Batch
+    {
+    public:
+        explicit Batch(CConsole& con);
+        ~Batch();                                     /**< Commits the batch. */
+
+        void O(const char* text, ...);                /**< Adds text to the batch. */
+        void OLn(const char* text, ...);              /**< Adds text and a new line to the batch. */
+        void SO(const char* text, ...);               /**< Adds text in success mode to the batch. */
+        void SOLn(const char* text, ...);             /**< Adds text in success mode and a new line to the batch. */
+        void EO(const char* text, ...);               /**< Adds text in error mode to the batch. */
+        void EOLn(const char* text, ...);             /**< Adds text in error mode and a new line to the batch. */
+        void Indent();                                /**< Increases indentation of the subsequent logs of the batch. */
+        void Outdent();                               /**< Decreases indentation of the subsequent logs of the batch. */
+        void OI();                                    /**< Indent(). */
+        void OO();                                    /**< Outdent(). */
+
+        void commit();                                /**< Writes the logs collected so far, then empties the batch. */
+
+    private:
+        CConsole&   console;
+        std::string sPrintouts;                       /**< Collected logs, encoded as in the error backlog, see CConsole.cpp. */
+        int         nIndentValue;                     /**< Indentation relative to the indentation of the thread at commit. */
+
+        Batch(const Batch&);
+        Batch& operator=(const Batch&);
+    };
+
     // ---------------------------------------------------------------------------
 
     static CConsole& getConsoleInstance(const char* loggerModuleName = "");   /**< Gets the singleton instance. */
+    static CConsole& getConsoleInstance(ModuleHandle loggerModule);           /**< Gets the singleton instance. */
+    static ModuleHandle getModuleHandle(const char* loggerModuleName);        /**< Gets the handle of the given logger module. */
 
     // ---------------------------------------------------------------------------
 
     bool getLoggingState(const char* loggerModuleName) const;        /**< Gets logging state for the given logger module. */
     void SetLoggingState(const char* loggerModuleName, bool state);  /**< Sets logging on or off for the given logger module. */
     void SetErrorsAlwaysOn(bool state);                              /**< Sets errors always appear irrespective of logging state of current logger module. */
+    int  getLoggingLevel() const;                                    /**< Gets runtime minimum log level of the level macros. */
+    void SetLoggingLevel(int level);                                 /**< Sets runtime minimum log level of the level macros. */
+    int  getErrorBacklogLines() const;                               /**< Gets the number of suppressed lines kept per thread for dumping them on error. */
+    void SetErrorBacklogLines(int lines);                            /**< Sets the number of suppressed lines kept per thread for dumping them on error. */
+    int  getRepeatedLinesTimeout() const;                            /**< Gets the max time consecutive identical lines of a thread are collapsed for. */
+    void SetRepeatedLinesTimeout(int millisecs);                     /**< Sets consecutive identical lines of a thread to be collapsed and for how long. */
+    void SetCrashHandler(bool state);                                /**< Sets the most recent log records to be written to a crash file on fatal signals or not. */
+    static void DumpFlightRecorder(int fd);                          /**< Writes the most recent log records to the given file descriptor, async-signal-safe. */
+    bool isLoggingEnabled(int level, FormatSignal mode) const;       /**< Tells without locking if a log of the given level might be printed by current thread. */
+    void WriteDroppedLines(
+        FormatSignal mode, unsigned long long lines);                /**< Writes how many logs were dropped at a call site of the rate-limited log macros. */
 
     void Initialize(
         const char* title,
         bool createLogFile,
-        const std::string& sFilenameAux = "");     /**< This creates actually the console window. */
+        const std::string& sFilenameAux = "",
+        bool createConsole = true);                /**< This creates actually the console window, unless headless. */
     void Deinitialize();          /**< This deletes the console window. */
     bool isInitialized() const;   /**< Tells if console window is already initialized. */
 
@@ -250,15 +358,87 @@ public:
     void OIEOOO(const char* text, ...);    /**< OI() + EO(text) + OO(). */
     void OIEOLnOO(const char* text, ...);  /**< OI() + EOLn(text) + OO(). */
 
+    // Overloads taking a format string wrapped by CCONSOLE_FMT(): format string is parsed and
+    // argument types are checked at compile time, so only the arguments are formatted at runtime.
+
+    template <class Fmt, CConsoleFormat::EnableIfFormat<Fmt> = 0, class... Args>
+    void O(Fmt, const Args&... args)      /**< Prints text to console. */
+    {
+        WriteFormat(CConsoleFormat::Parsed<Fmt>::format, CConsoleFormat::makeArgs<Fmt>(args...).arg, N, false);
+    }
+
+    template <class Fmt, CConsoleFormat::EnableIfFormat<Fmt> = 0, class... Args>
+    void OLn(Fmt, const Args&... args)    /**< Prints text to console and adds a new line. */
+    {
+        WriteFormat(CConsoleFormat::Parsed<Fmt>::format, CConsoleFormat::makeArgs<Fmt>(args...).arg, N, true);
+    }
+
+    template <class Fmt, CConsoleFormat::EnableIfFormat<Fmt> = 0, class... Args>
+    void SO(Fmt, const Args&... args)     /**< SOn() + O(text) + SOff(). */
+    {
+        WriteFormat(CConsoleFormat::Parsed<Fmt>::format, CConsoleFormat::makeArgs<Fmt>(args...).arg, S, false);
+    }
+
+    template <class Fmt, CConsoleFormat::EnableIfFormat<Fmt> = 0, class... Args>
+    void SOLn(Fmt, const Args&... args)   /**< SOn() + OLn(text) + SOff(). */
+    {
+        WriteFormat(CConsoleFormat::Parsed<Fmt>::format, CConsoleFormat::makeArgs<Fmt>(args...).arg, S, true);
+    }
+
+    template <class Fmt, CConsoleFormat::EnableIfFormat<Fmt> = 0, class... Args>
+    void EO(Fmt, const Args&... args)     /**< EOn() + O(text) + EOff(). */
+    {
+        WriteFormat(CConsoleFormat::Parsed<Fmt>::format, CConsoleFormat::makeArgs<Fmt>(args...).arg, E, false);
+    }
+
+    template <class Fmt, CConsoleFormat::EnableIfFormat<Fmt> = 0, class... Args>
+    void EOLn(Fmt, const Args&... args)   /**< EOn() + OLn(text) + EOff(). */
+    {
+        WriteFormat(CConsoleFormat::Parsed<Fmt>::format, CConsoleFormat::makeArgs<Fmt>(args...).arg, E, true);
+    }
+
     int getErrorOutsCount() const;      /**< Gets total count of printouts-with-newline during error-mode. */
     int getSuccessOutsCount() const;    /**< Gets total count of printouts-with-newline during success-mode. */
     void ResetErrorOutsCount();         /**< Resets total count of printouts-with-newline during error-mode. */
     void ResetSuccessOutsCount();       /**< Resets total count of printouts-with-newline during success-mode. */
 
+    bool isAsyncLogging() const;        /**< Tells if logs are written by a background writer thread. */
+    void SetAsyncLogging(bool state);   /**< Sets logs to be written by a background writer thread or by the logging threads. */
+
+    bool isBinaryLogging() const;       /**< Tells if logs are written unformatted to a binary log file. */
+    void SetBinaryLogging(bool state);  /**< Sets logs to be written unformatted to a binary log file instead of console and html log file. */
+
+    FlushPolicy getFlushPolicy() const;   /**< Gets when the log files are flushed. */
+    void SetFlushPolicy(
+        FlushPolicy policy,
+        int intervalMillisecs = 1000);    /**< Sets when the log files are flushed. */
+    void Flush();                         /**< Writes all finished log lines to the log files. */
+
+    bool isCompactHtml() const;           /**< Tells if the html log file is written in compact html. */
+    void SetCompactHtml(bool state);      /**< Sets the html log file to be written in compact html or not. */
+
+    Stats getStats() const;               /**< Gets the logging statistics. */
+    void ResetStats();                    /**< Resets the logging statistics. */
+
+    bool isSinkOpen(Sink sink) const;                         /**< Tells if the given sink is open. */
+    bool OpenSink(Sink sink, const char* filename = NULL);    /**< Opens the given sink, so logs are written there too. */
+    void CloseSink(Sink sink);                                /**< Closes the given sink. */
+    void SetSinkModeState(
+        Sink sink, FormatSignal mode, bool state);            /**< Sets logs of the given mode to be written to the given sink or not. */
+    void SetSinkLoggingState(
+        Sink sink, const char* loggerModuleName, bool state); /**< Sets logs of the given logger module to be written to the given sink or not. */
+    std::string getMemorySinkText() const;                    /**< Gets the logs collected by the memory sink. */
+    void ClearMemorySink();                                   /**< Clears the logs collected by the memory sink. */
+
     CConsole& operator<<(const char* text);  /**< O("%s", text). */
     CConsole& operator<<(const bool& b);     /**< O("%b", b). */
     CConsole& operator<<(const int& n);      /**< O("%d", n). */
+    CConsole& operator<<(
+        const long long& n);                 /**< O("%lld", n). */
+    CConsole& operator<<(
+        const unsigned long long& n);        /**< O("%llu", n). */
     CConsole& operator<<(const float& f);    /**< O("%f", f). */
+    CConsole& operator<<(const double& f);   /**< O("%f", f). */
     CConsole& operator<<(
         const CConsole::FormatSignal& fs);   /**< Changes current mode or adds a new line. */
 
@@ -276,6 +456,85 @@ private:
     CConsole& operator= (const CConsole&);
     virtual ~CConsole();
 
+    void Shutdown();                  /**< Writes the last message and deletes consoleImpl, caller should lock mainMutex. */
+
+    void WriteFormat(
+        const CConsoleFormat::Format& format,
+        const CConsoleFormat::Arg* args,
+        FormatSignal mode,
+        bool nl);                     /**< Common part of the template overloads of O(), OLn(), etc. */
+
 }; // class CConsole
 
 
+/**
+    Level macros: print a line with the given CConsole instance if the level of the macro is enabled, e.g.:
+        CCONSOLE_DEBUG(con, "Entity %s moved to %f", getName().c_str(), getPos());
+    Trace, debug, info and warn logs are printed in normal mode, success logs are info-level logs printed in
+    success mode, error logs are printed in error mode.
+    Logs below CCONSOLE_MIN_LEVEL are compiled out. Otherwise the arguments are evaluated only if the log is not
+    dropped by the runtime level and by the logging state of current logger module, see CConsole::isLoggingEnabled().
+    Arguments are the same as of CConsole::OLn(), so CCONSOLE_FMT() can be also used.
+*/
+#define CCONSOLE_LOG(con, level, mode, func, ...)                                 \
+    do                                                                            \
+    {                                                                             \
+        if constexpr ( (level) >= CCONSOLE_MIN_LEVEL )                            \
+        {                                                                         \
+            CConsole& cconsoleLevelTarget = (con);                                \
+            if ( cconsoleLevelTarget.isLoggingEnabled((level), (mode)) )          \
+                cconsoleLevelTarget.func(__VA_ARGS__);                            \
+        }                                                                         \
+    } while (0)
+
+#define CCONSOLE_TRACE(con, ...)   CCONSOLE_LOG(con, CCONSOLE_LEVEL_TRACE, CConsole::N, OLn, __VA_ARGS__)
+#define CCONSOLE_DEBUG(con, ...)   CCONSOLE_LOG(con, CCONSOLE_LEVEL_DEBUG, CConsole::N, OLn, __VA_ARGS__)
+#define CCONSOLE_INFO(con, ...)    CCONSOLE_LOG(con, CCONSOLE_LEVEL_INFO,  CConsole::N, OLn, __VA_ARGS__)
+#define CCONSOLE_SUCCESS(con, ...) CCONSOLE_LOG(con, CCONSOLE_LEVEL_INFO,  CConsole::S, SOLn, __VA_ARGS__)
+#define CCONSOLE_WARN(con, ...)    CCONSOLE_LOG(con, CCONSOLE_LEVEL_WARN,  CConsole::N, OLn, __VA_ARGS__)
+#define CCONSOLE_ERROR(con, ...)   CCONSOLE_LOG(con, CCONSOLE_LEVEL_ERROR, CConsole::E, EOLn, __VA_ARGS__)
+
+/**
+    Rate-limited level macros: same as the level macros, but for logs printed from hot loops, e.g. once per frame:
+        CCONSOLE_DEBUG_LIMITED(con, 10, "Frame %u rendered", nFrame);   // at most 10 logs per second
+        CCONSOLE_DEBUG_SAMPLED(con, 100, "Packet %u received", nPacket);  // 1 log out of every 100 logs
+    Limits are per call site: the state of the site is kept in static storage generated by the macro, and the
+    decision costs a single atomic read-modify-write on it and a read of the steady clock, taken only if the log is
+    not dropped by the level or by the logging state of current logger module, and before taking any lock or
+    formatting anything.
+    Number of dropped logs is written before the next printed log of the same site, at most once per second, see
+    CConsole::WriteDroppedLines(). If the site gets no more calls, the number is written with the source location of
+    the site after 2 seconds by a background thread, or by Deinitialize().
+    Dropped logs are also counted as suppressed lines by CConsole::getStats().
+*/
+#define CCONSOLE_LOG_LIMITED(con, level, mode, func, accept, limit, ...)                          \
+    do                                                                                            \
+    {                                                                                             \
+        if constexpr ( (level) >= CCONSOLE_MIN_LEVEL )                                            \
+        {                                                                                         \
+            static CConsoleRateLimit::Site cconsoleRateLimitSite(__FILE__, __LINE__, (mode));     \
+            CConsole& cconsoleLevelTarget = (con);                                                \
+            std::uint64_t cconsoleDroppedLines = 0;                                               \
+            if ( cconsoleLevelTarget.isLoggingEnabled((level), (mode)) &&                         \
+                 CConsoleRateLimit::accept(cconsoleRateLimitSite, (limit), cconsoleDroppedLines) ) \
+            {                                                                                     \
+                if ( cconsoleDroppedLines > 0 )                                                   \
+                    cconsoleLevelTarget.WriteDroppedLines((mode), cconsoleDroppedLines);          \
+                cconsoleLevelTarget.func(__VA_ARGS__);                                            \
+            }                                                                                     \
+        }                                                                                         \
+    } while (0)
+
+#define CCONSOLE_TRACE_LIMITED(con, maxPerSec, ...)   CCONSOLE_LOG_LIMITED(con, CCONSOLE_LEVEL_TRACE, CConsole::N, OLn,  acceptRate, maxPerSec, __VA_ARGS__)
+#define CCONSOLE_DEBUG_LIMITED(con, maxPerSec, ...)   CCONSOLE_LOG_LIMITED(con, CCONSOLE_LEVEL_DEBUG, CConsole::N, OLn,  acceptRate, maxPerSec, __VA_ARGS__)
+#define CCONSOLE_INFO_LIMITED(con, maxPerSec, ...)    CCONSOLE_LOG_LIMITED(con, CCONSOLE_LEVEL_INFO,  CConsole::N, OLn,  acceptRate, maxPerSec, __VA_ARGS__)
+#define CCONSOLE_SUCCESS_LIMITED(con, maxPerSec, ...) CCONSOLE_LOG_LIMITED(con, CCONSOLE_LEVEL_INFO,  CConsole::S, SOLn, acceptRate, maxPerSec, __VA_ARGS__)
+#define CCONSOLE_WARN_LIMITED(con, maxPerSec, ...)    CCONSOLE_LOG_LIMITED(con, CCONSOLE_LEVEL_WARN,  CConsole::N, OLn,  acceptRate, maxPerSec, __VA_ARGS__)
+#define CCONSOLE_ERROR_LIMITED(con, maxPerSec, ...)   CCONSOLE_LOG_LIMITED(con, CCONSOLE_LEVEL_ERROR, CConsole::E, EOLn, acceptRate, maxPerSec, __VA_ARGS__)
+
+#define CCONSOLE_TRACE_SAMPLED(con, every, ...)       CCONSOLE_LOG_LIMITED(con, CCONSOLE_LEVEL_TRACE, CConsole::N, OLn,  acceptSample, every, __VA_ARGS__)
+#define CCONSOLE_DEBUG_SAMPLED(con, every, ...)       CCONSOLE_LOG_LIMITED(con, CCONSOLE_LEVEL_DEBUG, CConsole::N, OLn,  acceptSample, every, __VA_ARGS__)
+#define CCONSOLE_INFO_SAMPLED(con, every, ...)        CCONSOLE_LOG_LIMITED(con, CCONSOLE_LEVEL_INFO,  CConsole::N, OLn,  acceptSample, every, __VA_ARGS__)
+#define CCONSOLE_SUCCESS_SAMPLED(con, every, ...)     CCONSOLE_LOG_LIMITED(con, CCONSOLE_LEVEL_INFO,  CConsole::S, SOLn, acceptSample, every, __VA_ARGS__)
+#define CCONSOLE_WARN_SAMPLED(con, every, ...)        CCONSOLE_LOG_LIMITED(con, CCONSOLE_LEVEL_WARN,  CConsole::N, OLn,  acceptSample, every, __VA_ARGS__)
+#define CCONSOLE_ERROR_SAMPLED(con, every, ...)       CCONSOLE_LOG_LIMITED(con, CCONSOLE_LEVEL_ERROR, CConsole::E, EOLn, acceptSample, every, __VA_ARGS__)
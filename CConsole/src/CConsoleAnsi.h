@@ -0,0 +1,60 @@
+#pragma once
+
+/*
+    ###################################################################################
+    CConsoleAnsi.h
+    Mapping of console text attributes to ANSI escape sequences, used on non-Windows platforms.
+    Made by PR00F88
+    ###################################################################################
+*/
+
+#include <string>
+
+namespace CConsoleAnsi
+{
+
+    /** Resets all text attributes of the terminal. */
+    static constexpr const char* SGR_RESET = "\x1b[0m";
+
+    // same bits as FOREGROUND_XXX and BACKGROUND_XXX of wincon.h, so colors can be given the same way on every platform
+    static constexpr unsigned int ATTR_FG_MASK      = 0x0007u;
+    static constexpr unsigned int ATTR_FG_INTENSITY = 0x0008u;
+    static constexpr unsigned int ATTR_BG_SHIFT     = 4u;
+
+    /** Default foreground color of CConsole, mapped to the default foreground color of the terminal. */
+    static constexpr unsigned int ATTR_FG_DEFAULT   = 0x0007u;
+
+    /**
+        Converts a 3-bit console color (bit 0: blue, bit 1: green, bit 2: red) to ANSI color number (bit 0: red, bit 1: green, bit 2: blue).
+    */
+    constexpr unsigned int colorNumber(unsigned int clr)
+    {
+        return ((clr & 4u) >> 2) | (clr & 2u) | ((clr & 1u) << 2);
+    }
+
+    /**
+        Appends the SGR escape sequence selecting the colors of the given console text attribute to out.
+        Non-intense gray foreground and black background are the defaults of CConsole, they are mapped to the default
+        colors of the terminal so logs stay readable with any color scheme.
+    */
+    inline void AppendSgr(std::string& out, unsigned int attr)
+    {
+        const unsigned int clrFG = attr & (ATTR_FG_MASK | ATTR_FG_INTENSITY);
+        const unsigned int clrBG = (attr >> ATTR_BG_SHIFT) & (ATTR_FG_MASK | ATTR_FG_INTENSITY);
+
+        unsigned int nCodeFG = 39;
+        if ( clrFG != ATTR_FG_DEFAULT )
+            nCodeFG = ((clrFG & ATTR_FG_INTENSITY) ? 90u : 30u) + colorNumber(clrFG);
+
+        unsigned int nCodeBG = 49;
+        if ( clrBG != 0 )
+            nCodeBG = ((clrBG & ATTR_FG_INTENSITY) ? 100u : 40u) + colorNumber(clrBG);
+
+        out += "\x1b[0;";
+        out += std::to_string(nCodeFG);
+        out += ';';
+        out += std::to_string(nCodeBG);
+        out += 'm';
+    }
+
+} // namespace CConsoleAnsi
\ No newline at end of file
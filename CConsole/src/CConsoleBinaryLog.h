@@ -0,0 +1,121 @@
+#pragma once
+
+/*
+    ###################################################################################
+    CConsoleBinaryLog.h
+    Binary log file format of CConsole, shared by CConsole and the decoder tool.
+    Made by PR00F88
+    ###################################################################################
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+/**
+    With binary logging, CConsole doesn't format the logs at all, it just writes the format string id and the raw
+    argument values into the binary log file. The decoder tool renders the file into html or plain text afterwards.
+
+    The file is a sequence of records, every record starts with its RecordType.
+    All values are written in the native byte order of the logging machine, strings are written with their length.
+
+    RecordType::Header:  magic, version, title string.
+                         Written every time binary logging is turned on, starts a new session: ids of earlier
+                         sessions are not valid anymore.
+    RecordType::Format:  uint32 format id, format string.
+                         Written once per session for every format string, before its first Log record.
+    RecordType::Module:  uint16 module id, module name string.
+                         Written once per session for every logger module, before its first Log record.
+    RecordType::Log:     uint64 timestamp (microseconds since epoch), uint16 thread index, uint16 module id,
+                         uint8 mode, uint8 flags, int32 indentation, uint32 format id, then the raw value of every
+                         placeholder of the format string in order, by placeholder type of CConsoleFormat:
+                         's': string, 'd', 'i': int32, 'u': uint32, 'D': int64, 'U': uint64, 'b': uint8, 'f': double.
+*/
+namespace CConsoleBinaryLog
+{
+
+    static constexpr char MAGIC[8] = { 'C', 'C', 'O', 'N', 'B', 'L', 'O', 'G' };
+    static constexpr std::uint32_t VERSION = 1;
+    static constexpr const char* FILE_EXTENSION = ".cclog";
+    static constexpr std::uint32_t NULL_STRING = 0xFFFFFFFFu;   /**< String length written for NULL strings. */
+
+    enum class RecordType : std::uint8_t
+    {
+        Header = 1,
+        Format = 2,
+        Module = 3,
+        Log    = 4
+    };
+
+    /**
+        Flags of a Log record.
+    */
+    enum Flag : std::uint8_t
+    {
+        FLAG_NEWLINE = 1,   /* line is ended after the text, like by OLn() */
+        FLAG_VALUE   = 2    /* single value printed by operator<<, not wrapped into mode color */
+    };
+
+    /**
+        Appends the raw bytes of a value to buf.
+    */
+    template <class T>
+    inline void Put(std::string& buf, T value)
+    {
+        buf.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    /**
+        Appends a string with its length to buf, NULL is written with NULL_STRING length.
+    */
+    inline void PutString(std::string& buf, const char* text)
+    {
+        if ( text == NULL )
+        {
+            Put<std::uint32_t>(buf, NULL_STRING);
+            return;
+        }
+        const std::size_t nLength = strlen(text);
+        Put<std::uint32_t>(buf, static_cast<std::uint32_t>(nLength));
+        buf.append(text, nLength);
+    }
+
+    /**
+        Reads the raw bytes of a value from p and advances p.
+        @return False if there are not enough bytes before end.
+    */
+    template <class T>
+    inline bool Get(const char*& p, const char* end, T& value)
+    {
+        if ( static_cast<std::size_t>(end - p) < sizeof(value) )
+            return false;
+        memcpy(&value, p, sizeof(value));
+        p += sizeof(value);
+        return true;
+    }
+
+    /**
+        Reads a string written by PutString() from p and advances p.
+        @param bNull Set to true if NULL was written.
+        @return False if there are not enough bytes before end.
+    */
+    inline bool GetString(const char*& p, const char* end, std::string& text, bool& bNull)
+    {
+        std::uint32_t nLength;
+        if ( !Get(p, end, nLength) )
+            return false;
+        bNull = (nLength == NULL_STRING);
+        if ( bNull )
+        {
+            text.clear();
+            return true;
+        }
+        if ( static_cast<std::size_t>(end - p) < nLength )
+            return false;
+        text.assign(p, nLength);
+        p += nLength;
+        return true;
+    }
+
+} // namespace CConsoleBinaryLog
\ No newline at end of file
@@ -0,0 +1,509 @@
+/*
+    ###################################################################################
+    CConsoleDecoder.cpp
+    Renders binary log files written by CConsole into html or plain text.
+    Made by PR00F88
+    ###################################################################################
+*/
+
+#include "CConsoleBinaryLog.h"
+#include "CConsoleFormat.h"
+#include "CConsoleHtml.h"
+#include "CConsoleNumberFormat.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <string>
+
+namespace
+{
+
+    /**
+        Html colors CConsole uses by default in a mode, custom colors are not saved in the binary log.
+    */
+    struct ModeColors
+    {
+        const char* fg;
+        const char* strings;
+        const char* ints;
+        const char* floats;
+        const char* bools;
+    };
+
+    const ModeColors modeColors[] =
+    {
+        { "999999", "999999", "999999", "999999", "999999" },   /* normal mode */
+        { "FF0000", "DDDD00", "FFFF00", "FFFF00", "FFFF00" },   /* error mode */
+        { "00DD00", "00FF00", "FFFF00", "FFFF00", "FFFF00" }    /* success mode */
+    };
+
+    /**
+        Renders the records of a binary log file, in the same way as CConsole would have written them.
+    */
+    class Decoder
+    {
+    public:
+        Decoder(std::ostream& output, bool bHtml);
+
+        bool Decode(const std::string& data);   /**< Renders all records, returns false if data is corrupt. */
+        void Finish();                          /**< Writes unfinished lines and closing html tags. */
+
+    private:
+        /**
+            Line being collected for a thread, same as the per-thread line buffer of CConsole.
+        */
+        struct ThreadLine
+        {
+            bool          bLineStart{true};   /**< True if next record starts a new line, so it is indented. */
+            std::string   sText;              /**< Rendered text collected so far. */
+            std::uint64_t timestamp{0};       /**< Timestamp of the 1st record of sText. */
+            std::uint16_t nThread{0};         /**< Thread index of the thread. */
+            std::uint16_t nModule{0};         /**< Logger module of the 1st record of sText. */
+        };
+
+        std::ostream& out;
+        const bool bHtml;
+        bool bHeaderWritten;
+        bool bOutputAtLineStart;                    /**< Text output only: true if last written char was a new line. */
+        std::map<std::uint32_t, std::string> formats;
+        std::map<std::uint16_t, std::string> modules;
+        std::map<std::uint16_t, ThreadLine> lines;
+
+        bool DecodeHeader(const char*& p, const char* end);
+        bool DecodeLog(const char*& p, const char* end);
+        bool WriteValue(ThreadLine& line, const ModeColors& colors, char type, const char*& p, const char* end);
+        void WriteText(ThreadLine& line, const char* text, std::size_t len);
+        void WriteColored(ThreadLine& line, const char* clrHtml, const char* text, std::size_t len);
+        void CommitLine(ThreadLine& line);
+    };
+
+
+    Decoder::Decoder(std::ostream& output, bool html) :
+        out(output),
+        bHtml(html),
+        bHeaderWritten(false),
+        bOutputAtLineStart(true)
+    {
+    }
+
+
+    /**
+        Renders all records of data.
+        @return False if data is corrupt or truncated, in that case records before the bad one are still rendered.
+    */
+    bool Decoder::Decode(const std::string& data)
+    {
+        const char* p = data.data();
+        const char* const end = p + data.size();
+        while ( p < end )
+        {
+            std::uint8_t type;
+            CConsoleBinaryLog::Get(p, end, type);
+            switch ( static_cast<CConsoleBinaryLog::RecordType>(type) )
+            {
+            case CConsoleBinaryLog::RecordType::Header:
+                if ( !DecodeHeader(p, end) )
+                    return false;
+                break;
+            case CConsoleBinaryLog::RecordType::Format:
+                {
+                    std::uint32_t nFormat;
+                    std::string sFormat;
+                    bool bNull;
+                    if ( !CConsoleBinaryLog::Get(p, end, nFormat) || !CConsoleBinaryLog::GetString(p, end, sFormat, bNull) )
+                        return false;
+                    formats[nFormat] = sFormat;
+                }
+                break;
+            case CConsoleBinaryLog::RecordType::Module:
+                {
+                    std::uint16_t nModule;
+                    std::string sModule;
+                    bool bNull;
+                    if ( !CConsoleBinaryLog::Get(p, end, nModule) || !CConsoleBinaryLog::GetString(p, end, sModule, bNull) )
+                        return false;
+                    modules[nModule] = sModule;
+                }
+                break;
+            case CConsoleBinaryLog::RecordType::Log:
+                if ( !DecodeLog(p, end) )
+                    return false;
+                break;
+            default:
+                return false;
+            }
+        }
+        return true;
+    } // Decode()
+
+
+    /**
+        Writes unfinished lines and closing html tags, same as CConsole does at shutdown.
+    */
+    void Decoder::Finish()
+    {
+        for (auto& it : lines)
+        {
+            CommitLine(it.second);
+        }
+        if ( bHtml && bHeaderWritten )
+        {
+            out << "</font>" << std::endl;
+            out << "</body>" << std::endl;
+            out << "</html>" << std::endl;
+        }
+    } // Finish()
+
+
+    /**
+        Starts a new session: ids of earlier sessions are not valid anymore.
+    */
+    bool Decoder::DecodeHeader(const char*& p, const char* end)
+    {
+        if ( (static_cast<std::size_t>(end - p) < sizeof(CConsoleBinaryLog::MAGIC)) ||
+             (memcmp(p, CConsoleBinaryLog::MAGIC, sizeof(CConsoleBinaryLog::MAGIC)) != 0) )
+            return false;
+        p += sizeof(CConsoleBinaryLog::MAGIC);
+
+        std::uint32_t nVersion;
+        std::string sTitle;
+        bool bNull;
+        if ( !CConsoleBinaryLog::Get(p, end, nVersion) || (nVersion != CConsoleBinaryLog::VERSION) ||
+             !CConsoleBinaryLog::GetString(p, end, sTitle, bNull) )
+            return false;
+
+        // unfinished lines of previous session are not continued
+        for (auto& it : lines)
+        {
+            CommitLine(it.second);
+        }
+        lines.clear();
+        formats.clear();
+        modules.clear();
+
+        if ( bHtml && !bHeaderWritten )
+        {
+            out << "<html>" << std::endl;
+            out << "<head>" << std::endl;
+            std::string sTitleEscaped;
+            CConsoleHtml::AppendEscaped(sTitleEscaped, sTitle.data(), sTitle.length(), false);
+            out << "<title>" << sTitleEscaped << "</title>" << std::endl;
+            out << "</head>" << std::endl;
+            out << "<body bgcolor=\"#1D1D1D\" text=\"#DDDDDD\">" << std::endl;
+            out << "<font face=\"Courier\" size=\"2\">" << std::endl;
+        }
+        bHeaderWritten = true;
+        return true;
+    } // DecodeHeader()
+
+
+    /**
+        Renders a log record the same way as CConsoleImpl::WriteFormattedTextEx() and operator<<()s render a printout.
+    */
+    bool Decoder::DecodeLog(const char*& p, const char* end)
+    {
+        std::uint64_t timestamp;
+        std::uint16_t nThread, nModule;
+        std::uint8_t  nMode, flags;
+        std::int32_t  nIndent;
+        std::uint32_t nFormat;
+        if ( !CConsoleBinaryLog::Get(p, end, timestamp) || !CConsoleBinaryLog::Get(p, end, nThread) ||
+             !CConsoleBinaryLog::Get(p, end, nModule) || !CConsoleBinaryLog::Get(p, end, nMode) ||
+             !CConsoleBinaryLog::Get(p, end, flags) || !CConsoleBinaryLog::Get(p, end, nIndent) ||
+             !CConsoleBinaryLog::Get(p, end, nFormat) )
+            return false;
+
+        const auto itFormat = formats.find(nFormat);
+        if ( !bHeaderWritten || (itFormat == formats.end()) || (nMode > 2) )
+            return false;
+        const std::string& sFormat = itFormat->second;
+        const char* const fmt = sFormat.c_str();
+        const ModeColors& colors = modeColors[nMode];
+
+        ThreadLine& line = lines[nThread];
+        if ( line.sText.empty() )
+        {
+            line.timestamp = timestamp;
+            line.nThread = nThread;
+            line.nModule = nModule;
+        }
+
+        if ( line.bLineStart && (nIndent > 0) )
+        {
+            if ( bHtml )
+                CConsoleHtml::AppendNbsp(line.sText, static_cast<std::size_t>(nIndent));
+            else
+                line.sText.append(static_cast<std::size_t>(nIndent), ' ');
+        }
+
+        if ( (flags & CConsoleBinaryLog::FLAG_VALUE) != 0 )
+        {
+            // operator<<: only the indentation written at line start ends the line start
+            if ( nIndent > 0 )
+                line.bLineStart = false;
+            if ( (sFormat.length() > 1) && !WriteValue(line, colors, CConsoleFormat::placeholderType(fmt + 1), p, end) )
+                return false;
+        }
+        else
+        {
+            if ( bHtml && (nMode != 0) )
+            {
+                line.sText += "<font color=\"#";
+                line.sText += colors.fg;
+                line.sText += "\">";
+            }
+
+            if ( strchr(fmt, '%') == NULL )
+            {
+                // same as CConsoleImpl::WriteText()
+                if ( !bHtml )
+                    WriteText(line, fmt, sFormat.length());
+                else if ( sFormat == "\n\r" )
+                    line.sText += "<br>\n";
+                else if ( sFormat.find_first_not_of(' ') == std::string::npos )
+                    CConsoleHtml::AppendNbsp(line.sText, sFormat.length());
+                else
+                    CConsoleHtml::AppendEscaped(line.sText, sFormat.data(), sFormat.length(), true);
+            }
+            else
+            {
+                for (const char* q = fmt; *q; ++q)
+                {
+                    if ( *q != '%' )
+                    {
+                        const char* const r = strchr(q, '%');
+                        const std::size_t nRunLength = r ? static_cast<std::size_t>(r - q) : strlen(q);
+                        WriteText(line, q, nRunLength);
+                        q += nRunLength - 1;
+                        continue;
+                    }
+
+                    if ( !q[1] )
+                        break;
+
+                    const std::size_t nLength = CConsoleFormat::placeholderLength(q + 1);
+                    if ( nLength == 0 )
+                    {
+                        // char after % is printed as it is
+                        WriteText(line, q + 1, 1);
+                        q++;
+                        continue;
+                    }
+                    if ( !WriteValue(line, colors, CConsoleFormat::placeholderType(q + 1), p, end) )
+                        return false;
+                    q += nLength;
+                }
+            }
+            line.bLineStart = ( strchr(fmt, '\n') != NULL );
+
+            if ( bHtml && (nMode != 0) )
+                line.sText += "</font>";
+        }
+
+        if ( (flags & CConsoleBinaryLog::FLAG_NEWLINE) != 0 )
+        {
+            if ( bHtml )
+                line.sText += "<br>\n";
+            else
+                line.sText += '\n';
+            line.bLineStart = true;
+        }
+
+        if ( line.bLineStart )
+            CommitLine(line);
+        return true;
+    } // DecodeLog()
+
+
+    /**
+        Reads a raw value of the given placeholder type and writes it formatted, same as CConsoleImpl::ImmediateWriteXXX().
+    */
+    bool Decoder::WriteValue(ThreadLine& line, const ModeColors& colors, char type, const char*& p, const char* end)
+    {
+        char szNumber[CConsoleNumberFormat::BUFFER_SIZE];
+        std::size_t nLength = 0;
+        switch ( type )
+        {
+        case 's':
+            {
+                std::string sValue;
+                bool bNull;
+                if ( !CConsoleBinaryLog::GetString(p, end, sValue, bNull) )
+                    return false;
+                if ( bNull )
+                    sValue = "NULL";
+                WriteColored(line, colors.strings, sValue.c_str(), sValue.length());
+                return true;
+            }
+        case 'b':
+            {
+                std::uint8_t bValue;
+                if ( !CConsoleBinaryLog::Get(p, end, bValue) )
+                    return false;
+                WriteColored(line, colors.bools, bValue ? "true" : "false", bValue ? 4 : 5);
+                return true;
+            }
+        case 'i':
+        case 'd':
+            {
+                std::int32_t nValue;
+                if ( !CConsoleBinaryLog::Get(p, end, nValue) )
+                    return false;
+                nLength = CConsoleNumberFormat::FormatInteger(szNumber, nValue);
+                break;
+            }
+        case 'u':
+            {
+                std::uint32_t nValue;
+                if ( !CConsoleBinaryLog::Get(p, end, nValue) )
+                    return false;
+                nLength = CConsoleNumberFormat::FormatInteger(szNumber, nValue);
+                break;
+            }
+        case 'D':
+            {
+                std::int64_t nValue;
+                if ( !CConsoleBinaryLog::Get(p, end, nValue) )
+                    return false;
+                nLength = CConsoleNumberFormat::FormatInteger(szNumber, nValue);
+                break;
+            }
+        case 'U':
+            {
+                std::uint64_t nValue;
+                if ( !CConsoleBinaryLog::Get(p, end, nValue) )
+                    return false;
+                nLength = CConsoleNumberFormat::FormatInteger(szNumber, nValue);
+                break;
+            }
+        case 'f':
+            {
+                double fValue;
+                if ( !CConsoleBinaryLog::Get(p, end, fValue) )
+                    return false;
+                WriteColored(line, colors.floats, szNumber, CConsoleNumberFormat::FormatFloat(szNumber, fValue));
+                return true;
+            }
+        default:
+            return false;
+        }
+        WriteColored(line, colors.ints, szNumber, nLength);
+        return true;
+    } // WriteValue()
+
+
+    void Decoder::WriteText(ThreadLine& line, const char* text, std::size_t len)
+    {
+        if ( bHtml )
+        {
+            CConsoleHtml::AppendEscaped(line.sText, text, len, true);
+            return;
+        }
+        // console new lines are "\n\r", plain text doesn't need the '\r'
+        for (std::size_t i = 0; i < len; i++)
+        {
+            if ( text[i] != '\r' )
+                line.sText += text[i];
+        }
+    } // WriteText()
+
+
+    void Decoder::WriteColored(ThreadLine& line, const char* clrHtml, const char* text, std::size_t len)
+    {
+        if ( !bHtml )
+        {
+            WriteText(line, text, len);
+            return;
+        }
+        line.sText += "<font color=\"#";
+        line.sText += clrHtml;
+        line.sText += "\">";
+        CConsoleHtml::AppendEscaped(line.sText, text, len, true);
+        line.sText += "</font>";
+    } // WriteColored()
+
+
+    /**
+        Writes the collected line of a thread to output.
+        Plain text lines are prefixed by timestamp, thread index and logger module of their 1st record.
+    */
+    void Decoder::CommitLine(ThreadLine& line)
+    {
+        if ( line.sText.empty() )
+            return;
+
+        if ( !bHtml && bOutputAtLineStart )
+        {
+            const std::time_t time = static_cast<std::time_t>(line.timestamp / 1000000u);
+            char szTime[32];
+            if ( 0 == std::strftime(szTime, sizeof(szTime), "%Y-%m-%d %H:%M:%S", std::gmtime(&time)) )
+                szTime[0] = '\0';
+            char szPrefix[64];
+            snprintf(szPrefix, sizeof(szPrefix), "[%s.%06u] [T%u] ",
+                szTime, static_cast<unsigned int>(line.timestamp % 1000000u), static_cast<unsigned int>(line.nThread));
+            out << szPrefix;
+            const auto itModule = modules.find(line.nModule);
+            if ( (itModule != modules.end()) && !itModule->second.empty() )
+                out << "[" << itModule->second << "] ";
+        }
+        out << line.sText;
+        bOutputAtLineStart = (line.sText.back() == '\n');
+        line.sText.clear();
+    } // CommitLine()
+
+} // namespace
+
+
+int main(int argc, char* argv[])
+{
+    bool bHtml = true;
+    int iArg = 1;
+    if ( (argc > iArg) && (strcmp(argv[iArg], "-text") == 0) )
+    {
+        bHtml = false;
+        iArg++;
+    }
+
+    if ( (argc - iArg < 1) || (argc - iArg > 2) )
+    {
+        std::cerr << "Renders a binary log file of CConsole into html or plain text." << std::endl;
+        std::cerr << "Usage: " << argv[0] << " [-text] <input.cclog> [output]" << std::endl;
+        std::cerr << "Output is written to standard output if output file is not given." << std::endl;
+        return 2;
+    }
+
+    std::ifstream fInput(argv[iArg], std::ios::in | std::ios::binary);
+    if ( fInput.fail() )
+    {
+        std::cerr << "ERROR: Couldn't open " << argv[iArg] << " for reading!" << std::endl;
+        return 1;
+    }
+    const std::string data((std::istreambuf_iterator<char>(fInput)), std::istreambuf_iterator<char>());
+
+    std::ofstream fOutput;
+    if ( argc - iArg == 2 )
+    {
+        fOutput.open(argv[iArg + 1]);
+        if ( fOutput.fail() )
+        {
+            std::cerr << "ERROR: Couldn't open " << argv[iArg + 1] << " for writing!" << std::endl;
+            return 1;
+        }
+    }
+
+    Decoder decoder(fOutput.is_open() ? fOutput : std::cout, bHtml);
+    const bool bOk = decoder.Decode(data);
+    decoder.Finish();
+    if ( !bOk )
+    {
+        std::cerr << "ERROR: " << argv[iArg] << " is corrupt or truncated, only the records before the bad one are written!" << std::endl;
+        return 1;
+    }
+    return 0;
+} // main()
\ No newline at end of file
@@ -0,0 +1,368 @@
+#pragma once
+
+/*
+    ###################################################################################
+    CConsoleFlightRecorder.h
+    Crash-safe ring of the most recent log records of CConsole.
+    Made by PR00F88
+    ###################################################################################
+*/
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#ifdef _WIN32
+#include <io.h>        // for _write()
+#else
+#include <unistd.h>    // for write()
+#endif
+
+#include "CConsoleBinaryLog.h"
+#include "CConsoleFormat.h"
+#include "CConsoleNumberFormat.h"
+
+/**
+    The flight recorder keeps the most recent log records in a preallocated ring, so they can be written out by a
+    signal handler when the process crashes, even if they were still buffered or queued for the sinks.
+    Records are kept either as plain text, or in binary logging mode unformatted: format string and raw argument
+    values encoded as in the binary log, see CConsoleBinaryLog.h. Those are formatted only when written out.
+
+    Recording doesn't allocate and doesn't lock, but recording threads must be serialized by the caller.
+    Writing out doesn't allocate and doesn't lock either, and it outputs only by write(), so it can be done from a
+    signal handler, even if the crash happened in the middle of recording: torn records are skipped.
+*/
+namespace CConsoleFlightRecorder
+{
+
+    static constexpr std::size_t RECORDS = 256;                 /**< Number of most recent records kept. */
+    static constexpr std::size_t RECORD_SIZE = 256;             /**< Max bytes of a record, longer records are truncated. */
+    static constexpr const char* CRASH_FILE_EXTENSION = ".crash.txt";
+
+    enum class RecordType : std::uint8_t
+    {
+        Text   = 0,   /* plain text of a line */
+        Binary = 1    /* int32 indentation, uint8 flags of CConsoleBinaryLog, zero-terminated format string, raw argument values */
+    };
+
+    /**
+        Slot of the ring.
+    */
+    struct Record
+    {
+        std::atomic<std::size_t> nSeq{0};   /**< 1 + position of the record in the sequence of all records, 0 while being recorded. */
+        RecordType    type{RecordType::Text};
+        std::uint16_t nLength{0};           /**< Number of used bytes of data. */
+        char          data[RECORD_SIZE]{};
+    };
+
+    /**
+        Appends bytes to the data of a record being recorded, as many as fit.
+        @return New length of the data.
+    */
+    inline std::size_t Append(char* data, std::size_t n, const char* bytes, std::size_t len)
+    {
+        const std::size_t nCopy = (len < RECORD_SIZE - n) ? len : (RECORD_SIZE - n);
+        memcpy(data + n, bytes, nCopy);
+        return n + nCopy;
+    }
+
+    /**
+        Appends spaces to the data of a record being recorded, as many as fit.
+        @return New length of the data.
+    */
+    inline std::size_t AppendSpaces(char* data, std::size_t n, std::size_t nSpaces)
+    {
+        const std::size_t nCopy = (nSpaces < RECORD_SIZE - n) ? nSpaces : (RECORD_SIZE - n);
+        memset(data + n, ' ', nCopy);
+        return n + nCopy;
+    }
+
+    /**
+        Writes to a file descriptor thru a small buffer on the stack, using only write().
+    */
+    class FdWriter
+    {
+    public:
+        explicit FdWriter(int nFd) : fd(nFd), n(0) {}
+        ~FdWriter() { Flush(); }
+
+        void Append(const char* text, std::size_t len)
+        {
+            while ( len > 0 )
+            {
+                if ( n == sizeof(buf) )
+                    Flush();
+                const std::size_t nCopy = (len < sizeof(buf) - n) ? len : (sizeof(buf) - n);
+                memcpy(buf + n, text, nCopy);
+                n += nCopy;
+                text += nCopy;
+                len -= nCopy;
+            }
+        }
+
+        void Append(const char* text)
+        {
+            Append(text, strlen(text));
+        }
+
+        void AppendSpaces(std::size_t nSpaces)
+        {
+            static constexpr char spaces[] = "                                ";
+            while ( nSpaces > 0 )
+            {
+                const std::size_t nCopy = (nSpaces < sizeof(spaces) - 1) ? nSpaces : (sizeof(spaces) - 1);
+                Append(spaces, nCopy);
+                nSpaces -= nCopy;
+            }
+        }
+
+        void Flush()
+        {
+            const char* p = buf;
+            while ( n > 0 )
+            {
+#ifdef _WIN32
+                const int nWritten = _write(fd, p, static_cast<unsigned int>(n));
+#else
+                const ssize_t nWritten = write(fd, p, n);
+#endif
+                if ( nWritten <= 0 )
+                    break;
+                p += nWritten;
+                n -= static_cast<std::size_t>(nWritten);
+            }
+            n = 0;
+        }
+
+    private:
+        int fd;
+        std::size_t n;       /**< Number of used bytes of buf. */
+        char buf[512];
+
+        FdWriter(const FdWriter&);
+        FdWriter& operator=(const FdWriter&);
+    };
+
+    /**
+        Writes the value of a placeholder from the raw argument values of a binary record, and advances p.
+        @return False if the value is truncated.
+    */
+    inline bool AppendValue(FdWriter& out, char type, const char*& p, const char* end)
+    {
+        char szNumber[CConsoleNumberFormat::BUFFER_SIZE];
+        switch ( type )
+        {
+        case 's':
+            {
+                std::uint32_t nLength;
+                if ( !CConsoleBinaryLog::Get(p, end, nLength) )
+                    return false;
+                if ( nLength == CConsoleBinaryLog::NULL_STRING )
+                {
+                    out.Append("NULL", 4);
+                    return true;
+                }
+                const std::size_t nAvailable = static_cast<std::size_t>(end - p);
+                out.Append(p, (nLength < nAvailable) ? nLength : nAvailable);
+                if ( nLength > nAvailable )
+                    return false;
+                p += nLength;
+                return true;
+            }
+        case 'i':
+        case 'd':
+            {
+                std::int32_t nValue;
+                if ( !CConsoleBinaryLog::Get(p, end, nValue) )
+                    return false;
+                out.Append(szNumber, CConsoleNumberFormat::FormatInteger(szNumber, nValue));
+                return true;
+            }
+        case 'u':
+            {
+                std::uint32_t nValue;
+                if ( !CConsoleBinaryLog::Get(p, end, nValue) )
+                    return false;
+                out.Append(szNumber, CConsoleNumberFormat::FormatInteger(szNumber, nValue));
+                return true;
+            }
+        case 'D':
+            {
+                std::int64_t nValue;
+                if ( !CConsoleBinaryLog::Get(p, end, nValue) )
+                    return false;
+                out.Append(szNumber, CConsoleNumberFormat::FormatInteger(szNumber, nValue));
+                return true;
+            }
+        case 'U':
+            {
+                std::uint64_t nValue;
+                if ( !CConsoleBinaryLog::Get(p, end, nValue) )
+                    return false;
+                out.Append(szNumber, CConsoleNumberFormat::FormatInteger(szNumber, nValue));
+                return true;
+            }
+        case 'b':
+            {
+                std::uint8_t bValue;
+                if ( !CConsoleBinaryLog::Get(p, end, bValue) )
+                    return false;
+                out.Append(bValue ? "true" : "false");
+                return true;
+            }
+        case 'f':
+            {
+                double fValue;
+                if ( !CConsoleBinaryLog::Get(p, end, fValue) )
+                    return false;
+                out.Append(szNumber, CConsoleNumberFormat::FormatFloat(szNumber, fValue));
+                return true;
+            }
+        default:
+            return true;
+        }
+    }
+
+    /**
+        Formats and writes a binary record.
+        @param data        Data of the record, zero-terminated after nLength bytes.
+        @param bLineStart  True if we are at the start of a line, updated after writing.
+    */
+    inline void AppendBinary(FdWriter& out, const char* data, std::size_t nLength, bool& bLineStart)
+    {
+        const char* p = data;
+        const char* const end = data + nLength;
+        std::int32_t nIndent;
+        std::uint8_t flags;
+        if ( !CConsoleBinaryLog::Get(p, end, nIndent) || !CConsoleBinaryLog::Get(p, end, flags) )
+            return;
+
+        const char* const fmt = p;
+        p += strlen(fmt) + 1;
+        if ( p > end )
+            p = end;
+
+        if ( bLineStart && (nIndent > 0) )
+            out.AppendSpaces(static_cast<std::size_t>(nIndent));
+        bLineStart = false;
+
+        const char* q = fmt;
+        while ( *q )
+        {
+            const char* const percent = strchr(q, '%');
+            if ( percent == NULL )
+            {
+                out.Append(q);
+                break;
+            }
+            out.Append(q, static_cast<std::size_t>(percent - q));
+            if ( !percent[1] )
+                break;
+
+            const std::size_t nPlaceholderLength = CConsoleFormat::placeholderLength(percent + 1);
+            if ( nPlaceholderLength == 0 )
+            {
+                // char after % is printed as it is
+                out.Append(percent + 1, 1);
+                q = percent + 2;
+                continue;
+            }
+            if ( !AppendValue(out, CConsoleFormat::placeholderType(percent + 1), p, end) )
+            {
+                out.Append("...", 3);
+                break;
+            }
+            q = percent + 1 + nPlaceholderLength;
+        }
+
+        if ( flags & CConsoleBinaryLog::FLAG_NEWLINE )
+        {
+            out.Append("\n", 1);
+            bLineStart = true;
+        }
+    }
+
+    /**
+        The ring itself, meant to be a static object so it is preallocated and always available.
+    */
+    class Ring
+    {
+    public:
+        /**
+            Starts recording a record, in place of the oldest one.
+            @return Data of the record, RECORD_SIZE bytes, see Append().
+        */
+        char* Begin(RecordType type)
+        {
+            Record& rec = records[nNext.load(std::memory_order_relaxed) % RECORDS];
+            rec.nSeq.store(0, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            rec.type = type;
+            return rec.data;
+        }
+
+        /**
+            Finishes the record started by Begin().
+            @param nLength Number of used bytes of data.
+        */
+        void End(std::size_t nLength)
+        {
+            const std::size_t n = nNext.load(std::memory_order_relaxed);
+            Record& rec = records[n % RECORDS];
+            rec.nLength = static_cast<std::uint16_t>((nLength < RECORD_SIZE) ? nLength : RECORD_SIZE);
+            rec.nSeq.store(n + 1, std::memory_order_release);
+            nNext.store(n + 1, std::memory_order_release);
+        }
+
+        /**
+            Writes the most recent records as plain text to the given file descriptor, oldest first.
+            Async-signal-safe.
+            @param nMaxRecords Max number of records written.
+        */
+        void Dump(int fd, std::size_t nMaxRecords) const
+        {
+            FdWriter out(fd);
+            const std::size_t nEnd = nNext.load(std::memory_order_acquire);
+            std::size_t nCount = (nMaxRecords < RECORDS) ? nMaxRecords : RECORDS;
+            if ( nCount > nEnd )
+                nCount = nEnd;
+
+            bool bLineStart = true;
+            char data[RECORD_SIZE + 1];
+            for (std::size_t i = nEnd - nCount; i < nEnd; i++)
+            {
+                const Record& rec = records[i % RECORDS];
+                const std::size_t nSeq = rec.nSeq.load(std::memory_order_acquire);
+                const RecordType type = rec.type;
+                const std::size_t nLength = (rec.nLength < RECORD_SIZE) ? rec.nLength : RECORD_SIZE;
+                memcpy(data, rec.data, nLength);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if ( (nSeq != i + 1) || (rec.nSeq.load(std::memory_order_relaxed) != i + 1) )
+                    continue;   // torn by the crash, or already overwritten by a newer record
+                data[nLength] = '\0';
+
+                if ( type == RecordType::Binary )
+                {
+                    AppendBinary(out, data, nLength, bLineStart);
+                    continue;
+                }
+
+                if ( !bLineStart )
+                    out.Append("\n", 1);
+                out.Append(data, nLength);
+                if ( (nLength == 0) || (data[nLength - 1] != '\n') )
+                    out.Append("\n", 1);
+                bLineStart = true;
+            }
+            if ( !bLineStart )
+                out.Append("\n", 1);
+        }
+
+    private:
+        Record records[RECORDS];
+        std::atomic<std::size_t> nNext{0};   /**< Position of the next record in the sequence of all records. */
+    };
+
+} // namespace CConsoleFlightRecorder
\ No newline at end of file
@@ -0,0 +1,331 @@
+#pragma once
+
+/*
+    ###################################################################################
+    CConsoleFormat.h
+    Compile-time parsed format strings for CConsole.
+    Made by PR00F88
+    ###################################################################################
+*/
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+/**
+    Wraps a string literal into a compile-time format string for the template overloads of CConsole::O(), OLn(), etc.
+    The format string is split into literal runs and placeholders at compile time, and the types of the arguments
+    are checked against the placeholders at compile time, e.g.:
+        con.OLn(CCONSOLE_FMT("%s is %d years old"), "Joe", 25);
+    Same placeholders can be used as with the non-template functions: %s, %d, %i, %u, %lld, %lli, %llu, %b, %f.
+    Any other char after % is printed as it is, so %% prints a single %.
+*/
+#define CCONSOLE_FMT(fmtLiteral)                                                  \
+    ([] {                                                                         \
+        struct CConsoleFormatLiteral : CConsoleFormat::Tag                        \
+        {                                                                         \
+            static constexpr const char* str() { return fmtLiteral; }             \
+        };                                                                        \
+        return CConsoleFormatLiteral{};                                           \
+    }())
+
+namespace CConsoleFormat
+{
+
+    /**
+        Base of the types created by CCONSOLE_FMT(), this is how CConsole recognizes compile-time format strings.
+    */
+    struct Tag {};
+
+    template <class Fmt>
+    using EnableIfFormat = std::enable_if_t<std::is_base_of_v<Tag, Fmt>, int>;
+
+    /**
+        Part of a format string: either a run of literal chars or a placeholder.
+    */
+    struct Segment
+    {
+        char        type;      /**< 0 for literal run, otherwise the placeholder type, see placeholderType(). */
+        std::size_t nOffset;   /**< Literal run only: offset of 1st char in the format string. */
+        std::size_t nLength;   /**< Literal run only: number of chars. */
+    };
+
+    /**
+        Result of parsing a format string, this is what CConsole needs at runtime.
+    */
+    struct Format
+    {
+        const char*    text;           /**< The format string itself. */
+        const Segment* segments;       /**< Literal runs and placeholders in order. */
+        std::size_t    nSegments;      /**< Number of segments. */
+        bool           bLiteralOnly;   /**< True if text doesn't contain any %, so it can be printed as it is. */
+        bool           bNewLine;       /**< True if text contains a new line. */
+    };
+
+    /**
+        Argument of a placeholder, already converted to the type expected by the placeholder.
+    */
+    struct Arg
+    {
+        char type;   /**< The placeholder type, see placeholderType(). */
+        union
+        {
+            const char*        s;
+            int                i;
+            unsigned int       u;
+            long long          ll;
+            unsigned long long ull;
+            bool               b;
+            double             f;
+        } value;      /**< Value, member is selected by type. */
+    };
+
+    /**
+        Tells the length of the placeholder starting after a %.
+        @return 0 if there is no placeholder there.
+    */
+    constexpr std::size_t placeholderLength(const char* p)
+    {
+        if ( (p[0] == 'l') && (p[1] == 'l') && ((p[2] == 'd') || (p[2] == 'i') || (p[2] == 'u')) )
+            return 3;
+        if ( (p[0] == 's') || (p[0] == 'd') || (p[0] == 'i') || (p[0] == 'u') || (p[0] == 'b') || (p[0] == 'f') )
+            return 1;
+        return 0;
+    }
+
+    /**
+        Tells the type of the placeholder starting after a %.
+        @return The placeholder char itself for single-char placeholders, 'D' for %lld and %lli, 'U' for %llu.
+    */
+    constexpr char placeholderType(const char* p)
+    {
+        if ( placeholderLength(p) == 3 )
+            return (p[2] == 'u') ? 'U' : 'D';
+        return p[0];
+    }
+
+    /**
+        Splits the format string into segments.
+        @param out If not NULL, segments are written here.
+        @return Number of segments.
+    */
+    constexpr std::size_t parse(const char* fmt, Segment* out)
+    {
+        std::size_t n = 0;
+        bool bInLiteral = false;
+        std::size_t i = 0;
+        while ( fmt[i] )
+        {
+            if ( fmt[i] == '%' )
+            {
+                if ( placeholderLength(fmt + i + 1) > 0 )
+                {
+                    if ( out )
+                        out[n] = Segment{ placeholderType(fmt + i + 1), 0, 0 };
+                    n++;
+                    bInLiteral = false;
+                    i += 1 + placeholderLength(fmt + i + 1);
+                    continue;
+                }
+                // char after % is printed as literal, and it starts a new literal run
+                bInLiteral = false;
+                i++;
+                if ( !fmt[i] )
+                    break;
+            }
+
+            if ( !bInLiteral )
+            {
+                if ( out )
+                    out[n] = Segment{ 0, i, 0 };
+                n++;
+                bInLiteral = true;
+            }
+            if ( out )
+                out[n-1].nLength++;
+            i++;
+        }
+        return n;
+    }
+
+    constexpr std::size_t countPlaceholders(const char* fmt)
+    {
+        std::size_t n = 0;
+        for (std::size_t i = 0; fmt[i]; i++)
+        {
+            if ( fmt[i] == '%' )
+            {
+                if ( placeholderLength(fmt + i + 1) > 0 )
+                    n++;
+                if ( fmt[i+1] )
+                    i++;
+            }
+        }
+        return n;
+    }
+
+    constexpr bool contains(const char* fmt, char c)
+    {
+        for (std::size_t i = 0; fmt[i]; i++)
+        {
+            if ( fmt[i] == c )
+                return true;
+        }
+        return false;
+    }
+
+    /** Tells if the format string ends with a single %, which would print garbage with the non-template functions. */
+    constexpr bool hasDanglingPercent(const char* fmt)
+    {
+        for (std::size_t i = 0; fmt[i]; i++)
+        {
+            if ( fmt[i] == '%' )
+            {
+                if ( !fmt[i+1] )
+                    return true;
+                i++;
+            }
+        }
+        return false;
+    }
+
+    /**
+        Tells if an argument of type T can be printed with the given placeholder without any loss.
+    */
+    template <class T>
+    constexpr bool isArgOk(char type)
+    {
+        using U = std::decay_t<T>;
+        constexpr bool bInt = std::is_integral_v<U> && !std::is_same_v<U, bool>;
+        switch ( type )
+        {
+        case 's':
+            return std::is_convertible_v<U, const char*>;
+        case 'd':
+        case 'i':
+            return bInt && ( (sizeof(U) < sizeof(int)) || ((sizeof(U) == sizeof(int)) && std::is_signed_v<U>) );
+        case 'u':
+            return bInt && std::is_unsigned_v<U> && (sizeof(U) <= sizeof(unsigned int));
+        case 'D':
+            return bInt && ( (sizeof(U) < sizeof(long long)) || std::is_signed_v<U> );
+        case 'U':
+            return bInt && std::is_unsigned_v<U>;
+        case 'b':
+            return std::is_same_v<U, bool>;
+        case 'f':
+            return std::is_floating_point_v<U>;
+        default:
+            return false;
+        }
+    }
+
+    template <std::size_t N>
+    struct SegmentArray
+    {
+        Segment segment[N > 0 ? N : 1];
+    };
+
+    template <std::size_t N>
+    struct PlaceholderArray
+    {
+        char type[N > 0 ? N : 1];
+    };
+
+    template <std::size_t N>
+    struct ArgArray
+    {
+        Arg arg[N > 0 ? N : 1];
+    };
+
+    template <std::size_t N>
+    constexpr SegmentArray<N> parseSegments(const char* fmt)
+    {
+        SegmentArray<N> segments{};
+        parse(fmt, segments.segment);
+        return segments;
+    }
+
+    template <std::size_t N>
+    constexpr PlaceholderArray<N> parsePlaceholders(const SegmentArray<N>& segments, std::size_t nSegments)
+    {
+        PlaceholderArray<N> placeholders{};
+        std::size_t n = 0;
+        for (std::size_t i = 0; i < nSegments; i++)
+        {
+            if ( segments.segment[i].type != 0 )
+                placeholders.type[n++] = segments.segment[i].type;
+        }
+        return placeholders;
+    }
+
+    /**
+        Everything known about a format string at compile time.
+    */
+    template <class Fmt>
+    struct Parsed
+    {
+        static constexpr const char* text = Fmt::str();
+        static_assert(!hasDanglingPercent(text), "CCONSOLE_FMT: format string must not end with a single %");
+
+        static constexpr std::size_t nSegments = parse(text, nullptr);
+        static constexpr std::size_t nPlaceholders = countPlaceholders(text);
+        static constexpr SegmentArray<nSegments> segments = parseSegments<nSegments>(text);
+        static constexpr PlaceholderArray<nSegments> placeholders = parsePlaceholders<nSegments>(segments, nSegments);
+        static constexpr Format format{ text, segments.segment, nSegments, !contains(text, '%'), contains(text, '\n') };
+    };
+
+    template <char C, class T>
+    inline Arg makeArg(const T& value)
+    {
+        Arg arg;
+        arg.type = C;
+        if constexpr ( C == 's' )
+            arg.value.s = value;
+        else if constexpr ( (C == 'd') || (C == 'i') )
+            arg.value.i = static_cast<int>(value);
+        else if constexpr ( C == 'u' )
+            arg.value.u = static_cast<unsigned int>(value);
+        else if constexpr ( C == 'D' )
+            arg.value.ll = static_cast<long long>(value);
+        else if constexpr ( C == 'U' )
+            arg.value.ull = static_cast<unsigned long long>(value);
+        else if constexpr ( C == 'b' )
+            arg.value.b = value;
+        else
+            arg.value.f = static_cast<double>(value);
+        return arg;
+    }
+
+    template <class Fmt, class... Args, std::size_t... I>
+    constexpr bool areArgsOk(std::index_sequence<I...>)
+    {
+        return ( true && ... && isArgOk<Args>(Parsed<Fmt>::placeholders.type[I]) );
+    }
+
+    template <class Fmt, class... Args, std::size_t... I>
+    inline ArgArray<sizeof...(Args)> makeArgsInOrder(std::index_sequence<I...>, const Args&... args)
+    {
+        return ArgArray<sizeof...(Args)>{ { makeArg<Parsed<Fmt>::placeholders.type[I]>(args)... } };
+    }
+
+    /**
+        Checks the arguments against the placeholders at compile time and converts them for CConsole.
+    */
+    template <class Fmt, class... Args>
+    inline ArgArray<sizeof...(Args)> makeArgs(const Args&... args)
+    {
+        constexpr bool bCountOk = (Parsed<Fmt>::nPlaceholders == sizeof...(Args));
+        static_assert(bCountOk, "CCONSOLE_FMT: number of arguments doesn't match number of placeholders in format string");
+        if constexpr ( bCountOk )
+        {
+            static_assert(areArgsOk<Fmt, Args...>(std::index_sequence_for<Args...>{}),
+                "CCONSOLE_FMT: type of an argument doesn't match its placeholder in format string");
+            return makeArgsInOrder<Fmt>(std::index_sequence_for<Args...>{}, args...);
+        }
+        else
+        {
+            return ArgArray<sizeof...(Args)>{};
+        }
+    }
+
+} // namespace CConsoleFormat
\ No newline at end of file
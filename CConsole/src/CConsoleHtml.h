@@ -0,0 +1,233 @@
+#pragma once
+
+/*
+    ###################################################################################
+    CConsoleHtml.h
+    Compact html rendering helpers of CConsole.
+    Made by PR00F88
+    ###################################################################################
+*/
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define CCONSOLE_HTML_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define CCONSOLE_HTML_SSE2
+#endif
+
+#if defined(_MSC_VER) && (defined(CCONSOLE_HTML_AVX2) || defined(CCONSOLE_HTML_SSE2))
+#include <intrin.h>
+#endif
+
+/**
+    In compact html mode, log lines are written into <pre> blocks so spaces and new lines need no markup, and colors
+    are referenced by short css class names defined once in the <style> block of the html header, e.g.:
+        <pre>Loading <i class=v>bitmap.bmp</i>
+        <i class=e>Couldn't load file: <i class=y>bitmap.bmp</i></i>
+        </pre>
+    Colors without a class are written with inline style.
+*/
+namespace CConsoleHtml
+{
+
+    /**
+        Css class of a html color.
+    */
+    struct ColorClass
+    {
+        const char* clrHtml;   /**< Html color, as given to CConsole, without #. */
+        const char* name;      /**< Css class name. */
+    };
+
+    /** Classes of the colors used by CConsole by default. */
+    static constexpr ColorClass COLOR_CLASSES[] =
+    {
+        { "999999", "v" },   /* values in normal mode */
+        { "FF0000", "e" },   /* error mode */
+        { "DDDD00", "y" },   /* strings in error mode */
+        { "00DD00", "s" },   /* success mode */
+        { "00FF00", "g" },   /* strings in success mode */
+        { "FFFF00", "n" }    /* numbers and bools in error and success mode */
+    };
+
+    /** Max number of lines in a <pre> block, a new block is started after this many lines. */
+    static constexpr std::size_t PRE_BLOCK_LINES = 1000;
+
+    /** Length of "&nbsp;". */
+    static constexpr std::size_t NBSP_LENGTH = 6;
+
+    /**
+        Appends the <style> block defining the css classes of the compact html mode to out.
+    */
+    inline void AppendStyle(std::string& out)
+    {
+        out += "<style>\n";
+        out += "pre{font-family:Courier,monospace;font-size:small;margin:0}\n";
+        out += "i{font-style:normal}\n";
+        for (const auto& clrClass : COLOR_CLASSES)
+        {
+            out += '.';
+            out += clrClass.name;
+            out += "{color:#";
+            out += clrClass.clrHtml;
+            out += "}\n";
+        }
+        out += "</style>\n";
+    }
+
+    /**
+        Appends the opening tag selecting the given html color to out: <i class=x> if the color has a class,
+        <i style=color:#RRGGBB> otherwise.
+    */
+    inline void AppendColorTag(std::string& out, const char* clrHtml)
+    {
+        for (const auto& clrClass : COLOR_CLASSES)
+        {
+            if ( strcmp(clrClass.clrHtml, clrHtml) == 0 )
+            {
+                out += "<i class=";
+                out += clrClass.name;
+                out += '>';
+                return;
+            }
+        }
+        out += "<i style=color:#";
+        out += clrHtml;
+        out += '>';
+    }
+
+    /**
+        Appends n non-breakable spaces to out, in chunks of a precomputed run instead of one by one.
+    */
+    inline void AppendNbsp(std::string& out, std::size_t n)
+    {
+        static constexpr char nbsp[] =
+            "&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;"
+            "&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;";
+        static constexpr std::size_t nNbspCount = (sizeof(nbsp) - 1) / NBSP_LENGTH;
+
+        while ( n > nNbspCount )
+        {
+            out.append(nbsp, nNbspCount * NBSP_LENGTH);
+            n -= nNbspCount;
+        }
+        out.append(nbsp, n * NBSP_LENGTH);
+    }
+
+    /** Index of lowest set bit, mask must not be 0. */
+    inline unsigned int lowestBit(unsigned int mask)
+    {
+#if defined(_MSC_VER)
+        unsigned long nIndex;
+        _BitScanForward(&nIndex, mask);
+        return static_cast<unsigned int>(nIndex);
+#else
+        return static_cast<unsigned int>(__builtin_ctz(mask));
+#endif
+    }
+
+    /**
+        Finds the first char needing escaping: <, > or &, or if bSpaceRuns is true, the first space followed by
+        another space.
+        Checks 32 or 16 chars at once with AVX2 or SSE2 if available, char by char otherwise.
+        @return Pointer to the found char, end if there is no such char.
+    */
+    inline const char* findSpecial(const char* p, const char* end, bool bSpaceRuns)
+    {
+#if defined(CCONSOLE_HTML_AVX2)
+        const __m256i vLt = _mm256_set1_epi8('<');
+        const __m256i vGt = _mm256_set1_epi8('>');
+        const __m256i vAmp = _mm256_set1_epi8('&');
+        const __m256i vSpace = _mm256_set1_epi8(bSpaceRuns ? ' ' : '<');
+        // 1 more char is loaded for checking if a space is followed by another space
+        while ( end - p > 32 )
+        {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            const __m256i vNext = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1));
+            const __m256i vFound = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, vLt), _mm256_cmpeq_epi8(v, vGt)),
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, vAmp),
+                    _mm256_and_si256(_mm256_cmpeq_epi8(v, vSpace), _mm256_cmpeq_epi8(vNext, vSpace))));
+            const unsigned int mask = static_cast<unsigned int>(_mm256_movemask_epi8(vFound));
+            if ( mask != 0 )
+                return p + lowestBit(mask);
+            p += 32;
+        }
+#elif defined(CCONSOLE_HTML_SSE2)
+        const __m128i vLt = _mm_set1_epi8('<');
+        const __m128i vGt = _mm_set1_epi8('>');
+        const __m128i vAmp = _mm_set1_epi8('&');
+        const __m128i vSpace = _mm_set1_epi8(bSpaceRuns ? ' ' : '<');
+        // 1 more char is loaded for checking if a space is followed by another space
+        while ( end - p > 16 )
+        {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            const __m128i vNext = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+            const __m128i vFound = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(v, vLt), _mm_cmpeq_epi8(v, vGt)),
+                _mm_or_si128(_mm_cmpeq_epi8(v, vAmp),
+                    _mm_and_si128(_mm_cmpeq_epi8(v, vSpace), _mm_cmpeq_epi8(vNext, vSpace))));
+            const unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(vFound));
+            if ( mask != 0 )
+                return p + lowestBit(mask);
+            p += 16;
+        }
+#endif
+        for ( ; p < end; ++p)
+        {
+            if ( (*p == '<') || (*p == '>') || (*p == '&') )
+                return p;
+            if ( bSpaceRuns && (*p == ' ') && (p + 1 < end) && (p[1] == ' ') )
+                return p;
+        }
+        return end;
+    }
+
+    /**
+        Appends text to out, with <, > and & escaped.
+        If bSpaceRuns is true, runs of 2 or more spaces are appended as non-breakable spaces so the browser keeps them,
+        single spaces are kept as they are. Not needed inside <pre> blocks.
+        Text between the chars needing escaping is appended in one go.
+    */
+    inline void AppendEscaped(std::string& out, const char* text, std::size_t len, bool bSpaceRuns)
+    {
+        const char* p = text;
+        const char* const end = text + len;
+        while ( p < end )
+        {
+            const char* const q = findSpecial(p, end, bSpaceRuns);
+            out.append(p, static_cast<std::size_t>(q - p));
+            if ( q == end )
+                break;
+
+            switch ( *q )
+            {
+            case '<':
+                out += "&lt;";
+                p = q + 1;
+                break;
+            case '>':
+                out += "&gt;";
+                p = q + 1;
+                break;
+            case '&':
+                out += "&amp;";
+                p = q + 1;
+                break;
+            default:
+                {
+                    p = q;
+                    while ( (p < end) && (*p == ' ') )
+                        ++p;
+                    AppendNbsp(out, static_cast<std::size_t>(p - q));
+                }
+            }
+        }
+    }
+
+} // namespace CConsoleHtml
\ No newline at end of file
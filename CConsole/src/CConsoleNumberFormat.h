@@ -0,0 +1,58 @@
+#pragma once
+
+/*
+    ###################################################################################
+    CConsoleNumberFormat.h
+    Allocation-free and locale-independent number formatting for CConsole.
+    Made by PR00F88
+    ###################################################################################
+*/
+
+#include <charconv>            // requires cpp17
+#include <cstddef>
+#include <limits>
+
+namespace CConsoleNumberFormat
+{
+
+    static constexpr int FLOAT_DECIMALS = 4;   /**< Floating-point values are formatted with this many decimals before trimming. */
+
+    /**
+        Size of buffer big enough for any number formatted by this module, including terminating zero.
+        Longest is the biggest negative double in fixed notation: sign + integral digits + dot + decimals.
+    */
+    static constexpr std::size_t BUFFER_SIZE = 1 + (std::numeric_limits<double>::max_exponent10 + 1) + 1 + FLOAT_DECIMALS + 1;
+
+    /**
+        Formats an integer in decimal.
+        @param buf Buffer of at least BUFFER_SIZE chars, result is zero-terminated.
+        @return Length of result, without the terminating zero.
+    */
+    template <class T>
+    inline std::size_t FormatInteger(char* buf, T n)
+    {
+        const std::to_chars_result res = std::to_chars(buf, buf + BUFFER_SIZE - 1, n);
+        *res.ptr = '\0';
+        return static_cast<std::size_t>(res.ptr - buf);
+    }
+
+    /**
+        Formats a floating-point value in fixed notation with at most FLOAT_DECIMALS decimals.
+        Same as sprintf("%0.4f") then trimming trailing zeros as CConsole always did, e.g. 5.3 -> "5.3", 5.0 -> "5.",
+        but this one doesn't depend on the locale.
+        @param buf Buffer of at least BUFFER_SIZE chars, result is zero-terminated.
+        @return Length of result, without the terminating zero.
+    */
+    inline std::size_t FormatFloat(char* buf, double f)
+    {
+        const std::to_chars_result res = std::to_chars(buf, buf + BUFFER_SIZE - 1, f, std::chars_format::fixed, FLOAT_DECIMALS);
+        std::size_t len = static_cast<std::size_t>(res.ptr - buf);
+        while ( (len > 0) && (buf[len-1] == '0') )
+        {
+            len--;
+        }
+        buf[len] = '\0';
+        return len;
+    }
+
+} // namespace CConsoleNumberFormat
\ No newline at end of file
@@ -0,0 +1,194 @@
+#pragma once
+
+/*
+    ###################################################################################
+    CConsoleRateLimit.h
+    Per-call-site rate limiting and sampling for the rate-limited log macros of CConsole.
+    Made by PR00F88
+    ###################################################################################
+*/
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+/**
+    Logs printed once per frame or per packet would produce millions of lines when their logger module is enabled.
+    The rate-limited log macros, e.g. CCONSOLE_DEBUG_LIMITED() and CCONSOLE_DEBUG_SAMPLED(), keep a Site in static
+    storage at the call site, and decide by a single atomic read-modify-write on it and a read of the steady clock
+    whether the log is printed, before taking the lock of CConsole and before formatting anything.
+    Number of dropped logs is reported by the next printed log of the same site, at most once per second.
+    A site dropping logs is also put on the list of registeredSites, so its drops are reported by CConsole even if
+    the site gets no more calls, see takeDrops().
+*/
+namespace CConsoleRateLimit
+{
+
+    /**
+        State of a call site, meant to be a static object so it is constant-initialized without any guard.
+    */
+    struct Site
+    {
+        constexpr Site(const char* file, int line, int mode) :
+            szFile(file),
+            nLine(line),
+            nMode(mode)
+        {}
+
+        const char* const szFile;                      /**< Source file of the call site. */
+        const int nLine;                               /**< Source line of the call site. */
+        const int nMode;                               /**< CConsole::FormatSignal of the logs of the call site. */
+        std::atomic<std::uint64_t> nState{0};          /**< Rate limit: window in upper 32 bits, calls in the window in lower 32 bits. Sampling: calls so far. */
+        std::atomic<std::uint32_t> nReportWindow{0};   /**< Sampling only: window of the last report of dropped logs. */
+        std::atomic<std::uint64_t> nReportedDrops{0};  /**< Sampling only: number of dropped logs already reported. */
+        std::atomic<bool> bRegistered{false};          /**< Set when the site is put on registeredSites. */
+        bool bSampled{false};                          /**< Sampling or rate limit, set before the site is put on registeredSites. */
+        std::uint32_t nLimit{0};                       /**< Limit of the first dropped log, set before the site is put on registeredSites. */
+        Site* pNext{nullptr};                          /**< Next site on registeredSites. */
+    };
+
+    /**
+        Sites that dropped logs, newest first. Sites are never removed, since they are static objects.
+    */
+    inline std::atomic<Site*> registeredSites{nullptr};
+
+    /**
+        Gets the current window: seconds elapsed on the steady clock.
+    */
+    inline std::uint32_t currentWindow()
+    {
+        return static_cast<std::uint32_t>(
+            std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    /**
+        Puts the site on registeredSites at its first dropped log, later this costs a single atomic load.
+    */
+    inline void registerSite(Site& site, bool bSampled, std::uint32_t nLimit)
+    {
+        if ( site.bRegistered.load(std::memory_order_relaxed) || site.bRegistered.exchange(true, std::memory_order_relaxed) )
+            return;
+
+        site.bSampled = bSampled;
+        site.nLimit = nLimit;
+        Site* pHead = registeredSites.load(std::memory_order_relaxed);
+        do
+        {
+            site.pNext = pHead;
+        } while ( !registeredSites.compare_exchange_weak(pHead, &site, std::memory_order_release, std::memory_order_relaxed) );
+    }
+
+    /**
+        Takes the number of dropped logs of a sampling site not yet reported.
+        Reports are made by the accepted logs of the site and by takeDrops(), the number only grows, so whichever
+        reports the bigger number takes the difference.
+    */
+    inline std::uint64_t takeSampledDrops(Site& site, std::uint64_t nDroppedSoFar)
+    {
+        std::uint64_t nReported = site.nReportedDrops.load(std::memory_order_relaxed);
+        while ( nReported < nDroppedSoFar )
+        {
+            if ( site.nReportedDrops.compare_exchange_weak(nReported, nDroppedSoFar, std::memory_order_relaxed) )
+                return nDroppedSoFar - nReported;
+        }
+        return 0;
+    }
+
+    /**
+        Tells if a log of the call site can be printed, at most nMaxPerSec logs are accepted per second.
+        A rejected log costs a single fetch_add, only the first log of every second needs compare-and-swap.
+        @param nDropped Set to the number of logs rejected in the previous window if this is the first log of a new
+                        window, left untouched otherwise.
+    */
+    inline bool acceptRate(Site& site, std::uint32_t nMaxPerSec, std::uint64_t& nDropped)
+    {
+        const std::uint32_t nWindow = currentWindow();
+        std::uint64_t nState = site.nState.load(std::memory_order_relaxed);
+        // windows are compared by difference so a window already started by another thread is never replaced by an older one
+        while ( static_cast<std::int32_t>(static_cast<std::uint32_t>(nState >> 32) - nWindow) < 0 )
+        {
+            if ( site.nState.compare_exchange_weak(nState, (static_cast<std::uint64_t>(nWindow) << 32) | 1, std::memory_order_relaxed) )
+            {
+                const std::uint32_t nCalls = static_cast<std::uint32_t>(nState);
+                nDropped = (nCalls > nMaxPerSec) ? (nCalls - nMaxPerSec) : 0;
+                if ( nMaxPerSec > 0 )
+                    return true;
+
+                registerSite(site, false, nMaxPerSec);
+                return false;
+            }
+        }
+
+        nState = site.nState.fetch_add(1, std::memory_order_relaxed);
+        if ( static_cast<std::uint32_t>(nState) < nMaxPerSec )
+            return true;
+
+        registerSite(site, false, nMaxPerSec);
+        return false;
+    }
+
+    /**
+        Tells if a log of the call site can be printed, 1 log is accepted out of every nEvery logs, starting with the first.
+        A rejected log costs a single fetch_add.
+        @param nDropped Set to the number of logs rejected since the last report if the accepted log should report
+                        them, that is at most once per second, left untouched otherwise.
+    */
+    inline bool acceptSample(Site& site, std::uint32_t nEvery, std::uint64_t& nDropped)
+    {
+        if ( nEvery <= 1 )
+            return true;
+
+        const std::uint64_t nCall = site.nState.fetch_add(1, std::memory_order_relaxed);
+        if ( (nCall % nEvery) != 0 )
+        {
+            registerSite(site, true, nEvery);
+            return false;
+        }
+
+        const std::uint32_t nWindow = currentWindow();
+        std::uint32_t nReportWindow = site.nReportWindow.load(std::memory_order_relaxed);
+        if ( (nReportWindow != nWindow) && site.nReportWindow.compare_exchange_strong(nReportWindow, nWindow, std::memory_order_relaxed) )
+        {
+            // every nEvery-th call was accepted before this one
+            nDropped = takeSampledDrops(site, nCall - nCall / nEvery);
+        }
+        return true;
+    }
+
+    /**
+        Takes the number of dropped logs of a registered site not yet reported, if the site had no chance to report
+        them by itself, since it got no calls for nIdleWindows windows.
+        @param nIdleWindows Number of windows the site should be idle for, 0 to take the dropped logs of any site,
+                            e.g. when the console is shut down.
+    */
+    inline std::uint64_t takeDrops(Site& site, std::uint32_t nIdleWindows)
+    {
+        const std::uint32_t nWindow = currentWindow();
+        if ( site.bSampled )
+        {
+            std::uint32_t nReportWindow = site.nReportWindow.load(std::memory_order_relaxed);
+            if ( (static_cast<std::int32_t>(nWindow - nReportWindow) < static_cast<std::int32_t>(nIdleWindows)) ||
+                 !site.nReportWindow.compare_exchange_strong(nReportWindow, nWindow, std::memory_order_relaxed) )
+            {
+                return 0;
+            }
+
+            // calls so far, rounded up to whole periods of nLimit, are the accepted ones
+            const std::uint64_t nCalls = site.nState.load(std::memory_order_relaxed);
+            return takeSampledDrops(site, nCalls - (nCalls + site.nLimit - 1) / site.nLimit);
+        }
+
+        // a new window is started with no calls in it, the calls of the taken window are reported here
+        std::uint64_t nState = site.nState.load(std::memory_order_relaxed);
+        while ( static_cast<std::int32_t>(nWindow - static_cast<std::uint32_t>(nState >> 32)) >= static_cast<std::int32_t>(nIdleWindows) )
+        {
+            if ( site.nState.compare_exchange_weak(nState, static_cast<std::uint64_t>(nWindow) << 32, std::memory_order_relaxed) )
+            {
+                const std::uint32_t nCalls = static_cast<std::uint32_t>(nState);
+                return (nCalls > site.nLimit) ? (nCalls - site.nLimit) : 0;
+            }
+        }
+        return 0;
+    }
+
+} // namespace CConsoleRateLimit
\ No newline at end of file
@@ -0,0 +1,381 @@
+/*
+    ###################################################################################
+    CConsoleStress.cpp
+    Stress test and benchmark of CConsole: thread churn and long sustained logging.
+    Made by PR00F88
+    ###################################################################################
+*/
+
+#include "CConsole.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>              // requires cpp11
+#include <chrono>              // requires cpp11
+#include <cstdint>
+#include <thread>              // requires cpp11
+#include <vector>
+
+#ifdef _WIN32
+#include "../../../PFL/PFL/winproof88.h"
+#include <psapi.h>             // for GetProcessMemoryInfo()
+#else
+#include <unistd.h>            // for sysconf()
+#endif
+
+namespace
+{
+
+    /**
+        Command line options, see PrintUsage().
+    */
+    struct Options
+    {
+        int  nChurnThreads{10000};   /**< Number of short-lived threads in the churn phase. */
+        int  nChurnBatch{16};        /**< Number of short-lived threads running at the same time. */
+        int  nLoggingThreads{8};     /**< Number of threads logging continuously in the sustained phase. */
+        int  nSeconds{60};           /**< Duration of the sustained phase. */
+        int  nReportSeconds{5};      /**< Time between reports in the sustained phase. */
+        bool bAsync{false};          /**< Async logging, see CConsole::SetAsyncLogging(). */
+        bool bHtml{false};           /**< Write html log file instead of null sink. */
+        bool bConsole{false};        /**< Log to console too, otherwise headless. */
+    };
+
+    /**
+        Latency of logging calls, updated lock-free by the logging threads and read by the reporting main thread.
+    */
+    struct Latency
+    {
+        std::atomic<std::uint64_t> nCalls{0};
+        std::atomic<std::uint64_t> nSumNanosecs{0};
+        std::atomic<std::uint64_t> nMaxNanosecs{0};   /**< Max since the last report, reset by the reporter. */
+
+        void Add(std::uint64_t nNanosecs)
+        {
+            nCalls.fetch_add(1, std::memory_order_relaxed);
+            nSumNanosecs.fetch_add(nNanosecs, std::memory_order_relaxed);
+            std::uint64_t nMax = nMaxNanosecs.load(std::memory_order_relaxed);
+            while ( (nNanosecs > nMax) && !nMaxNanosecs.compare_exchange_weak(nMax, nNanosecs, std::memory_order_relaxed) )
+            {
+            }
+        }
+    };
+
+    /**
+        Snapshot of a Latency, for calculating the values of a report interval.
+    */
+    struct LatencySnapshot
+    {
+        std::uint64_t nCalls{0};
+        std::uint64_t nSumNanosecs{0};
+    };
+
+    /**
+        Gets the resident set size of the process in KB, 0 if it cannot be queried.
+    */
+    unsigned long long getRssKB()
+    {
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS pmc;
+        if ( !GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)) )
+            return 0;
+        return static_cast<unsigned long long>(pmc.WorkingSetSize) / 1024;
+#else
+        FILE* const f = fopen("/proc/self/statm", "r");
+        if ( !f )
+            return 0;
+        unsigned long long nPagesTotal = 0;
+        unsigned long long nPagesResident = 0;
+        const int nRead = fscanf(f, "%llu %llu", &nPagesTotal, &nPagesResident);
+        fclose(f);
+        if ( nRead != 2 )
+            return 0;
+        return nPagesResident * static_cast<unsigned long long>(sysconf(_SC_PAGESIZE)) / 1024;
+#endif
+    }
+
+    unsigned long long getThreadStates(const CConsole& con)
+    {
+        return con.getStats().nThreadStates;
+    }
+
+    double getSecondsSince(const std::chrono::steady_clock::time_point& timeStart)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - timeStart).count();
+    }
+
+    /**
+        Invokes a logging function and adds its duration to lat.
+    */
+    template <class F>
+    void Timed(Latency& lat, F func)
+    {
+        const auto timeStart = std::chrono::steady_clock::now();
+        func();
+        lat.Add(static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - timeStart).count()));
+    }
+
+    /**
+        Logs a few lines in the typical ways: runtime and compile-time format, partial line, operator<<, modes and indentation.
+    */
+    void LogSome(CConsole& con, int nThread, unsigned long long nIteration, Latency& lat)
+    {
+        Timed(lat, [&] { con.OLn("Thread %d iteration %llu: %s %f %b", nThread, nIteration, "some text", 1.5, true); });
+        Timed(lat, [&] { con.O("Partial line of thread %d, ", nThread); });
+        Timed(lat, [&] { con.OLn(CCONSOLE_FMT("finished with compile-time format: %d %llu"), nThread, nIteration); });
+        Timed(lat, [&] { con.Indent(); });
+        Timed(lat, [&] { con << "Indented value: " << static_cast<int>(nIteration % 1000) << CConsole::NL; });
+        Timed(lat, [&] { con.Outdent(); });
+        if ( (nIteration % 16) == 0 )
+        {
+            Timed(lat, [&] { con.EOLn("Error line of thread %d, iteration %llu", nThread, nIteration); });
+            Timed(lat, [&] { con.SOLn("Success line of thread %d, iteration %llu", nThread, nIteration); });
+        }
+    }
+
+    /**
+        Body of a short-lived thread: initializes, logs a few lines and deinitializes CConsole, then exits.
+    */
+    void ShortLivedThread(int nThread, Latency& lat)
+    {
+        CConsole& con = CConsole::getConsoleInstance();
+        con.Initialize("", false);
+        for (unsigned long long i = 0; i < 4; i++)
+        {
+            LogSome(con, nThread, i, lat);
+        }
+        con.Deinitialize();
+    }
+
+    /**
+        Spawns and joins short-lived threads in batches, nBatch threads at a time.
+        @param nThreads Number of threads to be spawned, negative for spawning until bStop is set.
+    */
+    void RunChurn(int nThreads, int nBatch, Latency& lat, const std::atomic<bool>& bStop, std::atomic<int>& nThreadsDone)
+    {
+        std::vector<std::thread> threads;
+        int nThread = 0;
+        while ( ((nThreads < 0) || (nThread < nThreads)) && !bStop.load(std::memory_order_relaxed) )
+        {
+            threads.clear();
+            for (int i = 0; (i < nBatch) && ((nThreads < 0) || (nThread < nThreads)); i++, nThread++)
+            {
+                threads.emplace_back(ShortLivedThread, nThread, std::ref(lat));
+            }
+            for (auto& thread : threads)
+            {
+                thread.join();
+            }
+            nThreadsDone.fetch_add(static_cast<int>(threads.size()), std::memory_order_relaxed);
+        }
+    }
+
+    /**
+        Body of a long-running logging thread: logs continuously until bStop is set.
+    */
+    void LoggingThread(int nThread, Latency& lat, const std::atomic<bool>& bStop)
+    {
+        CConsole& con = CConsole::getConsoleInstance();
+        con.Initialize("", false);
+        for (unsigned long long i = 0; !bStop.load(std::memory_order_relaxed); i++)
+        {
+            LogSome(con, nThread, i, lat);
+        }
+        con.Deinitialize();
+    }
+
+    /**
+        Prints a report line about the given latency since the given snapshot, and updates the snapshot.
+        @return Average latency in nanosecs since the snapshot.
+    */
+    double Report(
+        const CConsole& con,
+        const char* phase,
+        double fElapsedSecs,
+        double fIntervalSecs,
+        Latency& lat,
+        LatencySnapshot& snapshot,
+        unsigned long long nRssStartKB)
+    {
+        const std::uint64_t nCalls = lat.nCalls.load(std::memory_order_relaxed);
+        const std::uint64_t nSumNanosecs = lat.nSumNanosecs.load(std::memory_order_relaxed);
+        const std::uint64_t nMaxNanosecs = lat.nMaxNanosecs.exchange(0, std::memory_order_relaxed);
+        const std::uint64_t nIntervalCalls = nCalls - snapshot.nCalls;
+        const double fAvgNanosecs = (nIntervalCalls == 0) ? 0.0 : static_cast<double>(nSumNanosecs - snapshot.nSumNanosecs) / static_cast<double>(nIntervalCalls);
+        snapshot.nCalls = nCalls;
+        snapshot.nSumNanosecs = nSumNanosecs;
+
+        const unsigned long long nRssKB = getRssKB();
+        printf("%-9s %8.2f s  calls/s: %10.0f  avg: %8.1f ns  max: %10llu ns  RSS: %8llu KB (%+lld KB)  thread states: %llu\n",
+            phase,
+            fElapsedSecs,
+            (fIntervalSecs > 0.0) ? static_cast<double>(nIntervalCalls) / fIntervalSecs : 0.0,
+            fAvgNanosecs,
+            static_cast<unsigned long long>(nMaxNanosecs),
+            nRssKB,
+            static_cast<long long>(nRssKB) - static_cast<long long>(nRssStartKB),
+            getThreadStates(con));
+        fflush(stdout);
+        return fAvgNanosecs;
+    }
+
+    void PrintUsage(const char* program)
+    {
+        printf("Usage: %s [-churn N] [-batch N] [-threads N] [-seconds N] [-report N] [-async] [-html] [-console]\n", program);
+        printf("  -churn N    number of short-lived threads in the churn phase (default 10000)\n");
+        printf("  -batch N    number of short-lived threads running at the same time (default 16)\n");
+        printf("  -threads N  number of logging threads in the sustained phase (default 8)\n");
+        printf("  -seconds N  duration of the sustained phase (default 60)\n");
+        printf("  -report N   seconds between reports in the sustained phase (default 5)\n");
+        printf("  -async      async logging\n");
+        printf("  -html       write html log file instead of discarding the logs\n");
+        printf("  -console    log to console too, otherwise headless\n");
+    }
+
+    bool ParseOptions(int argc, char* argv[], Options& options)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            const bool bHasValue = (i + 1 < argc);
+            if ( strcmp(argv[i], "-async") == 0 )
+                options.bAsync = true;
+            else if ( strcmp(argv[i], "-html") == 0 )
+                options.bHtml = true;
+            else if ( strcmp(argv[i], "-console") == 0 )
+                options.bConsole = true;
+            else if ( bHasValue && (strcmp(argv[i], "-churn") == 0) )
+                options.nChurnThreads = atoi(argv[++i]);
+            else if ( bHasValue && (strcmp(argv[i], "-batch") == 0) )
+                options.nChurnBatch = atoi(argv[++i]);
+            else if ( bHasValue && (strcmp(argv[i], "-threads") == 0) )
+                options.nLoggingThreads = atoi(argv[++i]);
+            else if ( bHasValue && (strcmp(argv[i], "-seconds") == 0) )
+                options.nSeconds = atoi(argv[++i]);
+            else if ( bHasValue && (strcmp(argv[i], "-report") == 0) )
+                options.nReportSeconds = atoi(argv[++i]);
+            else
+                return false;
+        }
+        return (options.nChurnThreads >= 0) && (options.nChurnBatch > 0) && (options.nLoggingThreads >= 0) &&
+            (options.nSeconds >= 0) && (options.nReportSeconds > 0);
+    }
+
+} // namespace
+
+
+/**
+    Phase 1 spawns and joins thousands of short-lived threads that Initialize(), log and Deinitialize().
+    Phase 2 logs continuously on multiple threads for the given time, while short-lived threads keep coming and going.
+    RSS, number of per-thread log states and latency of logging calls are reported over time: none of them should
+    grow. Logs are discarded by the null sink by default, so the cost of logging itself is measured.
+    @return 0 if no per-thread log state is left behind by the finished threads, 1 otherwise, 2 for bad command line.
+*/
+int main(int argc, char* argv[])
+{
+    Options options;
+    if ( !ParseOptions(argc, argv, options) )
+    {
+        PrintUsage(argv[0]);
+        return 2;
+    }
+
+    CConsole& con = CConsole::getConsoleInstance();
+    con.Initialize("CConsoleStress", options.bHtml, "stress", options.bConsole);
+    if ( !con.isInitialized() )
+    {
+        fprintf(stderr, "ERROR: Couldn't initialize CConsole!\n");
+        return 1;
+    }
+    if ( !options.bHtml )
+    {
+        con.OpenSink(CConsole::Sink::Null);
+    }
+    con.SetAsyncLogging(options.bAsync);
+    con.SetFlushPolicy(CConsole::FlushPolicy::BufferFull);
+    con.ResetStats();
+
+    const unsigned long long nRssStartKB = getRssKB();
+    printf("CConsoleStress: %d short-lived threads in batches of %d, then %d logging threads for %d s, %s, %s\n",
+        options.nChurnThreads, options.nChurnBatch, options.nLoggingThreads, options.nSeconds,
+        options.bAsync ? "async" : "sync", options.bHtml ? "html log file" : "null sink");
+    printf("RSS at start: %llu KB\n", nRssStartKB);
+    fflush(stdout);
+
+    // phase 1: thread churn
+    std::atomic<bool> bStop{false};
+    std::atomic<int> nThreadsDone{0};
+    Latency latChurn;
+    LatencySnapshot snapshotChurn;
+    const auto timeChurnStart = std::chrono::steady_clock::now();
+    double fChurnFirstAvgNanosecs = -1.0;
+    double fChurnLastAvgNanosecs = 0.0;
+    double fLastReportSecs = 0.0;
+    const int nChurnSteps = 10;
+    for (int nStep = 1; nStep <= nChurnSteps; nStep++)
+    {
+        const int nThreads = options.nChurnThreads * nStep / nChurnSteps - options.nChurnThreads * (nStep - 1) / nChurnSteps;
+        RunChurn(nThreads, options.nChurnBatch, latChurn, bStop, nThreadsDone);
+        const double fElapsedSecs = getSecondsSince(timeChurnStart);
+        fChurnLastAvgNanosecs = Report(con, "churn", fElapsedSecs, fElapsedSecs - fLastReportSecs, latChurn, snapshotChurn, nRssStartKB);
+        if ( fChurnFirstAvgNanosecs < 0.0 )
+            fChurnFirstAvgNanosecs = fChurnLastAvgNanosecs;
+        fLastReportSecs = fElapsedSecs;
+    }
+    printf("%d short-lived threads finished, thread states left: %llu\n", nThreadsDone.load(), getThreadStates(con));
+
+    // phase 2: sustained logging with thread churn in the background
+    Latency latSustained;
+    LatencySnapshot snapshotSustained;
+    std::vector<std::thread> loggingThreads;
+    for (int i = 0; i < options.nLoggingThreads; i++)
+    {
+        loggingThreads.emplace_back(LoggingThread, i, std::ref(latSustained), std::cref(bStop));
+    }
+    std::thread churnThread(RunChurn, -1, 4, std::ref(latChurn), std::cref(bStop), std::ref(nThreadsDone));
+
+    const auto timeSustainedStart = std::chrono::steady_clock::now();
+    double fSustainedFirstAvgNanosecs = -1.0;
+    double fSustainedLastAvgNanosecs = 0.0;
+    fLastReportSecs = 0.0;
+    while ( fLastReportSecs < options.nSeconds )
+    {
+        const double fNextReportSecs = (fLastReportSecs + options.nReportSeconds < options.nSeconds) ?
+            (fLastReportSecs + options.nReportSeconds) : static_cast<double>(options.nSeconds);
+        std::this_thread::sleep_until(timeSustainedStart + std::chrono::duration<double>(fNextReportSecs));
+        const double fElapsedSecs = getSecondsSince(timeSustainedStart);
+        fSustainedLastAvgNanosecs = Report(con, "sustained", fElapsedSecs, fElapsedSecs - fLastReportSecs, latSustained, snapshotSustained, nRssStartKB);
+        if ( fSustainedFirstAvgNanosecs < 0.0 )
+            fSustainedFirstAvgNanosecs = fSustainedLastAvgNanosecs;
+        fLastReportSecs = fElapsedSecs;
+    }
+
+    bStop = true;
+    for (auto& thread : loggingThreads)
+    {
+        thread.join();
+    }
+    churnThread.join();
+    con.Flush();
+
+    // only main thread should have log state now
+    const unsigned long long nThreadStates = getThreadStates(con);
+    const CConsole::Stats stats = con.getStats();
+    const unsigned long long nRssEndKB = getRssKB();
+    printf("\nShort-lived threads: %d\n", nThreadsDone.load());
+    printf("Lines: %llu normal, %llu error, %llu success\n", stats.nLines[0], stats.nLines[1], stats.nLines[2]);
+    printf("Mutex wait: %llu us, sink writes: %llu us, flushes: %llu\n", stats.nMutexWaitMicrosecs, stats.nSinkWriteMicrosecs, stats.nFlushes);
+    printf("Churn latency:     first %.1f ns, last %.1f ns\n", fChurnFirstAvgNanosecs, fChurnLastAvgNanosecs);
+    printf("Sustained latency: first %.1f ns, last %.1f ns\n", fSustainedFirstAvgNanosecs, fSustainedLastAvgNanosecs);
+    printf("RSS: %llu KB at start, %llu KB at end (%+lld KB)\n", nRssStartKB, nRssEndKB, static_cast<long long>(nRssEndKB) - static_cast<long long>(nRssStartKB));
+    printf("Thread states left: %llu (expected: 1) -> %s\n", nThreadStates, (nThreadStates == 1) ? "OK" : "LEAK");
+
+    // main thread holds the only reference, so console should be completely shut down by this
+    con.Deinitialize();
+    const bool bShutDown = !con.isInitialized();
+    printf("Deinitialize(): %s\n", bShutDown ? "OK" : "FAILED, still initialized");
+
+    return ((nThreadStates == 1) && bShutDown) ? 0 : 1;
+} // main()
\ No newline at end of file
@@ -7,21 +7,28 @@
 */
 
 #include "CConsole.h"
+#include "CConsoleNumberFormat.h"
 
+#include <stdio.h>
 #include <stdlib.h>
 
 #include <atomic>              // requires cpp11
+#include <chrono>              // requires cpp11
 #include <condition_variable>  // requires cpp11
 #include <mutex>               // requires cpp11
 #include <thread>              // requires cpp11
 
+#ifdef _WIN32
 #include "../../../PFL/PFL/winproof88.h"
+#endif
 #include "../../../PFL/PFL/PFL.h"
 
 #define CON_TITLE "CConsole demo program"
 
 
+#ifdef _MSC_VER
 #pragma warning(disable:4100)  /* unreferenced formal parameter */
+#endif
 
 
 static void TestDefaultColors(CConsole& con)
@@ -149,16 +156,383 @@ static void TestModuleLoggingSet(CConsole& con)
     con.SetLoggingState(CON_TITLE, true);
     con.SOLn("You supposed to see this success log, line %d", __LINE__);
     con << CConsole::FormatSignal::S << "You supposed to see this success log, line " << __LINE__ << CConsole::FormatSignal::NL << CConsole::FormatSignal::N;
+
+    // module handle can be used to avoid looking up the module name every time
+    const CConsole::ModuleHandle hOtherModule = CConsole::getModuleHandle("OtherModule");
+    CConsole::getConsoleInstance(hOtherModule).OLn("You are not supposed to see this at line %d!", __LINE__);
+    con.SetLoggingState("OtherModule", true);
+    CConsole::getConsoleInstance(hOtherModule).OLn("You should see this logged by OtherModule, line %d", __LINE__);
+    con.SetLoggingState("OtherModule", false);
+    CConsole::getConsoleInstance(CON_TITLE);
+    con.OLn("");
+}
+
+static void TestAsyncLogging(CConsole& con)
+{
+    con.OLn("%s", __func__);
+    con.L();
+
+    con.SetAsyncLogging(true);
+    con.OLn("Async logging is %s, these lines are written by the writer thread.", con.isAsyncLogging() ? "ON" : "OFF");
+    con.OLn("Signed integral value: %d", -5);
+    con.OLn("Floating point value: %f", 5.30215f);
+    con.EOLn("Error mode also works in async mode: %b", true);
+    con << "Using operator<< in async mode: " << 16 << CConsole::FormatSignal::NL;
+    con.SetAsyncLogging(false);
+    con.OLn("Async logging is %s again, all queued lines must have appeared above.", con.isAsyncLogging() ? "ON" : "OFF");
+    con.OLn("");
+}
+
+static void TestCompileTimeFormat(CConsole& con)
+{
+    con.OLn("%s", __func__);
+    con.L();
+
+    con.OLn(CCONSOLE_FMT("Format string of this line is parsed at compile time."));
+    con.OLn(CCONSOLE_FMT("Signed: %d, unsigned: %u, float: %f, bool: %b, string: %s"), -5, 12u, 5.30215f, true, "text");
+    con.O(CCONSOLE_FMT("Printing without new line, "));
+    con.OLn(CCONSOLE_FMT("then %s with new line, percent sign: 100%%"), "continuing");
+    con.SOLn(CCONSOLE_FMT("Success mode: %b"), true);
+    con.EOLn(CCONSOLE_FMT("Error mode: %b"), false);
+    // these would not compile: wrong argument type, missing argument
+    //con.OLn(CCONSOLE_FMT("%d"), "text");
+    //con.OLn(CCONSOLE_FMT("%d %d"), 1);
+    con.OLn("");
+}
+
+static void TestNumberFormatting(CConsole& con)
+{
+    con.OLn("%s", __func__);
+    con.L();
+
+    con.OLn("64-bit signed: %lld, unsigned: %llu", -9007199254740993LL, 18446744073709551615ULL);
+    con.OLn(CCONSOLE_FMT("Same with compile-time format: %lld, %llu"), -9007199254740993LL, 18446744073709551615ULL);
+    con.OLn("Double keeps its precision: %f, trailing zeros are trimmed: %f", 123456789.125, 2.5);
+    con << "Using operator<< with 64-bit: " << 9007199254740993LL << ", and double: " << 0.0625 << CConsole::FormatSignal::NL;
+
+    // simple benchmark: what we used to do for numbers versus CConsoleNumberFormat
+    static constexpr int nIterations = 1000000;
+    char szNumber[CConsoleNumberFormat::BUFFER_SIZE];
+    size_t nTotalLength = 0;
+
+    auto timeStart = std::chrono::steady_clock::now();
+    for (int i = 0; i < nIterations; i++)
+    {
+        nTotalLength += sprintf(szNumber, "%d", i - nIterations / 2);
+        nTotalLength += sprintf(szNumber, "%0.4f", i * 0.37f);
+    }
+    const auto durationSprintf = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - timeStart);
+
+    timeStart = std::chrono::steady_clock::now();
+    for (int i = 0; i < nIterations; i++)
+    {
+        nTotalLength += CConsoleNumberFormat::FormatInteger(szNumber, i - nIterations / 2);
+        nTotalLength += CConsoleNumberFormat::FormatFloat(szNumber, i * 0.37f);
+    }
+    const auto durationNumberFormat = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - timeStart);
+
+    con.OLn("Formatting %d ints and %d floats: sprintf: %d ms, CConsoleNumberFormat: %d ms (total length: %u)",
+        nIterations, nIterations,
+        static_cast<int>(durationSprintf.count()), static_cast<int>(durationNumberFormat.count()),
+        static_cast<unsigned int>(nTotalLength));
+    con.OLn("");
+}
+
+static void TestSuppressedLogging(CConsole& con)
+{
+    con.OLn("%s", __func__);
+    con.L();
+
+    // logs of disabled logger modules are dropped before taking the mutex of CConsole, so many threads logging
+    // for disabled modules should not slow down each other
+    static constexpr int nThreads = 16;
+    static constexpr int nIterations = 1000000;
+    static constexpr const char* szModule = "SuppressedModule";
+
+    con.SetLoggingState(szModule, false);
+
+    const auto timeStart = std::chrono::steady_clock::now();
+    std::thread threads[nThreads];
+    for (int i = 0; i < nThreads; i++)
+    {
+        threads[i] = std::thread{ [](int nThreadIndex) {
+            // set logger module before Initialize() so even its logs are suppressed
+            CConsole& conThread = CConsole::getConsoleInstance(szModule);
+            conThread.Initialize("", false);
+            for (int j = 0; j < nIterations / nThreads; j++)
+            {
+                conThread.OLn("You are not supposed to see this, thread %d, iteration %d!", nThreadIndex, j);
+            }
+            conThread.Deinitialize();
+        }, i };
+    }
+    for (int i = 0; i < nThreads; i++)
+    {
+        threads[i].join();
+    }
+    const auto durationSuppressed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - timeStart);
+
+    con.OLn("%d suppressed logs on %d threads: %d ms", nIterations, nThreads, static_cast<int>(durationSuppressed.count()));
+    con.OLn("");
+}
+
+static int nExpensiveCalls = 0;
+
+static const char* GetExpensiveLogString()
+{
+    nExpensiveCalls++;
+    return "expensive string";
+}
+
+static void TestLoggingLevels(CConsole& con)
+{
+    con.OLn("%s", __func__);
+    con.L();
+
+    CCONSOLE_TRACE(con, "Trace log with %s", GetExpensiveLogString());
+    CCONSOLE_DEBUG(con, "Debug log with %s", GetExpensiveLogString());
+    CCONSOLE_INFO(con, CCONSOLE_FMT("Info log with %s"), GetExpensiveLogString());
+    CCONSOLE_SUCCESS(con, "Success log with %s", GetExpensiveLogString());
+    CCONSOLE_WARN(con, "Warning log with %s", GetExpensiveLogString());
+    CCONSOLE_ERROR(con, "Error log with %s", GetExpensiveLogString());
+
+    con.SetLoggingLevel(CCONSOLE_LEVEL_WARN);
+    CCONSOLE_DEBUG(con, "You are not supposed to see this debug log, line %d!", __LINE__);
+    CCONSOLE_INFO(con, "You are not supposed to see this info log, line %d!", __LINE__);
+    CCONSOLE_WARN(con, "You should see this warning log since level is WARN now, line %d", __LINE__);
+    con.SetLoggingLevel(CCONSOLE_LEVEL_TRACE);
+
+    nExpensiveCalls = 0;
+    con.SetLoggingState(CON_TITLE, false);
+    for (int i = 0; i < 1000; i++)
+    {
+        CCONSOLE_DEBUG(con, "You are not supposed to see this debug log, line %d: %s", __LINE__, GetExpensiveLogString());
+    }
+    con.SetLoggingState(CON_TITLE, true);
+    con.OLn("Arguments of debug logs of disabled logger module were evaluated %d times", nExpensiveCalls);
+    con.OLn("");
+}
+
+static void TestBinaryLogging(CConsole& con)
+{
+    con.OLn("%s", __func__);
+    con.L();
+
+    // with binary logging, logs are not formatted, only their format string id and raw arguments are saved,
+    // use CConsoleDecoder to render the .cclog file into html or text
+    static constexpr int nIterations = 100000;
+
+    con.SetBinaryLogging(true);
+    const auto timeStart = std::chrono::steady_clock::now();
+    for (int i = 0; i < nIterations; i++)
+    {
+        con.OLn("Binary log %d: signed: %d, float: %f, bool: %b, string: %s", i, -i, i * 0.37f, (i % 2) == 0, "text");
+    }
+    const auto durationBinary = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - timeStart);
+    con.SetBinaryLogging(false);
+
+    con.OLn("%d logs written to binary log file: %d ms", nIterations, static_cast<int>(durationBinary.count()));
+    con.OLn("");
+}
+
+static void TestSinks(CConsole& con)
+{
+    con.OLn("%s", __func__);
+    con.L();
+
+    // text and JSON-lines file names are derived from the html log file name when no file name is given
+    con.OpenSink(CConsole::Sink::TextFile);
+    con.OpenSink(CConsole::Sink::JsonFile);
+    con.OpenSink(CConsole::Sink::Memory);
+    con.OLn("This line goes to console, html, text and JSON-lines files, and to memory.");
+
+    con.SetSinkModeState(CConsole::Sink::Console, CConsole::N, false);
+    con.OLn("This line does NOT appear in console, only in the files and in memory.");
+    con.EOLn("Errors still appear in console.");
+    con.SetSinkModeState(CConsole::Sink::Console, CConsole::N, true);
+
+    const std::string sMemory = con.getMemorySinkText();
+    con.CloseSink(CConsole::Sink::Memory);
+    con.CloseSink(CConsole::Sink::JsonFile);
+    con.CloseSink(CConsole::Sink::TextFile);
+    con.OLn("Memory sink collected %d chars.", static_cast<int>(sMemory.length()));
+    con.OLn("");
+}
+
+static void TestFlushPolicy(CConsole& con)
+{
+    con.OLn("%s", __func__);
+    con.L();
+
+    // log file is written in big chunks now, error lines are still flushed immediately
+    con.SetFlushPolicy(CConsole::FlushPolicy::OnError);
+    for (int i = 0; i < 5; i++)
+    {
+        con.OLn("Buffered line %d", i);
+    }
+    con.EOLn("This error line makes the buffered lines reach the log file.");
+
+    con.SetFlushPolicy(CConsole::FlushPolicy::BufferFull);
+    con.OLn("This line reaches the log file only by explicit Flush().");
+    con.Flush();
+
+    con.SetFlushPolicy(CConsole::FlushPolicy::EveryLine);
+    con.OLn("");
+}
+
+static void TestCompactHtml(CConsole& con)
+{
+    con.OLn("%s", __func__);
+    con.L();
+
+    con.SetCompactHtml(true);
+    con.OLn("Same look in html log file with much less markup: %d %d %d, %f, %b, %s", 1, 2, 3, 4.5f, true, "string");
+    con.OLn("    indentation    and spaces are kept");
+    con.EOLn("Error with values: %d, %s", 42, "string");
+    con.SOLn("Success with values: %d, %s", 42, "string");
+    con.SetCompactHtml(false);
+    con.OLn("");
+}
+
+static void TestErrorBacklog(CConsole& con)
+{
+    con.OLn("%s", __func__);
+    con.L();
+
+    // suppressed lines are kept per thread and written after the next error, so error-only logging shows what led to the error
+    con.SetErrorBacklogLines(4);
+    con.SetLoggingState(CON_TITLE, false);
+    for (int i = 0; i < 6; i++)
+    {
+        con.OLn("Processing item %d (only the last few of these are kept)", i);
+    }
+    con << "Value of pi is " << 3.1416f << ", value of e is " << 2.7183 << CConsole::FormatSignal::NL;
+    con.O("Loading bitmap %s ... ", "bitmap.bmp");
+    con.EOLn("failed!");
+    // no dump between errors following each other, only at the first non-error printout
+    con.EOLn("Couldn't process item %d, line %d", 6, __LINE__);
+    con.OLn("Continuing with next item, line %d", __LINE__);
+    con.SetLoggingState(CON_TITLE, true);
+    con.SetErrorBacklogLines(0);
+    con.OLn("");
+}
+
+static void TestRepeatedLines(CConsole& con)
+{
+    con.OLn("%s", __func__);
+    con.L();
+
+    // consecutive identical lines of a thread are dropped without locking, and only their count is written
+    con.SetRepeatedLinesTimeout(1000);
+    for (int i = 0; i < 100; i++)
+    {
+        con.EOLn("Couldn't open device %s, error %d", "/dev/null0", 5);
+    }
+    // different argument value ends the run
+    con.EOLn("Couldn't open device %s, error %d", "/dev/null1", 5);
+    con.EOLn("Couldn't open device %s, error %d", "/dev/null1", 5);
+    con.OLn("Continuing, line %d", __LINE__);
+    con.SetRepeatedLinesTimeout(0);
+    con.OLn("");
+}
+
+static void TestRateLimitedLogging(CConsole& con)
+{
+    con.OLn("%s", __func__);
+    con.L();
+
+    // hot-loop logs are limited per call site before locking and formatting, dropped logs are reported by the next printed log
+    for (int nFrame = 0; nFrame < 2000; nFrame++)
+    {
+        if ( nFrame == 1000 )
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+        }
+        CCONSOLE_INFO_LIMITED(con, 3, "Frame %d rendered (at most 3 of these per second)", nFrame);
+        CCONSOLE_INFO_SAMPLED(con, 400, "Frame %d rendered (1 of every 400 of these)", nFrame);
+    }
+    con.OLn("");
+}
+
+static void TestBatch(CConsole& con)
+{
+    con.OLn("%s", __func__);
+    con.L();
+
+    // logs of a batch are collected without locking, and written in one go, not mixed with logs of other threads
+    {
+        CConsole::Batch batch(con);
+        batch.OLn("Startup state dump, %d entries:", 3);
+        batch.OI();
+        batch.OLn("Screen: %d x %d, fullscreen: %b", 1920, 1080, true);
+        batch.OLn("Audio device: %s", "default");
+        batch.EOLn("Gamepad: %s", "not found");
+        batch.OO();
+        batch.SOLn("End of state dump, line %d", __LINE__);
+    } // batch is committed here
+    con.OLn("");
+}
+
+static void TestFlightRecorder(CConsole& con)
+{
+    con.OLn("%s", __func__);
+    con.L();
+
+    // the most recent log records are always kept in memory, with the crash handler they are written to a crash file
+    // next to the log file on fatal signals, even if they were not yet written to the log file, e.g. in async mode
+    con.SetCrashHandler(true);
+    con.OLn("Crash handler is set, the lines above would be in the crash file if the program crashed now, line %d", __LINE__);
+    con.OLn("");
+}
+
+static void TestStats(CConsole& con)
+{
+    con.OLn("%s", __func__);
+    con.L();
+
+    const CConsole::Stats stats = con.getStats();
+    con.OLn("Lines so far: %llu normal, %llu error, %llu success", stats.nLines[0], stats.nLines[1], stats.nLines[2]);
+    con.OLn("Suppressed lines so far: %llu", stats.nSuppressedLines[0] + stats.nSuppressedLines[1] + stats.nSuppressedLines[2]);
+    con.OLn("Bytes written to html log file: %llu", stats.nSinkBytes[static_cast<size_t>(CConsole::Sink::HtmlFile)]);
+    con.OLn("Flushes: %llu, mutex wait: %llu us, sink writes: %llu us", stats.nFlushes, stats.nMutexWaitMicrosecs, stats.nSinkWriteMicrosecs);
+    for (const auto& moduleStats : stats.modules)
+    {
+        con.OLn("Module \"%s\": %llu lines, %llu suppressed lines",
+            moduleStats.sName.c_str(),
+            moduleStats.nLines[0] + moduleStats.nLines[1] + moduleStats.nLines[2],
+            moduleStats.nSuppressedLines[0] + moduleStats.nSuppressedLines[1] + moduleStats.nSuppressedLines[2]);
+    }
     con.OLn("");
 }
 
 static std::mutex mtx;
 static std::condition_variable cv;
-static std::atomic<int> numThreadsWaiting = 0;
-static std::atomic<int> nThreadCntr = 0;
+static int nThreadsArrived = 0;       // guarded by mtx
+static int nBarrierGeneration = 0;    // guarded by mtx
 static std::atomic<int> nErrorsOutCount = 0;
 static std::atomic<int> nSuccessOutCount = 0;
 
+// Blocks until all 3 test threads arrive. The last arriving thread runs lastThreadFunc before releasing the others.
+// Waiting threads wait for the generation to change, so a wakeup cannot be lost, and the barrier can be used again right away.
+template <typename F>
+static void WaitForAllThreads(F lastThreadFunc)
+{
+    std::unique_lock<std::mutex> lk(mtx);
+    const int nGeneration = nBarrierGeneration;
+    nThreadsArrived++;
+    if (nThreadsArrived == 3)
+    {
+        lastThreadFunc();
+        nThreadsArrived = 0;
+        nBarrierGeneration++;
+        cv.notify_all();
+    }
+    else
+    {
+        cv.wait(lk, [nGeneration] {return nBarrierGeneration != nGeneration; });
+    }
+}
+
 static void threadFunc(CConsole& con, CConsole::FormatSignal fs)
 {
     // in case of consecutive Initialize() calls, the parameters don't really matter
@@ -192,24 +566,13 @@ static void threadFunc(CConsole& con, CConsole::FormatSignal fs)
 
     // now we wait for all threads to execute above statements
     // ##############################################################################################################################
-    std::unique_lock<std::mutex> lk(mtx);  // lock must be locked by current thread, so lock is thread-specific, but mutex is shared!
-    
-    // basically numThreadsWaiting and nThreadCntr are used for same purpose, their roles are replaced after each test
-
-    numThreadsWaiting++;
-    if (numThreadsWaiting == 3)
-    {
+    // first 2 threads will actually wait here, the last arriving thread resets the counters and won't have to wait, it will continue
+    WaitForAllThreads([&con] {
         con.ResetErrorOutsCount();
         con.ResetSuccessOutsCount();
         nErrorsOutCount = 0;
         nSuccessOutCount = 0;
-        nThreadCntr = 0;
-    }
-    // first 2 threads will actually wait here, the last thread setting numThreadsWaiting to 3 won't have to wait, it will continue
-    cv.wait(lk, [&] {return numThreadsWaiting == 3; });
-    cv.notify_all();
-    lk.unlock();  // wait() unlocks the lock, but after continuing it will be locked again, so we explicitly unlock it here:
-    // if we don't explicitly unlock it, the other 2 threads will wait until a thread exits.
+    });
     // we dont need the lock/mutex anymore, because every Console stuff we invoke below are expected to be thread-safe anyway!
 
     // first test: text output, indentation and mode (colors) are unique for each thread, they dont mess with each other
@@ -226,11 +589,8 @@ static void threadFunc(CConsole& con, CConsole::FormatSignal fs)
         con.OLn("%s logNo %d: some log blah blah blah 123 123", sThreadName.c_str(), i);
     }
 
-    nThreadCntr++;
-
     // preparing for next test, we are waiting here for all threads to finish above test
     // ##############################################################################################################################
-    lk.lock();
 
     // reset original indentations
     switch (fs)
@@ -239,8 +599,13 @@ static void threadFunc(CConsole& con, CConsole::FormatSignal fs)
     case CConsole::FormatSignal::E: con.SetIndent(12); break;
     default: con.SetIndent(4);
     }
-    if (nThreadCntr == 3)
-    {
+
+    // SetLoggingState is needed because later we will use CConsole::getConsoleInstance() with module name
+    con.SetLoggingState(sThreadName.c_str(), true);
+    con.SetErrorsAlwaysOn(false);
+
+    // first 2 threads will actually wait here, the last finishing thread won't have to wait, it will continue
+    WaitForAllThreads([&con, fs] {
         // last finishing thread will run this code
         nErrorsOutCount = con.getErrorOutsCount();
         nSuccessOutCount = con.getSuccessOutsCount();
@@ -268,18 +633,7 @@ static void threadFunc(CConsole& con, CConsole::FormatSignal fs)
         con.ResetSuccessOutsCount();
         nErrorsOutCount = 0;
         nSuccessOutCount = 0;
-        nThreadCntr = 0;
-    }
-
-    // SetLoggingState is needed because later we will use CConsole::getConsoleInstance() with module name
-    con.SetLoggingState(sThreadName.c_str(), true);
-    con.SetErrorsAlwaysOn(false);
-    
-    // first 2 threads will actually wait here, the last thread setting nThreadCntr to 0 won't have to wait, it will continue
-    numThreadsWaiting = 0;
-    cv.wait(lk, [&] {return nThreadCntr == 0; });
-    cv.notify_all();
-    lk.unlock();  // explanation of why we are doing this is written above before previous test
+    });
 
     // next test: using getConsoleInstance() with different module names, we expect threads are not messing with each other
     // ##############################################################################################################################
@@ -320,20 +674,16 @@ static void threadFunc(CConsole& con, CConsole::FormatSignal fs)
     con.OLn("%s FINISHED, number of visible logs: %d, number of hidden logs: %d, total is %d, should be %d, that is %s!",
         sThreadName.c_str(), nVisibleLogs, nHiddenLogs, nVisibleLogs + nHiddenLogs, 10, (10 == nVisibleLogs + nHiddenLogs ? "GOOD" : "BAD"));
     
-    numThreadsWaiting++;
-    
     // preparing for next test, we are waiting here for all threads to finish above test
     // ##############################################################################################################################
-    lk.lock();
-    if (numThreadsWaiting == 3)
-    {
+    // first 2 threads will actually wait here, the last finishing thread won't have to wait, it will continue
+    WaitForAllThreads([&con] {
         // last finishing thread will run this code
         con.OLn("");
         con.OLn("All threads have re-enabled their logging for their module names and are ready for next test!");
         con.OLn("Next test starting");
         con.OLn("");
-        numThreadsWaiting = 0;
-    }
+    });
 
     // set required colors again
     switch (fs)
@@ -343,12 +693,6 @@ static void threadFunc(CConsole& con, CConsole::FormatSignal fs)
     default:
         ; // nothing to do
     }
-    
-    // first 2 threads will actually wait here, the last thread setting numThreadsWaiting to 0 won't have to wait, it will continue
-    nThreadCntr = 0;
-    cv.wait(lk, [&] {return numThreadsWaiting == 0; });
-    cv.notify_all();
-    lk.unlock();  // explanation of why we are doing this is written above at first test
 
     // next test could come here
     // ##############################################################################################################################
@@ -410,7 +754,11 @@ static void TestConcurrentLogging(CConsole& con)
     }
 }
 
+#ifdef _WIN32
 int WINAPI WinMain(const HINSTANCE hInstance, const HINSTANCE hPrevInstance, const LPSTR lpCmdLine, const int nCmdShow)
+#else
+int main()
+#endif
 {
     CConsole& con = CConsole::getConsoleInstance(CON_TITLE);
 
@@ -427,9 +775,26 @@ int WINAPI WinMain(const HINSTANCE hInstance, const HINSTANCE hPrevInstance, con
     TestCustomColors(con);
     TestOperatorStreamOut(con);
     TestModuleLoggingSet(con);
+    TestAsyncLogging(con);
+    TestCompileTimeFormat(con);
+    TestNumberFormatting(con);
+    TestSuppressedLogging(con);
+    TestLoggingLevels(con);
+    TestBinaryLogging(con);
+    TestSinks(con);
+    TestFlushPolicy(con);
+    TestCompactHtml(con);
+    TestErrorBacklog(con);
+    TestRepeatedLines(con);
+    TestRateLimitedLogging(con);
+    TestBatch(con);
+    TestFlightRecorder(con);
+    TestStats(con);
     TestConcurrentLogging(con);
 
+#ifdef _WIN32
     system("pause");
+#endif
 
     con.Deinitialize();
 